@@ -49,6 +49,8 @@ static const char * const debug_classes[] = { "fixme", "err", "warn", "trace" };
 #define LOG_FILE
 /* log TRACE messages to */
 //#define LOG_TRACE
+/* write log files from a background thread */
+#define LOG_ASYNC
 #endif
 
 /*typedef DECLCALLBACKTYPE(void, FNVBOXWINELOGBACKDOOR, (char* pcszStr));
@@ -426,18 +428,251 @@ static const char *default_dbgstr_wn( const WCHAR *str, int n )
 #ifdef LOG_FILE
 static FILE *log_file = NULL;
 
+#ifdef LOG_ASYNC
+/* Records are formatted on the logging thread and appended to a ring owned
+ * by that thread, and a writer thread drains all rings into the log file.
+ * Logging threads never wait for file I/O or for each other: a record that
+ * doesn't fit into the ring is dropped and counted instead.
+ *
+ * Set WINEDEBUG_SYNC=1 to write records synchronously as before, and
+ * WINEDEBUG_RATELIMIT=<n> to log at most n records per second from each
+ * message site. */
+
+#define LOG_RING_SIZE       (64 * 1024)
+#define LOG_RECORD_MAX      1024
+#define LOG_WRITER_INTERVAL 20 /* ms */
+#define LOG_SITE_BUCKETS    256
+
+struct log_ring
+{
+    struct log_ring *next;
+    HANDLE thread;
+    DWORD tid;
+    /* Free running byte counters, head is only written by the owning
+     * thread and tail only by the writer. */
+    volatile LONG head;
+    volatile LONG tail;
+    char data[LOG_RING_SIZE];
+};
+
+struct log_site
+{
+    const char *format;
+    DWORD second;
+    volatile LONG count;
+};
+
+static BOOL log_async = TRUE;
+static unsigned int log_rate_limit;
+static DWORD log_tls = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION log_rings_cs;
+static struct log_ring * volatile log_rings;
+static HANDLE log_event, log_thread;
+static volatile LONG log_stop, log_writer_done;
+static volatile LONG log_dropped, log_limited;
+static struct log_site log_sites[LOG_SITE_BUCKETS];
+
+static void log_drain(void)
+{
+    struct log_ring *ring, *next, **prev;
+    unsigned int head, tail, offset, part;
+    LONG count;
+
+    for (ring = log_rings; ring; ring = next)
+    {
+        next = ring->next;
+        head = ring->head;
+        tail = ring->tail;
+
+        if (head != tail)
+        {
+            offset = tail % LOG_RING_SIZE;
+            part = min(head - tail, LOG_RING_SIZE - offset);
+            fwrite(ring->data + offset, 1, part, log_file);
+            fwrite(ring->data, 1, head - tail - part, log_file);
+            InterlockedExchange(&ring->tail, head);
+        }
+        else if (ring->thread && WaitForSingleObject(ring->thread, 0) == WAIT_OBJECT_0)
+        {
+            /* The owner exited and everything it logged has been written. */
+            EnterCriticalSection(&log_rings_cs);
+            for (prev = (struct log_ring **)&log_rings; *prev != ring; prev = &(*prev)->next);
+            *prev = next;
+            LeaveCriticalSection(&log_rings_cs);
+            CloseHandle(ring->thread);
+            free(ring);
+        }
+    }
+
+    if ((count = InterlockedExchange(&log_dropped, 0)))
+        fprintf(log_file, "--- %d log records dropped ---\n", count);
+    if ((count = InterlockedExchange(&log_limited, 0)))
+        fprintf(log_file, "--- %d log records rate limited ---\n", count);
+    fflush(log_file);
+}
+
+static DWORD WINAPI log_writer_proc(void *arg)
+{
+    while (!log_stop)
+    {
+        WaitForSingleObject(log_event, LOG_WRITER_INTERVAL);
+        log_drain();
+    }
+    InterlockedExchange(&log_writer_done, 1);
+
+    return 0;
+}
+
+static struct log_ring *log_get_ring(void)
+{
+    struct log_ring *ring;
+    DWORD tid;
+
+    if (!log_async || log_tls == TLS_OUT_OF_INDEXES)
+        return NULL;
+    if ((ring = TlsGetValue(log_tls)))
+        return ring;
+
+    if (!(ring = calloc(1, sizeof(*ring))))
+        return NULL;
+    ring->tid = GetCurrentThreadId();
+    if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+            &ring->thread, 0, FALSE, DUPLICATE_SAME_ACCESS))
+        ring->thread = NULL;
+
+    EnterCriticalSection(&log_rings_cs);
+    if (!log_thread && !log_stop)
+        log_thread = CreateThread(NULL, 0, log_writer_proc, NULL, 0, &tid);
+    if (!log_thread)
+    {
+        LeaveCriticalSection(&log_rings_cs);
+        if (ring->thread)
+            CloseHandle(ring->thread);
+        free(ring);
+        log_async = FALSE;
+        return NULL;
+    }
+    ring->next = log_rings;
+    log_rings = ring;
+    LeaveCriticalSection(&log_rings_cs);
+
+    TlsSetValue(log_tls, ring);
+
+    return ring;
+}
+
+static int log_ring_push(struct log_ring *ring, const char *data, unsigned int size)
+{
+    unsigned int head = ring->head, tail = ring->tail, offset, part;
+
+    if (LOG_RING_SIZE - (head - tail) < size)
+    {
+        InterlockedIncrement(&log_dropped);
+        return 0;
+    }
+
+    offset = head % LOG_RING_SIZE;
+    part = min(size, LOG_RING_SIZE - offset);
+    memcpy(ring->data + offset, data, part);
+    memcpy(ring->data, data + part, size - part);
+    InterlockedExchange(&ring->head, head + size);
+
+    if (head + size - tail > LOG_RING_SIZE / 2)
+        SetEvent(log_event);
+
+    return size;
+}
+
+/* Returns the number of characters in "buffer", truncating the record if needed. */
+static unsigned int log_format(char *buffer, unsigned int size, const char *format, va_list args)
+{
+    int len = vsnprintf(buffer, size, format, args);
+
+    if (len < 0 || len >= size)
+    {
+        len = size - 1;
+        buffer[len - 1] = '\n';
+        buffer[len] = 0;
+    }
+
+    return len;
+}
+
+/* The format string identifies the message site. Races between threads
+ * only let a few more records through. */
+static BOOL log_site_allowed(const char *format)
+{
+    struct log_site *site = &log_sites[((ULONG_PTR)format >> 2) % LOG_SITE_BUCKETS];
+    DWORD second = GetTickCount() / 1000;
+
+    if (!log_rate_limit || !format)
+        return TRUE;
+
+    if (site->format != format || site->second != second)
+    {
+        site->format = format;
+        site->second = second;
+        site->count = 0;
+    }
+    if (InterlockedIncrement(&site->count) <= log_rate_limit)
+        return TRUE;
+
+    InterlockedIncrement(&log_limited);
+    return FALSE;
+}
+#endif
+
 void wine_debug_logs_init(const char *logname)
 {
 	char logfile[128];
+#ifdef LOG_ASYNC
+	const char *env;
+#endif
 	sprintf(logfile, "proc_%u_%s", GetCurrentProcessId(), logname);
 	
 	log_file = fopen(logfile, "wt");
+
+#ifdef LOG_ASYNC
+	if ((env = getenv("WINEDEBUG_SYNC")) && atoi(env))
+		log_async = FALSE;
+	if ((env = getenv("WINEDEBUG_RATELIMIT")))
+		log_rate_limit = atoi(env);
+
+	InitializeCriticalSection(&log_rings_cs);
+	log_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+	log_tls = TlsAlloc();
+	if (!log_event || log_tls == TLS_OUT_OF_INDEXES)
+		log_async = FALSE;
+#endif
 }
 
 void wine_debug_logs_close()
 {
 	if(log_file)
 	{
+#ifdef LOG_ASYNC
+		unsigned int i;
+
+		/* The writer can't be waited for under the loader lock, and is
+		 * already gone if the process is terminating. */
+		log_stop = 1;
+		if (log_thread)
+		{
+			SetEvent(log_event);
+			for (i = 0; i < 500 && !log_writer_done
+					&& WaitForSingleObject(log_thread, 0) == WAIT_TIMEOUT; ++i)
+				Sleep(1);
+			if (!log_writer_done && WaitForSingleObject(log_thread, 0) == WAIT_TIMEOUT)
+			{
+				/* Still draining, so the rings and the file belong to the
+				 * writer. Leak them rather than race with it. */
+				return;
+			}
+			CloseHandle(log_thread);
+			log_thread = NULL;
+		}
+		log_drain();
+#endif
 		fputs("\n--- LOG END ---\n", log_file);
 		fflush(log_file);
 		fclose(log_file);
@@ -460,6 +695,13 @@ static int default_dbg_vprintf( const char *format, va_list args )
 # ifdef LOG_FILE
   if(log_file)
   {
+#  ifdef LOG_ASYNC
+  	struct log_ring *ring;
+  	char buffer[LOG_RECORD_MAX];
+
+  	if ((ring = log_get_ring()))
+  		return log_ring_push(ring, buffer, log_format(buffer, sizeof(buffer), format, args));
+#  endif
   	return vfprintf(log_file, format, args );
   }
   return 0;
@@ -478,6 +720,26 @@ static int default_dbg_vlog( enum __wine_debug_class cls, struct __wine_debug_ch
 {
     int ret = 0;
 
+#if defined(LOG_ASYNC) && !defined(WINE_SILENT)
+    struct log_ring *ring;
+
+    /* Header and message go into a single record, so that the writer
+     * doesn't interleave them with records from other threads. */
+    if (log_file && funcs.dbg_vprintf == default_dbg_vprintf && (ring = log_get_ring()))
+    {
+        char buffer[LOG_RECORD_MAX];
+
+        if (!log_site_allowed(format))
+            return 0;
+
+        if (cls < sizeof(debug_classes)/sizeof(debug_classes[0]))
+            ret = sprintf( buffer, "%s:[%#x]:%.64s:%.128s ", debug_classes[cls], ring->tid, channel->name, func );
+        if (format)
+            ret += log_format( buffer + ret, sizeof(buffer) - ret, format, args );
+        return log_ring_push( ring, buffer, ret );
+    }
+#endif
+
     if (cls < sizeof(debug_classes)/sizeof(debug_classes[0]))
         ret += wine_dbg_printf( "%s:[%#x]:%s:%s ", debug_classes[cls], GetCurrentThreadId(), channel->name, func );
     if (format)
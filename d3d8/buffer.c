@@ -216,10 +216,8 @@ static HRESULT WINAPI d3d8_vertexbuffer_GetDesc(IDirect3DVertexBuffer8 *iface,
 
     TRACE("iface %p, desc %p.\n", iface, desc);
 
-    wined3d_mutex_lock();
     wined3d_resource = wined3d_buffer_get_resource(buffer->wined3d_buffer);
     wined3d_resource_get_desc(wined3d_resource, &wined3d_desc);
-    wined3d_mutex_unlock();
 
     desc->Type = D3DRTYPE_VERTEXBUFFER;
     desc->Usage = wined3d_desc.usage & WINED3DUSAGE_MASK;
@@ -273,10 +271,8 @@ HRESULT vertexbuffer_init(struct d3d8_vertexbuffer *buffer, struct d3d8_device *
     d3d8_resource_init(&buffer->resource);
     buffer->fvf = fvf;
 
-    wined3d_mutex_lock();
     hr = wined3d_buffer_create_vb(device->wined3d_device, size, usage & WINED3DUSAGE_MASK,
             (enum wined3d_pool)pool, buffer, &d3d8_vertexbuffer_wined3d_parent_ops, &buffer->wined3d_buffer);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d buffer, hr %#x.\n", hr);
@@ -493,10 +489,8 @@ static HRESULT WINAPI d3d8_indexbuffer_GetDesc(IDirect3DIndexBuffer8 *iface,
 
     TRACE("iface %p, desc %p.\n", iface, desc);
 
-    wined3d_mutex_lock();
     wined3d_resource = wined3d_buffer_get_resource(buffer->wined3d_buffer);
     wined3d_resource_get_desc(wined3d_resource, &wined3d_desc);
-    wined3d_mutex_unlock();
 
     desc->Format = d3dformat_from_wined3dformat(buffer->format);
     desc->Type = D3DRTYPE_INDEXBUFFER;
@@ -549,10 +543,8 @@ HRESULT indexbuffer_init(struct d3d8_indexbuffer *buffer, struct d3d8_device *de
     d3d8_resource_init(&buffer->resource);
     buffer->format = wined3dformat_from_d3dformat(format);
 
-    wined3d_mutex_lock();
     hr = wined3d_buffer_create_ib(device->wined3d_device, size, usage & WINED3DUSAGE_MASK,
             (enum wined3d_pool)pool, buffer, &d3d8_indexbuffer_wined3d_parent_ops, &buffer->wined3d_buffer);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d buffer, hr %#x.\n", hr);
@@ -233,9 +233,7 @@ static DWORD WINAPI d3d8_texture_2d_GetLevelCount(IDirect3DTexture8 *iface)
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -248,7 +246,6 @@ static HRESULT WINAPI d3d8_texture_2d_GetLevelDesc(IDirect3DTexture8 *iface, UIN
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
     else
@@ -265,7 +262,6 @@ static HRESULT WINAPI d3d8_texture_2d_GetLevelDesc(IDirect3DTexture8 *iface, UIN
         desc->Width = wined3d_desc.width;
         desc->Height = wined3d_desc.height;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -279,17 +275,12 @@ static HRESULT WINAPI d3d8_texture_2d_GetSurfaceLevel(IDirect3DTexture8 *iface,
 
     TRACE("iface %p, level %u, surface %p.\n", iface, level, surface);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     surface_impl = wined3d_resource_get_parent(sub_resource);
     *surface = &surface_impl->IDirect3DSurface8_iface;
     IDirect3DSurface8_AddRef(*surface);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -594,9 +585,7 @@ static DWORD WINAPI d3d8_texture_cube_GetLevelCount(IDirect3DCubeTexture8 *iface
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -609,12 +598,8 @@ static HRESULT WINAPI d3d8_texture_cube_GetLevelDesc(IDirect3DCubeTexture8 *ifac
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     if (level >= wined3d_texture_get_level_count(texture->wined3d_texture))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
@@ -632,7 +617,6 @@ static HRESULT WINAPI d3d8_texture_cube_GetLevelDesc(IDirect3DCubeTexture8 *ifac
         desc->Width = wined3d_desc.width;
         desc->Height = wined3d_desc.height;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -648,25 +632,17 @@ static HRESULT WINAPI d3d8_texture_cube_GetCubeMapSurface(IDirect3DCubeTexture8
 
     TRACE("iface %p, face %#x, level %u, surface %p.\n", iface, face, level, surface);
 
-    wined3d_mutex_lock();
     level_count = wined3d_texture_get_level_count(texture->wined3d_texture);
     if (level >= level_count)
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     sub_resource_idx = level_count * face + level;
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, sub_resource_idx)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     surface_impl = wined3d_resource_get_parent(sub_resource);
     *surface = &surface_impl->IDirect3DSurface8_iface;
     IDirect3DSurface8_AddRef(*surface);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -965,9 +941,7 @@ static DWORD WINAPI d3d8_texture_3d_GetLevelCount(IDirect3DVolumeTexture8 *iface
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -980,7 +954,6 @@ static HRESULT WINAPI d3d8_texture_3d_GetLevelDesc(IDirect3DVolumeTexture8 *ifac
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
     else
@@ -997,7 +970,6 @@ static HRESULT WINAPI d3d8_texture_3d_GetLevelDesc(IDirect3DVolumeTexture8 *ifac
         desc->Height = wined3d_desc.height;
         desc->Depth = wined3d_desc.depth;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -1011,17 +983,12 @@ static HRESULT WINAPI d3d8_texture_3d_GetVolumeLevel(IDirect3DVolumeTexture8 *if
 
     TRACE("iface %p, level %u, volume %p.\n", iface, level, volume);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     volume_impl = wined3d_resource_get_parent(sub_resource);
     *volume = &volume_impl->IDirect3DVolume8_iface;
     IDirect3DVolume8_AddRef(*volume);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -1175,10 +1142,8 @@ HRESULT texture_init(struct d3d8_texture *texture, struct d3d8_device *device,
     if (!levels)
         levels = wined3d_log2i(max(width, height)) + 1;
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, surface_flags,
             NULL, texture, &d3d8_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d texture, hr %#x.\n", hr);
@@ -1220,10 +1185,8 @@ HRESULT cubetexture_init(struct d3d8_texture *texture, struct d3d8_device *devic
     if (!levels)
         levels = wined3d_log2i(edge_length) + 1;
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, surface_flags,
             NULL, texture, &d3d8_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d cube texture, hr %#x.\n", hr);
@@ -1261,10 +1224,8 @@ HRESULT volumetexture_init(struct d3d8_texture *texture, struct d3d8_device *dev
     if (!levels)
         levels = wined3d_log2i(max(max(width, height), depth)) + 1;
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, 0,
             NULL, texture, &d3d8_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d volume texture, hr %#x.\n", hr);
@@ -120,10 +120,8 @@ static HRESULT WINAPI d3d8_volume_GetDesc(IDirect3DVolume8 *iface, D3DVOLUME_DES
 
     TRACE("iface %p, desc %p.\n", iface, desc);
 
-    wined3d_mutex_lock();
     sub_resource = wined3d_texture_get_sub_resource(volume->wined3d_texture, volume->sub_resource_idx);
     wined3d_resource_get_desc(sub_resource, &wined3d_desc);
-    wined3d_mutex_unlock();
 
     desc->Format = d3dformat_from_wined3dformat(wined3d_desc.format);
     desc->Type = wined3d_desc.resource_type;
@@ -217,10 +217,8 @@ static HRESULT WINAPI d3d9_vertexbuffer_GetDesc(IDirect3DVertexBuffer9 *iface,
 
     TRACE("iface %p, desc %p.\n", iface, desc);
 
-    wined3d_mutex_lock();
     wined3d_resource = wined3d_buffer_get_resource(buffer->wined3d_buffer);
     wined3d_resource_get_desc(wined3d_resource, &wined3d_desc);
-    wined3d_mutex_unlock();
 
     desc->Format = D3DFMT_VERTEXDATA;
     desc->Usage = wined3d_desc.usage & WINED3DUSAGE_MASK;
@@ -274,10 +272,8 @@ HRESULT vertexbuffer_init(struct d3d9_vertexbuffer *buffer, struct d3d9_device *
     buffer->fvf = fvf;
     d3d9_resource_init(&buffer->resource);
 
-    wined3d_mutex_lock();
     hr = wined3d_buffer_create_vb(device->wined3d_device, size, usage & WINED3DUSAGE_MASK,
             (enum wined3d_pool)pool, buffer, &d3d9_vertexbuffer_wined3d_parent_ops, &buffer->wined3d_buffer);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d buffer, hr %#x.\n", hr);
@@ -492,10 +488,8 @@ static HRESULT WINAPI d3d9_indexbuffer_GetDesc(IDirect3DIndexBuffer9 *iface, D3D
 
     TRACE("iface %p, desc %p.\n", iface, desc);
 
-    wined3d_mutex_lock();
     wined3d_resource = wined3d_buffer_get_resource(buffer->wined3d_buffer);
     wined3d_resource_get_desc(wined3d_resource, &wined3d_desc);
-    wined3d_mutex_unlock();
 
     desc->Format = d3dformat_from_wined3dformat(buffer->format);
     desc->Usage = wined3d_desc.usage & WINED3DUSAGE_MASK;
@@ -548,10 +542,8 @@ HRESULT indexbuffer_init(struct d3d9_indexbuffer *buffer, struct d3d9_device *de
     buffer->format = wined3dformat_from_d3dformat(format);
     d3d9_resource_init(&buffer->resource);
 
-    wined3d_mutex_lock();
     hr = wined3d_buffer_create_ib(device->wined3d_device, size, usage & WINED3DUSAGE_MASK,
             (enum wined3d_pool)pool, buffer, &d3d9_indexbuffer_wined3d_parent_ops, &buffer->wined3d_buffer);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d buffer, hr %#x.\n", hr);
@@ -235,9 +235,7 @@ static DWORD WINAPI d3d9_texture_2d_GetLevelCount(IDirect3DTexture9 *iface)
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -290,7 +288,6 @@ static HRESULT WINAPI d3d9_texture_2d_GetLevelDesc(IDirect3DTexture9 *iface, UIN
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
     else
@@ -307,7 +304,6 @@ static HRESULT WINAPI d3d9_texture_2d_GetLevelDesc(IDirect3DTexture9 *iface, UIN
         desc->Width = wined3d_desc.width;
         desc->Height = wined3d_desc.height;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -321,17 +317,12 @@ static HRESULT WINAPI d3d9_texture_2d_GetSurfaceLevel(IDirect3DTexture9 *iface,
 
     TRACE("iface %p, level %u, surface %p.\n", iface, level, surface);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     surface_impl = wined3d_resource_get_parent(sub_resource);
     *surface = &surface_impl->IDirect3DSurface9_iface;
     IDirect3DSurface9_AddRef(*surface);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -639,9 +630,7 @@ static DWORD WINAPI d3d9_texture_cube_GetLevelCount(IDirect3DCubeTexture9 *iface
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -696,13 +685,9 @@ static HRESULT WINAPI d3d9_texture_cube_GetLevelDesc(IDirect3DCubeTexture9 *ifac
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     level_count = wined3d_texture_get_level_count(texture->wined3d_texture);
     if (level >= level_count)
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
@@ -720,7 +705,6 @@ static HRESULT WINAPI d3d9_texture_cube_GetLevelDesc(IDirect3DCubeTexture9 *ifac
         desc->Width = wined3d_desc.width;
         desc->Height = wined3d_desc.height;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -736,25 +720,17 @@ static HRESULT WINAPI d3d9_texture_cube_GetCubeMapSurface(IDirect3DCubeTexture9
 
     TRACE("iface %p, face %#x, level %u, surface %p.\n", iface, face, level, surface);
 
-    wined3d_mutex_lock();
     level_count = wined3d_texture_get_level_count(texture->wined3d_texture);
     if (level >= level_count)
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     sub_resource_idx = level_count * face + level;
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, sub_resource_idx)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     surface_impl = wined3d_resource_get_parent(sub_resource);
     *surface = &surface_impl->IDirect3DSurface9_iface;
     IDirect3DSurface9_AddRef(*surface);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -1056,9 +1032,7 @@ static DWORD WINAPI d3d9_texture_3d_GetLevelCount(IDirect3DVolumeTexture9 *iface
 
     TRACE("iface %p.\n", iface);
 
-    wined3d_mutex_lock();
     ret = wined3d_texture_get_level_count(texture->wined3d_texture);
-    wined3d_mutex_unlock();
 
     return ret;
 }
@@ -1112,7 +1086,6 @@ static HRESULT WINAPI d3d9_texture_3d_GetLevelDesc(IDirect3DVolumeTexture9 *ifac
 
     TRACE("iface %p, level %u, desc %p.\n", iface, level, desc);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
         hr = D3DERR_INVALIDCALL;
     else
@@ -1128,7 +1101,6 @@ static HRESULT WINAPI d3d9_texture_3d_GetLevelDesc(IDirect3DVolumeTexture9 *ifac
         desc->Height = wined3d_desc.height;
         desc->Depth = wined3d_desc.depth;
     }
-    wined3d_mutex_unlock();
 
     return hr;
 }
@@ -1142,17 +1114,12 @@ static HRESULT WINAPI d3d9_texture_3d_GetVolumeLevel(IDirect3DVolumeTexture9 *if
 
     TRACE("iface %p, level %u, volume %p.\n", iface, level, volume);
 
-    wined3d_mutex_lock();
     if (!(sub_resource = wined3d_texture_get_sub_resource(texture->wined3d_texture, level)))
-    {
-        wined3d_mutex_unlock();
         return D3DERR_INVALIDCALL;
-    }
 
     volume_impl = wined3d_resource_get_parent(sub_resource);
     *volume = &volume_impl->IDirect3DVolume9_iface;
     IDirect3DVolume9_AddRef(*volume);
-    wined3d_mutex_unlock();
 
     return D3D_OK;
 }
@@ -1310,10 +1277,8 @@ HRESULT texture_init(struct d3d9_texture *texture, struct d3d9_device *device,
             levels = wined3d_log2i(max(width, height)) + 1;
     }
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, surface_flags,
             NULL, texture, &d3d9_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d texture, hr %#x.\n", hr);
@@ -1360,10 +1325,8 @@ HRESULT cubetexture_init(struct d3d9_texture *texture, struct d3d9_device *devic
             levels = wined3d_log2i(edge_length) + 1;
     }
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, surface_flags,
             NULL, texture, &d3d9_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d cube texture, hr %#x.\n", hr);
@@ -1406,10 +1369,8 @@ HRESULT volumetexture_init(struct d3d9_texture *texture, struct d3d9_device *dev
             levels = wined3d_log2i(max(max(width, height), depth)) + 1;
     }
 
-    wined3d_mutex_lock();
     hr = wined3d_texture_create(device->wined3d_device, &desc, levels, 0,
             NULL, texture, &d3d9_texture_wined3d_parent_ops, &texture->wined3d_texture);
-    wined3d_mutex_unlock();
     if (FAILED(hr))
     {
         WARN("Failed to create wined3d volume texture, hr %#x.\n", hr);
@@ -323,6 +323,16 @@ struct d3d_device
     /* Light state */
     DWORD material;
 
+    /* Legacy viewport, lights and material as last sent to wined3d. The
+     * generations come from ddraw_next_generation() and change with every
+     * update of the object. */
+    const struct d3d_viewport *applied_viewport;
+    DWORD applied_viewport_generation;
+    const struct d3d_light *applied_lights[32];
+    DWORD applied_light_generations[32];
+    const struct d3d_material *applied_material;
+    DWORD applied_material_generation;
+
     /* Rendering functions to wrap D3D(1-3) to D3D7 */
     D3DPRIMITIVETYPE primitive_type;
     DWORD vertex_type;
@@ -340,6 +350,7 @@ struct d3d_device
 HRESULT d3d_device_create(struct ddraw *ddraw, struct ddraw_surface *target, IUnknown *rt_iface,
         UINT version, struct d3d_device **device, IUnknown *outer_unknown) DECLSPEC_HIDDEN;
 enum wined3d_depth_buffer_type d3d_device_update_depth_stencil(struct d3d_device *device) DECLSPEC_HIDDEN;
+void d3d_device_invalidate_legacy_state(struct d3d_device *device) DECLSPEC_HIDDEN;
 
 /* The IID */
 extern const GUID IID_D3DDEVICE_WineD3D DECLSPEC_HIDDEN;
@@ -430,6 +441,7 @@ struct d3d_light
 
     D3DLIGHT2 light;
     D3DLIGHT7 light7;
+    DWORD generation;
 
     DWORD dwLightIndex;
 
@@ -458,6 +470,7 @@ struct d3d_material
 
     D3DMATERIAL mat;
     DWORD Handle;
+    DWORD generation;
 };
 
 /* Helper functions */
@@ -488,6 +501,7 @@ struct d3d_viewport
         D3DVIEWPORT vp1;
         D3DVIEWPORT2 vp2;
     } viewports;
+    DWORD generation;
 
     struct list entry;
     struct list light_list;
@@ -585,6 +599,7 @@ void DDSD_to_DDSD2(const DDSURFACEDESC *in, DDSURFACEDESC2 *out) DECLSPEC_HIDDEN
 void DDSD2_to_DDSD(const DDSURFACEDESC2 *in, DDSURFACEDESC *out) DECLSPEC_HIDDEN;
 
 void multiply_matrix_ddraw(D3DMATRIX *dst, const D3DMATRIX *src1, const D3DMATRIX *src2) DECLSPEC_HIDDEN;
+DWORD ddraw_next_generation(void) DECLSPEC_HIDDEN;
 
 static inline BOOL format_is_compressed(const DDPIXELFORMAT *format)
 {
@@ -5218,6 +5218,7 @@ static HRESULT d3d_device7_SetViewport(IDirect3DDevice7 *iface, D3DVIEWPORT7 *vi
     /* Note: D3DVIEWPORT7 is compatible with struct wined3d_viewport. */
     wined3d_mutex_lock();
     wined3d_device_set_viewport(device->wined3d_device, (struct wined3d_viewport *)viewport);
+    device->applied_viewport = NULL;
     wined3d_mutex_unlock();
 
     return D3D_OK;
@@ -5318,6 +5319,7 @@ static HRESULT d3d_device7_SetMaterial(IDirect3DDevice7 *iface, D3DMATERIAL7 *ma
     wined3d_mutex_lock();
     /* Note: D3DMATERIAL7 is compatible with struct wined3d_material. */
     wined3d_device_set_material(device->wined3d_device, (struct wined3d_material *)material);
+    device->applied_material = NULL;
     wined3d_mutex_unlock();
 
     return D3D_OK;
@@ -5413,6 +5415,8 @@ static HRESULT d3d_device7_SetLight(IDirect3DDevice7 *iface, DWORD light_idx, D3
     wined3d_mutex_lock();
     /* Note: D3DLIGHT7 is compatible with struct wined3d_light. */
     hr = wined3d_device_set_light(device->wined3d_device, light_idx, (struct wined3d_light *)light);
+    if (light_idx < sizeof(device->applied_lights) / sizeof(*device->applied_lights))
+        device->applied_lights[light_idx] = NULL;
     wined3d_mutex_unlock();
 
     return hr_ddraw_from_wined3d(hr);
@@ -5678,6 +5682,7 @@ static HRESULT d3d_device7_ApplyStateBlock(IDirect3DDevice7 *iface, DWORD stateb
     }
 
     wined3d_stateblock_apply(wined3d_sb);
+    d3d_device_invalidate_legacy_state(device);
     wined3d_mutex_unlock();
 
     return D3D_OK;
@@ -6777,6 +6782,15 @@ enum wined3d_depth_buffer_type d3d_device_update_depth_stencil(struct d3d_device
     return WINED3D_ZB_TRUE;
 }
 
+/* Forgets which legacy viewport, lights and material wined3d has, for when
+ * its state was changed behind their back. */
+void d3d_device_invalidate_legacy_state(struct d3d_device *device)
+{
+    device->applied_viewport = NULL;
+    memset(device->applied_lights, 0, sizeof(device->applied_lights));
+    device->applied_material = NULL;
+}
+
 static HRESULT d3d_device_init(struct d3d_device *device, struct ddraw *ddraw,
         struct ddraw_surface *target, IUnknown *rt_iface, UINT version, IUnknown *outer_unknown)
 {
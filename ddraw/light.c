@@ -39,7 +39,17 @@ static void light_update(struct d3d_light *light)
     if (!light->active_viewport || !light->active_viewport->active_device) return;
     device = light->active_viewport->active_device;
 
+    if (light->dwLightIndex < sizeof(device->applied_lights) / sizeof(*device->applied_lights)
+            && device->applied_lights[light->dwLightIndex] == light
+            && device->applied_light_generations[light->dwLightIndex] == light->generation)
+        return;
+
     IDirect3DDevice7_SetLight(&device->IDirect3DDevice7_iface, light->dwLightIndex, &light->light7);
+    if (light->dwLightIndex < sizeof(device->applied_lights) / sizeof(*device->applied_lights))
+    {
+        device->applied_lights[light->dwLightIndex] = light;
+        device->applied_light_generations[light->dwLightIndex] = light->generation;
+    }
 }
 
 /*****************************************************************************
@@ -194,6 +204,7 @@ static HRESULT WINAPI d3d_light_SetLight(IDirect3DLight *iface, D3DLIGHT *data)
     light7->dvPhi = data->dvPhi;
 
     wined3d_mutex_lock();
+    light->generation = ddraw_next_generation();
     memcpy(&light->light, data, sizeof(*data));
     if (!(light->light.dwFlags & D3DLIGHT_ACTIVE) && flags & D3DLIGHT_ACTIVE)
         light_activate(light);
@@ -249,6 +260,7 @@ void d3d_light_init(struct d3d_light *light, struct ddraw *ddraw)
     light->IDirect3DLight_iface.lpVtbl = &d3d_light_vtbl;
     light->ref = 1;
     light->ddraw = ddraw;
+    light->generation = ddraw_next_generation();
 }
 
 struct d3d_light *unsafe_impl_from_IDirect3DLight(IDirect3DLight *iface)
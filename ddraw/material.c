@@ -237,6 +237,7 @@ static HRESULT WINAPI d3d_material3_SetMaterial(IDirect3DMaterial3 *iface, D3DMA
     wined3d_mutex_lock();
     memset(&material->mat, 0, sizeof(material->mat));
     memcpy(&material->mat, mat, mat->dwSize);
+    material->generation = ddraw_next_generation();
     wined3d_mutex_unlock();
 
     return DD_OK;
@@ -446,17 +447,23 @@ static HRESULT WINAPI d3d_material1_GetMaterial(IDirect3DMaterial *iface, D3DMAT
  *****************************************************************************/
 void material_activate(struct d3d_material *material)
 {
+    struct d3d_device *device = material->active_device;
     D3DMATERIAL7 d3d7mat;
 
     TRACE("Activating material %p.\n", material);
 
+    if (device->applied_material == material && device->applied_material_generation == material->generation)
+        return;
+
     d3d7mat.u.diffuse = material->mat.u.diffuse;
     d3d7mat.u1.ambient = material->mat.u1.ambient;
     d3d7mat.u2.specular = material->mat.u2.specular;
     d3d7mat.u3.emissive = material->mat.u3.emissive;
     d3d7mat.u4.power = material->mat.u4.power;
 
-    IDirect3DDevice7_SetMaterial(&material->active_device->IDirect3DDevice7_iface, &d3d7mat);
+    IDirect3DDevice7_SetMaterial(&device->IDirect3DDevice7_iface, &d3d7mat);
+    device->applied_material = material;
+    device->applied_material_generation = material->generation;
 }
 
 static const struct IDirect3DMaterial3Vtbl d3d_material3_vtbl =
@@ -511,6 +518,7 @@ struct d3d_material *d3d_material_create(struct ddraw *ddraw)
     material->IDirect3DMaterial_iface.lpVtbl = &d3d_material1_vtbl;
     material->ref = 1;
     material->ddraw = ddraw;
+    material->generation = ddraw_next_generation();
 
     return material;
 }
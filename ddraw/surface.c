@@ -5860,6 +5860,8 @@ HRESULT ddraw_surface_create(struct ddraw *ddraw, const DDSURFACEDESC2 *surface_
                 free(texture);
                 return hr_ddraw_from_wined3d(hr);
             }
+            if (ddraw->d3ddevice)
+                d3d_device_invalidate_legacy_state(ddraw->d3ddevice);
         }
     }
 
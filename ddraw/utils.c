@@ -813,6 +813,15 @@ dump_D3DMATRIX(const D3DMATRIX *mat)
     TRACE("  %f %f %f %f\n", mat->_41, mat->_42, mat->_43, mat->_44);
 }
 
+/* Generations are never reused, so an object freed and reallocated at the
+ * same address can't be mistaken for one that was already applied. */
+DWORD ddraw_next_generation(void)
+{
+    static LONG generation;
+
+    return InterlockedIncrement(&generation);
+}
+
 DWORD
 get_flexible_vertex_size_ddraw(DWORD d3dvtVertexType)
 {
@@ -22,6 +22,11 @@
 
 #include "ddraw_private.h"
 
+#if defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define DDRAW_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
 
 #ifndef DDSCL_MULTITHREADED
 #define DDSCL_MULTITHREADED             0x00000400
@@ -60,6 +65,7 @@ static void update_clip_space(struct d3d_device *device,
  *****************************************************************************/
 void viewport_activate(struct d3d_viewport *This, BOOL ignore_lights)
 {
+    struct d3d_device *device = This->active_device;
     struct wined3d_vec3 scale, offset;
     D3DVIEWPORT7 vp;
 
@@ -74,6 +80,9 @@ void viewport_activate(struct d3d_viewport *This, BOOL ignore_lights)
         }
     }
 
+    if (device->applied_viewport == This && device->applied_viewport_generation == This->generation)
+        return;
+
     /* And copy the values in the structure used by the device */
     if (This->use_vp2)
     {
@@ -108,8 +117,10 @@ void viewport_activate(struct d3d_viewport *This, BOOL ignore_lights)
         offset.z = 0.0f;
     }
 
-    update_clip_space(This->active_device, &scale, &offset);
-    IDirect3DDevice7_SetViewport(&This->active_device->IDirect3DDevice7_iface, &vp);
+    update_clip_space(device, &scale, &offset);
+    IDirect3DDevice7_SetViewport(&device->IDirect3DDevice7_iface, &vp);
+    device->applied_viewport = This;
+    device->applied_viewport_generation = This->generation;
 }
 
 /*****************************************************************************
@@ -337,6 +348,7 @@ static HRESULT WINAPI d3d_viewport_SetViewport(IDirect3DViewport3 *iface, D3DVIE
     wined3d_mutex_lock();
 
     This->use_vp2 = 0;
+    This->generation = ddraw_next_generation();
     memset(&(This->viewports.vp1), 0, sizeof(This->viewports.vp1));
     memcpy(&(This->viewports.vp1), lpData, lpData->dwSize);
 
@@ -361,6 +373,189 @@ static HRESULT WINAPI d3d_viewport_SetViewport(IDirect3DViewport3 *iface, D3DVIE
     return DD_OK;
 }
 
+/* Transforms a single vertex and returns its clip flags. Clipped vertices are
+ * written out untransformed. */
+static DWORD viewport_transform_vertex(const float *in, float *out, D3DHVERTEX *out_h,
+        const D3DMATRIX *mat, const D3DVIEWPORT *vp, DWORD flags)
+{
+    float scaled_x, scaled_y, half_width, half_height;
+    float x, y, z, w;
+    DWORD clip = 0;
+
+    x = (in[0] * mat->_11) + (in[1] * mat->_21) + (in[2] * mat->_31) + mat->_41;
+    y = (in[0] * mat->_12) + (in[1] * mat->_22) + (in[2] * mat->_32) + mat->_42;
+    z = (in[0] * mat->_13) + (in[1] * mat->_23) + (in[2] * mat->_33) + mat->_43;
+    w = (in[0] * mat->_14) + (in[1] * mat->_24) + (in[2] * mat->_34) + mat->_44;
+
+    if (flags & D3DTRANSFORM_CLIPPED)
+    {
+        /* If clipping is enabled, Windows assumes that outH is
+         * a valid pointer
+         */
+        out_h->u1.hx = x; out_h->u2.hy = y; out_h->u3.hz = z;
+
+        /* Compare in single precision against the same thresholds as the
+         * SSE path, which handles all but the last few vertices. */
+        scaled_x = x * vp->dvScaleX;
+        scaled_y = y * vp->dvScaleY;
+        half_width = (float)vp->dwWidth * 0.5f;
+        half_height = (float)vp->dwHeight * 0.5f;
+        if (scaled_x > half_width)
+            clip |= D3DCLIP_RIGHT;
+        if (scaled_x <= -half_width)
+            clip |= D3DCLIP_LEFT;
+        if (scaled_y > half_height)
+            clip |= D3DCLIP_TOP;
+        if (scaled_y <= -half_height)
+            clip |= D3DCLIP_BOTTOM;
+        if (z < 0.0)
+            clip |= D3DCLIP_FRONT;
+        if (z > 1.0)
+            clip |= D3DCLIP_BACK;
+        out_h->dwFlags = clip;
+
+        if (clip)
+        {
+            /* Looks like native just drops the vertex, leaves whatever data
+             * it has in the output buffer and goes on with the next vertex.
+             * The exact scheme hasn't been figured out yet, but windows
+             * definitely writes something there.
+             */
+            out[0] = x;
+            out[1] = y;
+            out[2] = z;
+            out[3] = w;
+            return clip;
+        }
+    }
+
+    w = 1 / w;
+    x *= w; y *= w; z *= w;
+
+    out[0] = vp->dwWidth / 2 + vp->dwX + x * vp->dvScaleX;
+    out[1] = vp->dwHeight / 2 + vp->dwY - y * vp->dvScaleY;
+    out[2] = z;
+    out[3] = w;
+
+    return clip;
+}
+
+#ifdef DDRAW_TRANSFORM_SSE
+/* Transforms groups of four vertices in SoA form, with the same operation
+ * order as viewport_transform_vertex() and the same single precision clip
+ * thresholds. The results aren't guaranteed to be identical though: a
+ * compiler that keeps the scalar intermediates in x87 extended precision can
+ * round differently in the last bit. Returns the number of vertices transformed; the remaining ones are left to
+ * viewport_transform_vertex(). "clip_and" accumulates the clip flags that
+ * all vertices share. */
+static unsigned int viewport_transform_vertices_sse(unsigned int count, const D3DTRANSFORMDATA *data,
+        const D3DMATRIX *mat, const D3DVIEWPORT *vp, DWORD flags, DWORD *clip_and)
+{
+    static const DWORD planes[] =
+    {
+        D3DCLIP_RIGHT, D3DCLIP_LEFT, D3DCLIP_TOP, D3DCLIP_BOTTOM, D3DCLIP_FRONT, D3DCLIP_BACK,
+    };
+    const __m128 right = _mm_set1_ps((float)vp->dwWidth * 0.5f);
+    const __m128 left = _mm_set1_ps(-((float)vp->dwWidth) * 0.5f);
+    const __m128 top = _mm_set1_ps((float)vp->dwHeight * 0.5f);
+    const __m128 bottom = _mm_set1_ps(-((float)vp->dwHeight) * 0.5f);
+    const __m128 scale_x = _mm_set1_ps(vp->dvScaleX);
+    const __m128 scale_y = _mm_set1_ps(vp->dvScaleY);
+    const __m128 offset_x = _mm_set1_ps((float)(vp->dwWidth / 2 + vp->dwX));
+    const __m128 offset_y = _mm_set1_ps((float)(vp->dwHeight / 2 + vp->dwY));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const BYTE *in = data->lpIn;
+    BYTE *out = data->lpOut;
+    D3DHVERTEX *out_h = data->lpHOut;
+    __m128 ix, iy, iz, x, y, z, w, rw, px, py, pz;
+    float raw[4][4], projected[4][4];
+    const float *v[4];
+    unsigned int i, j, k;
+    DWORD clip[4];
+    int masks[6];
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        for (j = 0; j < 4; ++j)
+        {
+            v[j] = (const float *)in;
+            in += data->dwInSize;
+        }
+
+        ix = _mm_setr_ps(v[0][0], v[1][0], v[2][0], v[3][0]);
+        iy = _mm_setr_ps(v[0][1], v[1][1], v[2][1], v[3][1]);
+        iz = _mm_setr_ps(v[0][2], v[1][2], v[2][2], v[3][2]);
+
+        x = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ix, _mm_set1_ps(mat->_11)),
+                _mm_mul_ps(iy, _mm_set1_ps(mat->_21))), _mm_mul_ps(iz, _mm_set1_ps(mat->_31))),
+                _mm_set1_ps(mat->_41));
+        y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ix, _mm_set1_ps(mat->_12)),
+                _mm_mul_ps(iy, _mm_set1_ps(mat->_22))), _mm_mul_ps(iz, _mm_set1_ps(mat->_32))),
+                _mm_set1_ps(mat->_42));
+        z = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ix, _mm_set1_ps(mat->_13)),
+                _mm_mul_ps(iy, _mm_set1_ps(mat->_23))), _mm_mul_ps(iz, _mm_set1_ps(mat->_33))),
+                _mm_set1_ps(mat->_43));
+        w = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ix, _mm_set1_ps(mat->_14)),
+                _mm_mul_ps(iy, _mm_set1_ps(mat->_24))), _mm_mul_ps(iz, _mm_set1_ps(mat->_34))),
+                _mm_set1_ps(mat->_44));
+
+        memset(clip, 0, sizeof(clip));
+        if (flags & D3DTRANSFORM_CLIPPED)
+        {
+            masks[0] = _mm_movemask_ps(_mm_cmpgt_ps(_mm_mul_ps(x, scale_x), right));
+            masks[1] = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(x, scale_x), left));
+            masks[2] = _mm_movemask_ps(_mm_cmpgt_ps(_mm_mul_ps(y, scale_y), top));
+            masks[3] = _mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(y, scale_y), bottom));
+            masks[4] = _mm_movemask_ps(_mm_cmplt_ps(z, zero));
+            masks[5] = _mm_movemask_ps(_mm_cmpgt_ps(z, one));
+
+            for (k = 0; k < 6; ++k)
+            {
+                for (j = 0; j < 4; ++j)
+                {
+                    if (masks[k] & (1 << j))
+                        clip[j] |= planes[k];
+                }
+            }
+        }
+
+        rw = _mm_div_ps(one, w);
+        px = _mm_add_ps(offset_x, _mm_mul_ps(_mm_mul_ps(x, rw), scale_x));
+        py = _mm_sub_ps(offset_y, _mm_mul_ps(_mm_mul_ps(y, rw), scale_y));
+        pz = _mm_mul_ps(z, rw);
+
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(raw[0], x);
+        _mm_storeu_ps(raw[1], y);
+        _mm_storeu_ps(raw[2], z);
+        _mm_storeu_ps(raw[3], w);
+        _MM_TRANSPOSE4_PS(px, py, pz, rw);
+        _mm_storeu_ps(projected[0], px);
+        _mm_storeu_ps(projected[1], py);
+        _mm_storeu_ps(projected[2], pz);
+        _mm_storeu_ps(projected[3], rw);
+
+        for (j = 0; j < 4; ++j)
+        {
+            if (flags & D3DTRANSFORM_CLIPPED)
+            {
+                out_h->u1.hx = raw[j][0];
+                out_h->u2.hy = raw[j][1];
+                out_h->u3.hz = raw[j][2];
+                out_h->dwFlags = clip[j];
+                ++out_h;
+            }
+            memcpy(out, clip[j] ? raw[j] : projected[j], sizeof(raw[j]));
+            out += data->dwOutSize;
+            *clip_and &= clip[j];
+        }
+    }
+
+    return i;
+}
+#endif
+
 /*****************************************************************************
  * IDirect3DViewport3::TransformVertices
  *
@@ -394,11 +589,11 @@ static HRESULT WINAPI d3d_viewport_TransformVertices(IDirect3DViewport3 *iface,
     struct d3d_viewport *viewport = impl_from_IDirect3DViewport3(iface);
     D3DVIEWPORT vp = viewport->viewports.vp1;
     D3DMATRIX view_mat, world_mat, mat;
+    DWORD clip_and = ~0u;
+    unsigned int i = 0;
+    D3DHVERTEX *outH;
     float *in;
     float *out;
-    float x, y, z, w;
-    unsigned int i;
-    D3DHVERTEX *outH;
 
     TRACE("iface %p, vertex_count %u, vertex_data %p, flags %#x, clip_plane %p.\n",
             iface, dwVertexCount, lpData, dwFlags, lpOffScreen);
@@ -427,63 +622,19 @@ static HRESULT WINAPI d3d_viewport_TransformVertices(IDirect3DViewport3 *iface,
     multiply_matrix_ddraw(&mat, &view_mat, &world_mat);
     multiply_matrix_ddraw(&mat, &viewport->active_device->legacy_projection, &mat);
 
-    in = lpData->lpIn;
-    out = lpData->lpOut;
+#ifdef DDRAW_TRANSFORM_SSE
+    i = viewport_transform_vertices_sse(dwVertexCount, lpData, &mat, &vp, dwFlags, &clip_and);
+#endif
+
+    in = (float *)((char *)lpData->lpIn + i * lpData->dwInSize);
+    out = (float *)((char *)lpData->lpOut + i * lpData->dwOutSize);
     outH = lpData->lpHOut;
-    for(i = 0; i < dwVertexCount; i++)
+    for (; i < dwVertexCount; ++i)
     {
-        x = (in[0] * mat._11) + (in[1] * mat._21) + (in[2] * mat._31) + mat._41;
-        y = (in[0] * mat._12) + (in[1] * mat._22) + (in[2] * mat._32) + mat._42;
-        z = (in[0] * mat._13) + (in[1] * mat._23) + (in[2] * mat._33) + mat._43;
-        w = (in[0] * mat._14) + (in[1] * mat._24) + (in[2] * mat._34) + mat._44;
-
-        if(dwFlags & D3DTRANSFORM_CLIPPED)
-        {
-            /* If clipping is enabled, Windows assumes that outH is
-             * a valid pointer
-             */
-            outH[i].u1.hx = x; outH[i].u2.hy = y; outH[i].u3.hz = z;
-
-            outH[i].dwFlags = 0;
-            if(x * vp.dvScaleX > ((float) vp.dwWidth * 0.5))
-                outH[i].dwFlags |= D3DCLIP_RIGHT;
-            if(x * vp.dvScaleX <= -((float) vp.dwWidth) * 0.5)
-                outH[i].dwFlags |= D3DCLIP_LEFT;
-            if(y * vp.dvScaleY > ((float) vp.dwHeight * 0.5))
-                outH[i].dwFlags |= D3DCLIP_TOP;
-            if(y * vp.dvScaleY <= -((float) vp.dwHeight) * 0.5)
-                outH[i].dwFlags |= D3DCLIP_BOTTOM;
-            if(z < 0.0)
-                outH[i].dwFlags |= D3DCLIP_FRONT;
-            if(z > 1.0)
-                outH[i].dwFlags |= D3DCLIP_BACK;
-
-            if(outH[i].dwFlags)
-            {
-                /* Looks like native just drops the vertex, leaves whatever data
-                 * it has in the output buffer and goes on with the next vertex.
-                 * The exact scheme hasn't been figured out yet, but windows
-                 * definitely writes something there.
-                 */
-                out[0] = x;
-                out[1] = y;
-                out[2] = z;
-                out[3] = w;
-                in = (float *) ((char *) in + lpData->dwInSize);
-                out = (float *) ((char *) out + lpData->dwOutSize);
-                continue;
-            }
-        }
-
-        w = 1 / w;
-        x *= w; y *= w; z *= w;
-
-        out[0] = vp.dwWidth / 2 + vp.dwX + x * vp.dvScaleX;
-        out[1] = vp.dwHeight / 2 + vp.dwY - y * vp.dvScaleY;
-        out[2] = z;
-        out[3] = w;
-        in = (float *) ((char *) in + lpData->dwInSize);
-        out = (float *) ((char *) out + lpData->dwOutSize);
+        clip_and &= viewport_transform_vertex(in, out,
+                dwFlags & D3DTRANSFORM_CLIPPED ? &outH[i] : NULL, &mat, &vp, dwFlags);
+        in = (float *)((char *)in + lpData->dwInSize);
+        out = (float *)((char *)out + lpData->dwOutSize);
     }
 
     /* According to the d3d test, the offscreen flag is set only
@@ -496,7 +647,7 @@ static HRESULT WINAPI d3d_viewport_TransformVertices(IDirect3DViewport3 *iface,
      */
     if(dwVertexCount == 1 && dwFlags & D3DTRANSFORM_CLIPPED)
     {
-        *lpOffScreen = outH[0].dwFlags;
+        *lpOffScreen = clip_and;
     }
     else if(*lpOffScreen)
     {
@@ -959,6 +1110,7 @@ static HRESULT WINAPI d3d_viewport_SetViewport2(IDirect3DViewport3 *iface, D3DVI
     wined3d_mutex_lock();
 
     This->use_vp2 = 1;
+    This->generation = ddraw_next_generation();
     memset(&(This->viewports.vp2), 0, sizeof(This->viewports.vp2));
     memcpy(&(This->viewports.vp2), lpData, lpData->dwSize);
 
@@ -1144,5 +1296,6 @@ void d3d_viewport_init(struct d3d_viewport *viewport, struct ddraw *ddraw)
     viewport->ref = 1;
     viewport->ddraw = ddraw;
     viewport->use_vp2 = 0xff;
+    viewport->generation = ddraw_next_generation();
     list_init(&viewport->light_list);
 }
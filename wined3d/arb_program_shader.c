@@ -295,7 +295,7 @@ struct shader_arb_priv
     GLuint                  depth_blt_fprogram_id_full[WINED3D_GL_RES_TYPE_COUNT];
     GLuint                  depth_blt_fprogram_id_masked[WINED3D_GL_RES_TYPE_COUNT];
     BOOL                    use_arbfp_fixed_func;
-    struct wine_rb_tree     fragment_shaders;
+    struct wined3d_ffp_frag_programs fragment_shaders;
     BOOL                    last_ps_const_clamped;
     BOOL                    last_vs_color_unclamp;
 
@@ -3612,7 +3612,6 @@ static GLuint shader_arb_generate_pshader(const struct wined3d_shader *shader,
         const struct arb_ps_compile_args *args, struct arb_ps_compiled_shader *compiled)
 {
     const struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
-    const DWORD *function = shader->function;
     GLuint retval;
     char fragcolor[16];
     DWORD next_local = 0;
@@ -3912,7 +3911,7 @@ static GLuint shader_arb_generate_pshader(const struct wined3d_shader *shader,
     }
 
     /* Base Shader Body */
-    shader_generate_main(shader, buffer, reg_maps, function, &priv_ctx);
+    shader_generate_main(shader, buffer, reg_maps, &priv_ctx);
 
     if(args->super.srgb_correction) {
         arbfp_add_sRGB_correction(buffer, fragcolor, srgbtmp[0], srgbtmp[1], srgbtmp[2], srgbtmp[3],
@@ -4216,7 +4215,6 @@ static GLuint shader_arb_generate_vshader(const struct wined3d_shader *shader,
     const struct arb_vshader_private *shader_data = shader->backend_data;
     const struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
     struct shader_arb_priv *priv = shader->device->shader_priv;
-    const DWORD *function = shader->function;
     GLuint ret;
     DWORD next_local = 0;
     struct shader_arb_ctx_priv priv_ctx;
@@ -4326,7 +4324,7 @@ static GLuint shader_arb_generate_vshader(const struct wined3d_shader *shader,
     /* The shader starts with the main function */
     priv_ctx.in_main_func = TRUE;
     /* Base Shader Body */
-    shader_generate_main(shader, buffer, reg_maps, function, &priv_ctx);
+    shader_generate_main(shader, buffer, reg_maps, &priv_ctx);
 
     if (!priv_ctx.footer_written) vshader_add_footer(&priv_ctx,
             shader_data, args, reg_maps, gl_info, buffer);
@@ -4953,6 +4951,8 @@ static void shader_arb_destroy(struct wined3d_shader *shader)
     }
 }
 
+static void shader_arb_share(struct wined3d_shader *shader, struct wined3d_shader *source) {}
+
 static int sig_tree_compare(const void *key, const struct wine_rb_entry *entry)
 {
     struct ps_signature *e = WINE_RB_ENTRY_VALUE(entry, struct ps_signature, entry);
@@ -5768,6 +5768,7 @@ const struct wined3d_shader_backend_ops arb_program_shader_backend =
     shader_arb_update_float_pixel_constants,
     shader_arb_load_constants,
     shader_arb_destroy,
+    shader_arb_share,
     shader_arb_alloc,
     shader_arb_free,
     shader_arb_allocate_context_data,
@@ -5821,23 +5822,17 @@ static void *arbfp_alloc(const struct wined3d_shader_backend_ops *shader_backend
     else if (!(priv = calloc(1, sizeof(*priv))))
         return NULL;
 
-    if (wine_rb_init(&priv->fragment_shaders, &wined3d_ffp_frag_program_rb_functions) == -1)
-    {
-        ERR("Failed to initialize rbtree.\n");
-        if (priv != shader_priv)
-            free(priv);
-        return NULL;
-    }
+    wined3d_ffp_frag_programs_init(&priv->fragment_shaders);
     priv->use_arbfp_fixed_func = TRUE;
 
     return priv;
 }
 
 /* Context activation is done by the caller. */
-static void arbfp_free_ffpshader(struct wine_rb_entry *entry, void *context)
+static void arbfp_free_ffpshader(struct ffp_frag_desc *desc, void *context)
 {
     const struct wined3d_gl_info *gl_info = context;
-    struct arbfp_ffp_desc *entry_arb = WINE_RB_ENTRY_VALUE(entry, struct arbfp_ffp_desc, parent.entry);
+    struct arbfp_ffp_desc *entry_arb = CONTAINING_RECORD(desc, struct arbfp_ffp_desc, parent);
 
     GL_EXTCALL(glDeleteProgramsARB(1, &entry_arb->shader));
     checkGLcall("glDeleteProgramsARB(1, &entry_arb->shader)");
@@ -5849,7 +5844,7 @@ static void arbfp_free(struct wined3d_device *device)
 {
     struct shader_arb_priv *priv = device->fragment_priv;
 
-    wine_rb_destroy(&priv->fragment_shaders, arbfp_free_ffpshader, &device->adapter->gl_info);
+    wined3d_ffp_frag_programs_destroy(&priv->fragment_shaders, arbfp_free_ffpshader, &device->adapter->gl_info);
     priv->use_arbfp_fixed_func = FALSE;
 
     if (device->shader_backend != &arb_program_shader_backend)
@@ -6645,7 +6640,8 @@ static void fragment_prog_arbfp(struct wined3d_context *context, const struct wi
         /* Find or create a shader implementing the fixed function pipeline
          * settings, then activate it. */
         gen_ffp_frag_op(context, state, &settings, FALSE);
-        desc = (const struct arbfp_ffp_desc *)find_ffp_frag_shader(&priv->fragment_shaders, &settings);
+        desc = (const struct arbfp_ffp_desc *)find_ffp_frag_shader(context,
+                &priv->fragment_shaders, &settings);
         if(!desc) {
             struct arbfp_ffp_desc *new_desc = malloc(sizeof(*new_desc));
             if (!new_desc)
@@ -6656,7 +6652,7 @@ static void fragment_prog_arbfp(struct wined3d_context *context, const struct wi
 
             new_desc->parent.settings = settings;
             new_desc->shader = gen_arbfp_ffp_shader(&settings, gl_info);
-            add_ffp_frag_shader(&priv->fragment_shaders, &new_desc->parent);
+            add_ffp_frag_shader(context, &priv->fragment_shaders, &new_desc->parent);
             TRACE("Allocated fixed function replacement shader descriptor %p\n", new_desc);
             desc = new_desc;
         }
@@ -58,7 +58,7 @@ struct atifs_ffp_desc
 
 struct atifs_private_data
 {
-    struct wine_rb_tree fragment_shaders; /* A rb-tree to track fragment pipeline replacement shaders */
+    struct wined3d_ffp_frag_programs fragment_shaders; /* Fragment pipeline replacement shaders */
 };
 
 struct atifs_context_private_data
@@ -1023,7 +1023,8 @@ static void set_tex_op_atifs(struct wined3d_context *context, const struct wined
     unsigned int i;
 
     gen_ffp_frag_op(context, state, &settings, TRUE);
-    desc = (const struct atifs_ffp_desc *)find_ffp_frag_shader(&priv->fragment_shaders, &settings);
+    desc = (const struct atifs_ffp_desc *)find_ffp_frag_shader(context,
+            &priv->fragment_shaders, &settings);
     if(!desc) {
         struct atifs_ffp_desc *new_desc = calloc(1, sizeof(*new_desc));
         if (!new_desc)
@@ -1041,7 +1042,7 @@ static void set_tex_op_atifs(struct wined3d_context *context, const struct wined
 
         new_desc->parent.settings = settings;
         new_desc->shader = gen_ati_shader(settings.op, gl_info, new_desc->constants);
-        add_ffp_frag_shader(&priv->fragment_shaders, &new_desc->parent);
+        add_ffp_frag_shader(context, &priv->fragment_shaders, &new_desc->parent);
         TRACE("Allocated fixed function replacement shader descriptor %p\n", new_desc);
         desc = new_desc;
     }
@@ -1323,21 +1324,16 @@ static void *atifs_alloc(const struct wined3d_shader_backend_ops *shader_backend
     if (!(priv = calloc(1, sizeof(*priv))))
         return NULL;
 
-    if (wine_rb_init(&priv->fragment_shaders, &wined3d_ffp_frag_program_rb_functions) == -1)
-    {
-        ERR("Failed to initialize rbtree.\n");
-        free(priv);
-        return NULL;
-    }
+    wined3d_ffp_frag_programs_init(&priv->fragment_shaders);
 
     return priv;
 }
 
 /* Context activation is done by the caller. */
-static void atifs_free_ffpshader(struct wine_rb_entry *entry, void *cb_ctx)
+static void atifs_free_ffpshader(struct ffp_frag_desc *desc, void *cb_ctx)
 {
     const struct wined3d_gl_info *gl_info = cb_ctx;
-    struct atifs_ffp_desc *entry_ati = WINE_RB_ENTRY_VALUE(entry, struct atifs_ffp_desc, parent.entry);
+    struct atifs_ffp_desc *entry_ati = CONTAINING_RECORD(desc, struct atifs_ffp_desc, parent);
 
     GL_EXTCALL(glDeleteFragmentShaderATI(entry_ati->shader));
     checkGLcall("glDeleteFragmentShaderATI(entry->shader)");
@@ -1349,7 +1345,7 @@ static void atifs_free(struct wined3d_device *device)
 {
     struct atifs_private_data *priv = device->fragment_priv;
 
-    wine_rb_destroy(&priv->fragment_shaders, atifs_free_ffpshader, &device->adapter->gl_info);
+    wined3d_ffp_frag_programs_destroy(&priv->fragment_shaders, atifs_free_ffpshader, &device->adapter->gl_info);
 
     free(priv);
     device->fragment_priv = NULL;
@@ -38,6 +38,7 @@ WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 #define WINED3D_BUFFER_DISCARD      0x10    /* A DISCARD lock has occurred since the last preload. */
 #define WINED3D_BUFFER_SYNC         0x20    /* There has been at least one synchronized map since the last preload. */
 #define WINED3D_BUFFER_APPLESYNC    0x40    /* Using sync as in GL_APPLE_flush_buffer_range. */
+#define WINED3D_BUFFER_USED         0x80    /* The buffer object may have been drawn from since it was renamed. */
 
 #define VB_MAXDECLCHANGES     100     /* After that number of decl changes we stop converting */
 #define VB_RESETDECLCHANGE    1000    /* Reset the decl changecount after that number of draws */
@@ -105,12 +106,22 @@ static BOOL buffer_is_fully_dirty(const struct wined3d_buffer *buffer)
 /* Context activation is done by the caller */
 static void delete_gl_buffer(struct wined3d_buffer *This, const struct wined3d_gl_info *gl_info)
 {
+    unsigned int i;
+
     if(!This->buffer_object) return;
 
     GL_EXTCALL(glDeleteBuffers(1, &This->buffer_object));
     checkGLcall("glDeleteBuffers");
     This->buffer_object = 0;
 
+    for (i = 0; i < This->spare_count; ++i)
+    {
+        GL_EXTCALL(glDeleteBuffers(1, &This->spares[i].buffer_object));
+        checkGLcall("glDeleteBuffers");
+        wined3d_event_query_destroy(This->spares[i].query);
+    }
+    This->spare_count = 0;
+
     if(This->query)
     {
         wined3d_event_query_destroy(This->query);
@@ -747,12 +758,94 @@ drop_query:
     This->flags &= ~WINED3D_BUFFER_APPLESYNC;
 }
 
+/* Context activation is done by the caller. Called for DISCARD maps of
+ * dynamic buffers. Particle and UI code discards the same buffer every frame
+ * while the GPU is still drawing from it, and not every driver orphans the
+ * storage instead of waiting. The buffer switches to a spare buffer object
+ * the GPU is done with, and the current one is fenced and becomes a spare.
+ * Returns FALSE if there is no idle spare and no room for another one. */
+static BOOL buffer_rename(struct wined3d_buffer *buffer, struct wined3d_context *context)
+{
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+    struct wined3d_device *device = buffer->resource.device;
+    struct wined3d_buffer_spare *spare = NULL;
+    enum wined3d_event_query_result ret;
+    unsigned int i;
+    GLuint name;
+
+    /* GL_APPLE_flush_buffer_range state is per buffer object, don't bother
+     * keeping it in sync across several of them. */
+    if (!(buffer->resource.usage & WINED3DUSAGE_DYNAMIC) || !(buffer->flags & WINED3D_BUFFER_USED)
+            || buffer->flags & (WINED3D_BUFFER_FLUSH | WINED3D_BUFFER_APPLESYNC)
+            || !wined3d_event_query_supported(gl_info))
+        return FALSE;
+
+    for (i = 0; i < buffer->spare_count; ++i)
+    {
+        ret = wined3d_event_query_test(buffer->spares[i].query, device);
+        if (ret == WINED3D_EVENT_QUERY_OK || ret == WINED3D_EVENT_QUERY_NOT_STARTED)
+        {
+            spare = &buffer->spares[i];
+            break;
+        }
+    }
+
+    if (!spare)
+    {
+        if (buffer->spare_count == WINED3D_BUFFER_SPARE_COUNT)
+        {
+            TRACE("All spare buffer objects of buffer %p are busy.\n", buffer);
+            return FALSE;
+        }
+
+        spare = &buffer->spares[buffer->spare_count];
+        if (!(spare->query = calloc(1, sizeof(*spare->query))))
+            return FALSE;
+
+        GL_EXTCALL(glGenBuffers(1, &spare->buffer_object));
+        checkGLcall("glGenBuffers");
+        if (!spare->buffer_object)
+        {
+            free(spare->query);
+            spare->query = NULL;
+            return FALSE;
+        }
+        GL_EXTCALL(glBindBuffer(buffer->buffer_type_hint, spare->buffer_object));
+        GL_EXTCALL(glBufferData(buffer->buffer_type_hint, buffer->resource.size, NULL, buffer->buffer_object_usage));
+        checkGLcall("glBufferData");
+        ++buffer->spare_count;
+
+        TRACE("Created spare buffer object %u for buffer %p.\n", spare->buffer_object, buffer);
+    }
+
+    name = spare->buffer_object;
+    spare->buffer_object = buffer->buffer_object;
+    wined3d_event_query_issue(spare->query, device);
+    buffer->buffer_object = name;
+    buffer->flags &= ~WINED3D_BUFFER_USED;
+
+    TRACE("Renamed buffer %p to buffer object %u.\n", buffer, name);
+
+    if (buffer->buffer_type_hint == GL_ELEMENT_ARRAY_BUFFER_ARB)
+        device_invalidate_state(device, STATE_INDEXBUFFER);
+    else if (buffer->resource.bind_count)
+        device_invalidate_state(device, STATE_STREAMSRC);
+
+    return TRUE;
+}
+
 /* The caller provides a GL context */
-static void buffer_direct_upload(struct wined3d_buffer *This, const struct wined3d_gl_info *gl_info, DWORD flags)
+static void buffer_direct_upload(struct wined3d_buffer *This, struct wined3d_context *context, DWORD flags)
 {
+    const struct wined3d_gl_info *gl_info = context->gl_info;
     BYTE *map;
     UINT start = 0, len = 0;
 
+    /* A DISCARD map invalidated the whole buffer, so all of it is about to be
+     * written and an idle buffer object can be mapped without any syncing. */
+    if (flags & WINED3D_BUFFER_DISCARD && buffer_rename(This, context))
+        flags &= ~(WINED3D_BUFFER_DISCARD | WINED3D_BUFFER_SYNC);
+
     /* This potentially invalidates the element array buffer binding, but the
      * caller always takes care of this. */
     GL_EXTCALL(glBindBuffer(This->buffer_type_hint, This->buffer_object));
@@ -838,6 +931,7 @@ static UINT wined3d_buffer_stream_offset_right(UINT x, UINT offset, UINT stride)
 void buffer_mark_used(struct wined3d_buffer *buffer)
 {
     buffer->flags &= ~(WINED3D_BUFFER_SYNC | WINED3D_BUFFER_DISCARD);
+    buffer->flags |= WINED3D_BUFFER_USED;
 }
 
 /* Context activation is done by the caller. */
@@ -999,7 +1093,7 @@ void buffer_internal_preload(struct wined3d_buffer *buffer, struct wined3d_conte
             return;
         }
 
-        buffer_direct_upload(buffer, context->gl_info, flags);
+        buffer_direct_upload(buffer, context, flags);
 
         return;
     }
@@ -1156,17 +1250,23 @@ HRESULT CDECL wined3d_buffer_map(struct wined3d_buffer *buffer, UINT offset, UIN
                 struct wined3d_device *device = buffer->resource.device;
                 struct wined3d_context *context;
                 const struct wined3d_gl_info *gl_info;
+                DWORD map_flags;
 
                 context = context_acquire(device, NULL);
                 gl_info = context->gl_info;
 
+                /* Nothing can be drawing from a freshly renamed buffer object. */
+                map_flags = flags;
+                if (flags & WINED3D_MAP_DISCARD && buffer_rename(buffer, context))
+                    map_flags = (flags & ~WINED3D_MAP_DISCARD) | WINED3D_MAP_NOOVERWRITE;
+
                 if (buffer->buffer_type_hint == GL_ELEMENT_ARRAY_BUFFER_ARB)
                     context_invalidate_state(context, STATE_INDEXBUFFER);
                 GL_EXTCALL(glBindBuffer(buffer->buffer_type_hint, buffer->buffer_object));
 
                 if (gl_info->supported[ARB_MAP_BUFFER_RANGE])
                 {
-                    GLbitfield mapflags = wined3d_resource_gl_map_flags(flags);
+                    GLbitfield mapflags = wined3d_resource_gl_map_flags(map_flags);
                     buffer->map_ptr = GL_EXTCALL(glMapBufferRange(buffer->buffer_type_hint,
                             0, buffer->resource.size, mapflags));
                     checkGLcall("glMapBufferRange");
@@ -1174,7 +1274,7 @@ HRESULT CDECL wined3d_buffer_map(struct wined3d_buffer *buffer, UINT offset, UIN
                 else
                 {
                     if (buffer->flags & WINED3D_BUFFER_APPLESYNC)
-                        buffer_sync_apple(buffer, flags, gl_info);
+                        buffer_sync_apple(buffer, map_flags, gl_info);
                     buffer->map_ptr = GL_EXTCALL(glMapBuffer(buffer->buffer_type_hint,
                             GL_READ_WRITE));
                     checkGLcall("glMapBuffer");
@@ -1449,6 +1549,8 @@ static HRESULT buffer_init(struct wined3d_buffer *buffer, struct wined3d_device
     }
     buffer->maps_size = 1;
 
+    device_resource_add(device, &buffer->resource);
+
     return WINED3D_OK;
 }
 
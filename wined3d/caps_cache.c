@@ -0,0 +1,303 @@
+/*
+ * Persistent cache of the GL format capabilities found by probing
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <stdio.h>
+
+#include "wined3d_private.h"
+#include "wine9x.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+
+/* Checking FBO attachability, filtering and the polygon offset scale draws
+ * and reads back from a number of test framebuffers, which dominates adapter
+ * initialisation. The results only depend on the driver and on the format
+ * table before probing, so they are stored in a file and reused until either
+ * of those changes.
+ *
+ * The file consists of the header, the key (a string identifying the driver
+ * and wine9x version) and one entry per format. The checksum covers the whole
+ * file with the checksum field set to 0. Bump the version whenever the layout
+ * or the probes change. */
+
+#define WINED3D_CAPS_CACHE_MAGIC    0x43433957 /* "W9CC" */
+#define WINED3D_CAPS_CACHE_VERSION  1
+#define WINED3D_CAPS_CACHE_MAX_SIZE (1024 * 1024)
+
+struct wined3d_caps_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    DWORD checksum;
+    DWORD key_size;
+    DWORD format_count;
+    DWORD format_hash;
+    float fixed_polyoffset_scale;
+    float float_polyoffset_scale;
+};
+
+struct wined3d_caps_cache_format
+{
+    DWORD id;
+    GLint rt_internal;
+    unsigned int flags[WINED3D_GL_RES_TYPE_COUNT];
+};
+
+/* Everything that feeds the probes: the format table after the extension
+ * dependent setup. */
+DWORD wined3d_caps_cache_hash_formats(const struct wined3d_gl_info *gl_info, unsigned int format_count)
+{
+    DWORD hash = WINED3D_HASH_SEED;
+    unsigned int i;
+
+    for (i = 0; i < format_count; ++i)
+    {
+        const struct wined3d_format *format = &gl_info->formats[i];
+
+        hash = wined3d_hash_fnv1a(hash, &format->id, sizeof(format->id));
+        hash = wined3d_hash_fnv1a(hash, &format->glInternal, sizeof(format->glInternal));
+        hash = wined3d_hash_fnv1a(hash, &format->glGammaInternal, sizeof(format->glGammaInternal));
+        hash = wined3d_hash_fnv1a(hash, &format->rtInternal, sizeof(format->rtInternal));
+        hash = wined3d_hash_fnv1a(hash, &format->glFormat, sizeof(format->glFormat));
+        hash = wined3d_hash_fnv1a(hash, &format->glType, sizeof(format->glType));
+        hash = wined3d_hash_fnv1a(hash, format->flags, sizeof(format->flags));
+    }
+
+    return hash;
+}
+
+static const char *caps_cache_gl_string(const struct wined3d_gl_info *gl_info, GLenum name)
+{
+    const char *str = (const char *)gl_info->gl_ops.gl.p_glGetString(name);
+
+    return str ? str : "";
+}
+
+/* Context activation is done by the caller. */
+static char *caps_cache_create_key(const struct wined3d_gl_info *gl_info, DWORD *size)
+{
+    const char *vendor = caps_cache_gl_string(gl_info, GL_VENDOR);
+    const char *renderer = caps_cache_gl_string(gl_info, GL_RENDERER);
+    const char *version = caps_cache_gl_string(gl_info, GL_VERSION);
+    char *key;
+    int len;
+
+    if (!(key = calloc(1, strlen(vendor) + strlen(renderer) + strlen(version) + 128)))
+        return NULL;
+
+    len = sprintf(key, "%s\n%s\n%s\n%s %u\n%#x %d", vendor, renderer, version,
+            WINE9X_VERSION_STR, WINED3D_CAPS_CACHE_VERSION,
+            gl_info->selected_gl_version, wined3d_settings.offscreen_rendering_mode);
+    /* Keep the format entries that follow the key aligned. */
+    *size = (len + 4) & ~3;
+
+    return key;
+}
+
+static BOOL caps_cache_get_path(const struct wined3d_adapter *adapter, char *path, DWORD size)
+{
+    DWORD len = GetTempPathA(size, path);
+
+    if (!len || len + 32 > size)
+        return FALSE;
+    sprintf(path + len, "wine9x_caps%u.bin", adapter->ordinal);
+
+    return TRUE;
+}
+
+static BYTE *caps_cache_read_file(const char *path, DWORD *size)
+{
+    BYTE *data = NULL;
+    DWORD read;
+    HANDLE file;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    *size = GetFileSize(file, NULL);
+    if (*size != INVALID_FILE_SIZE && *size <= WINED3D_CAPS_CACHE_MAX_SIZE && (data = malloc(*size)))
+    {
+        if (!ReadFile(file, data, *size, &read, NULL) || read != *size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    CloseHandle(file);
+
+    return data;
+}
+
+/* Context activation is done by the caller. Returns FALSE if the probes
+ * have to be run. */
+BOOL wined3d_caps_cache_load(struct wined3d_adapter *adapter, unsigned int format_count)
+{
+    struct wined3d_gl_info *gl_info = &adapter->gl_info;
+    const struct wined3d_caps_cache_format *entries;
+    struct wined3d_caps_cache_header *header;
+    char path[MAX_PATH], *key;
+    DWORD size, key_size;
+    BYTE *data = NULL;
+    unsigned int i;
+    DWORD checksum;
+    BOOL ret = FALSE;
+
+    if (!wined3d_settings.caps_cache)
+        return FALSE;
+
+    if (wined3d_settings.caps_cache_reprobe)
+    {
+        TRACE("Probing of GL capabilities forced.\n");
+        return FALSE;
+    }
+
+    if (!caps_cache_get_path(adapter, path, sizeof(path)) || !(data = caps_cache_read_file(path, &size)))
+        return FALSE;
+
+    if (!(key = caps_cache_create_key(gl_info, &key_size)))
+    {
+        free(data);
+        return FALSE;
+    }
+
+    header = (struct wined3d_caps_cache_header *)data;
+    if (size < sizeof(*header) || header->magic != WINED3D_CAPS_CACHE_MAGIC
+            || header->version != WINED3D_CAPS_CACHE_VERSION)
+    {
+        WARN("Ignoring invalid GL caps cache %s.\n", debugstr_a(path));
+        goto done;
+    }
+
+    if (header->key_size != key_size || header->format_count != format_count
+            || size != sizeof(*header) + key_size + format_count * sizeof(*entries))
+    {
+        TRACE("GL caps cache %s doesn't match the current configuration.\n", debugstr_a(path));
+        goto done;
+    }
+
+    checksum = header->checksum;
+    header->checksum = 0;
+    if (wined3d_hash_fnv1a(WINED3D_HASH_SEED, data, size) != checksum)
+    {
+        WARN("GL caps cache %s is corrupted.\n", debugstr_a(path));
+        goto done;
+    }
+
+    if (memcmp(data + sizeof(*header), key, key_size)
+            || header->format_hash != wined3d_caps_cache_hash_formats(gl_info, format_count))
+    {
+        TRACE("GL caps cache %s doesn't match the current driver.\n", debugstr_a(path));
+        goto done;
+    }
+
+    entries = (const struct wined3d_caps_cache_format *)(data + sizeof(*header) + key_size);
+    for (i = 0; i < format_count; ++i)
+    {
+        if (entries[i].id != gl_info->formats[i].id)
+        {
+            WARN("Format %u mismatch in GL caps cache %s.\n", i, debugstr_a(path));
+            goto done;
+        }
+    }
+
+    for (i = 0; i < format_count; ++i)
+    {
+        struct wined3d_format *format = &gl_info->formats[i];
+
+        format->rtInternal = entries[i].rt_internal;
+        memcpy(format->flags, entries[i].flags, sizeof(format->flags));
+    }
+    gl_info->fixed_polyoffset_scale = header->fixed_polyoffset_scale;
+    gl_info->float_polyoffset_scale = header->float_polyoffset_scale;
+
+    TRACE("Using GL caps from %s.\n", debugstr_a(path));
+    ret = TRUE;
+
+done:
+    free(key);
+    free(data);
+    return ret;
+}
+
+/* Context activation is done by the caller. "format_hash" is the value
+ * wined3d_caps_cache_hash_formats() returned before the probes modified the table. */
+void wined3d_caps_cache_store(const struct wined3d_adapter *adapter, unsigned int format_count, DWORD format_hash)
+{
+    const struct wined3d_gl_info *gl_info = &adapter->gl_info;
+    struct wined3d_caps_cache_header *header;
+    struct wined3d_caps_cache_format *entries;
+    char path[MAX_PATH], *key;
+    DWORD size, key_size, written;
+    unsigned int i;
+    HANDLE file;
+    BYTE *data;
+
+    if (!wined3d_settings.caps_cache || !caps_cache_get_path(adapter, path, sizeof(path)))
+        return;
+
+    if (!(key = caps_cache_create_key(gl_info, &key_size)))
+        return;
+
+    size = sizeof(*header) + key_size + format_count * sizeof(*entries);
+    if (!(data = calloc(1, size)))
+    {
+        free(key);
+        return;
+    }
+
+    header = (struct wined3d_caps_cache_header *)data;
+    header->magic = WINED3D_CAPS_CACHE_MAGIC;
+    header->version = WINED3D_CAPS_CACHE_VERSION;
+    header->key_size = key_size;
+    header->format_count = format_count;
+    header->format_hash = format_hash;
+    header->fixed_polyoffset_scale = gl_info->fixed_polyoffset_scale;
+    header->float_polyoffset_scale = gl_info->float_polyoffset_scale;
+    memcpy(data + sizeof(*header), key, key_size);
+
+    entries = (struct wined3d_caps_cache_format *)(data + sizeof(*header) + key_size);
+    for (i = 0; i < format_count; ++i)
+    {
+        const struct wined3d_format *format = &gl_info->formats[i];
+
+        entries[i].id = format->id;
+        entries[i].rt_internal = format->rtInternal;
+        memcpy(entries[i].flags, format->flags, sizeof(entries[i].flags));
+    }
+    header->checksum = wined3d_hash_fnv1a(WINED3D_HASH_SEED, data, size);
+
+    /* A concurrent writer just makes this fail, and a partially written file
+     * is caught by the checksum. */
+    file = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        if (!WriteFile(file, data, size, &written, NULL) || written != size)
+            WARN("Failed to write GL caps cache %s.\n", debugstr_a(path));
+        CloseHandle(file);
+    }
+    else
+    {
+        WARN("Failed to create GL caps cache %s, error %u.\n", debugstr_a(path), GetLastError());
+    }
+
+    free(key);
+    free(data);
+}
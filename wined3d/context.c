@@ -736,6 +736,24 @@ void context_resource_released(const struct wined3d_device *device,
     }
 }
 
+/* Forget the bindings of a sampler object that is about to be deleted, its
+ * name may be reused for a different sampler. */
+void context_sampler_released(const struct wined3d_device *device, const struct wined3d_sampler *sampler)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < device->context_count; ++i)
+    {
+        struct wined3d_context *context = device->contexts[i];
+
+        for (j = 0; j < MAX_COMBINED_SAMPLERS; ++j)
+        {
+            if (context->bound_samplers[j] == sampler)
+                context->bound_samplers[j] = NULL;
+        }
+    }
+}
+
 static void context_detach_fbo_entry(struct wined3d_context *context, struct fbo_entry *entry)
 {
     entry->attached = FALSE;
@@ -1269,6 +1287,8 @@ void context_release(struct wined3d_context *context)
         if (context->restore_ctx)
         {
             TRACE("Restoring GL context %p on device context %p.\n", context->restore_ctx, context->restore_dc);
+            if (!context->destroyed)
+                ++context->swapchain->device->context_reactivations;
             context_restore_gl_context(context->gl_info, context->restore_dc, context->restore_ctx);
             context->restore_ctx = NULL;
             context->restore_dc = NULL;
@@ -1330,6 +1350,49 @@ void context_invalidate_state(struct wined3d_context *context, DWORD state)
     context->isStateDirty[idx] |= (1u << shift);
 }
 
+/* Returns the index of a cached pixel format choice, or -1. */
+static int context_find_pixel_format_choice(const struct wined3d_adapter *adapter,
+        const struct wined3d_format *color_format, const struct wined3d_format *ds_format,
+        BOOL aux_buffers, BOOL find_compatible)
+{
+    const struct wined3d_pixel_format_choice *choice;
+    unsigned int i;
+
+    for (i = 0; i < adapter->pixel_format_choice_count; ++i)
+    {
+        choice = &adapter->pixel_format_choices[i];
+        if (choice->color_format_id == color_format->id && choice->ds_format_id == ds_format->id
+                && choice->aux_buffers == aux_buffers && choice->find_compatible == find_compatible)
+            return i;
+    }
+
+    return -1;
+}
+
+static void context_add_pixel_format_choice(struct wined3d_adapter *adapter,
+        const struct wined3d_format *color_format, const struct wined3d_format *ds_format,
+        BOOL aux_buffers, BOOL find_compatible, int pixel_format)
+{
+    struct wined3d_pixel_format_choice *choice;
+
+    if (adapter->pixel_format_choice_count < WINED3D_PIXEL_FORMAT_CHOICE_COUNT)
+    {
+        choice = &adapter->pixel_format_choices[adapter->pixel_format_choice_count++];
+    }
+    else
+    {
+        choice = &adapter->pixel_format_choices[adapter->next_pixel_format_choice];
+        adapter->next_pixel_format_choice = (adapter->next_pixel_format_choice + 1)
+                % WINED3D_PIXEL_FORMAT_CHOICE_COUNT;
+    }
+
+    choice->color_format_id = color_format->id;
+    choice->ds_format_id = ds_format->id;
+    choice->aux_buffers = aux_buffers;
+    choice->find_compatible = find_compatible;
+    choice->pixel_format = pixel_format;
+}
+
 /* This function takes care of wined3d pixel format selection. */
 static int context_choose_pixel_format(const struct wined3d_device *device, HDC hdc,
         const struct wined3d_format *color_format, const struct wined3d_format *ds_format,
@@ -1339,11 +1402,22 @@ static int context_choose_pixel_format(const struct wined3d_device *device, HDC
     unsigned int current_value;
     unsigned int cfg_count = device->adapter->cfg_count;
     unsigned int i;
+    int idx;
 
     TRACE("device %p, dc %p, color_format %s, ds_format %s, aux_buffers %#x, find_compatible %#x.\n",
             device, hdc, debug_d3dformat(color_format->id), debug_d3dformat(ds_format->id),
             auxBuffers, findCompatible);
 
+    /* The choice only depends on the adapter's pixel formats, so swapchain
+     * and context recreation can reuse it. */
+    if ((idx = context_find_pixel_format_choice(device->adapter, color_format, ds_format,
+            auxBuffers, findCompatible)) >= 0)
+    {
+        iPixelFormat = device->adapter->pixel_format_choices[idx].pixel_format;
+        TRACE("Reusing iPixelFormat=%d.\n", iPixelFormat);
+        return iPixelFormat;
+    }
+
     current_value = 0;
     for (i = 0; i < cfg_count; ++i)
     {
@@ -1400,6 +1474,7 @@ static int context_choose_pixel_format(const struct wined3d_device *device, HDC
     /* When findCompatible is set and no suitable format was found, let ChoosePixelFormat choose a pixel format in order not to crash. */
     if(!iPixelFormat && !findCompatible) {
         ERR("Can't find a suitable iPixelFormat\n");
+        context_add_pixel_format_choice(device->adapter, color_format, ds_format, auxBuffers, findCompatible, 0);
         return FALSE;
     } else if(!iPixelFormat) {
         PIXELFORMATDESCRIPTOR pfd;
@@ -1428,6 +1503,7 @@ static int context_choose_pixel_format(const struct wined3d_device *device, HDC
 
     TRACE("Found iPixelFormat=%d for ColorFormat=%s, DepthStencilFormat=%s\n",
             iPixelFormat, debug_d3dformat(color_format->id), debug_d3dformat(ds_format->id));
+    context_add_pixel_format_choice(device->adapter, color_format, ds_format, auxBuffers, findCompatible, iPixelFormat);
     return iPixelFormat;
 }
 
@@ -1985,6 +2061,8 @@ void context_destroy(struct wined3d_device *device, struct wined3d_context *cont
 
     device->shader_backend->shader_free_context_data(context);
     device->adapter->fragment_pipe->free_context_data(context);
+    free(context->ffp_frag_cache);
+    context->ffp_frag_cache = NULL;
     free(context->draw_buffers);
     free(context->blit_targets);
     device_context_remove(device, context);
@@ -2109,7 +2187,7 @@ static void SetupForBlit(const struct wined3d_device *device, struct wined3d_con
         }
     }
     if (gl_info->supported[ARB_SAMPLER_OBJECTS])
-        GL_EXTCALL(glBindSampler(0, 0));
+        context_bind_sampler(context, 0, NULL);
     context_active_texture(context, gl_info, 0);
 
     sampler = context->rev_tex_unit_map[0];
@@ -2310,6 +2388,21 @@ void context_active_texture(struct wined3d_context *context, const struct wined3
     context->active_texture = unit;
 }
 
+/* Context activation is done by the caller. Binding the sampler object
+ * that is already bound to the unit is skipped, unbinding always happens. */
+void context_bind_sampler(struct wined3d_context *context, unsigned int unit,
+        const struct wined3d_sampler *sampler)
+{
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+
+    if (sampler && context->bound_samplers[unit] == sampler)
+        return;
+
+    GL_EXTCALL(glBindSampler(unit, sampler ? sampler->name : 0));
+    checkGLcall("glBindSampler");
+    context->bound_samplers[unit] = sampler;
+}
+
 void context_bind_texture(struct wined3d_context *context, GLenum target, GLuint name)
 {
     const struct wined3d_gl_info *gl_info = context->gl_info;
@@ -2913,34 +3006,6 @@ void context_state_drawbuf(struct wined3d_context *context, const struct wined3d
     }
 }
 
-static BOOL fixed_get_input(BYTE usage, BYTE usage_idx, unsigned int *regnum)
-{
-    if ((usage == WINED3D_DECL_USAGE_POSITION || usage == WINED3D_DECL_USAGE_POSITIONT) && !usage_idx)
-        *regnum = WINED3D_FFP_POSITION;
-    else if (usage == WINED3D_DECL_USAGE_BLEND_WEIGHT && !usage_idx)
-        *regnum = WINED3D_FFP_BLENDWEIGHT;
-    else if (usage == WINED3D_DECL_USAGE_BLEND_INDICES && !usage_idx)
-        *regnum = WINED3D_FFP_BLENDINDICES;
-    else if (usage == WINED3D_DECL_USAGE_NORMAL && !usage_idx)
-        *regnum = WINED3D_FFP_NORMAL;
-    else if (usage == WINED3D_DECL_USAGE_PSIZE && !usage_idx)
-        *regnum = WINED3D_FFP_PSIZE;
-    else if (usage == WINED3D_DECL_USAGE_COLOR && !usage_idx)
-        *regnum = WINED3D_FFP_DIFFUSE;
-    else if (usage == WINED3D_DECL_USAGE_COLOR && usage_idx == 1)
-        *regnum = WINED3D_FFP_SPECULAR;
-    else if (usage == WINED3D_DECL_USAGE_TEXCOORD && usage_idx < WINED3DDP_MAXTEXCOORD)
-        *regnum = WINED3D_FFP_TEXCOORD0 + usage_idx;
-    else
-    {
-        FIXME("Unsupported input stream [usage=%s, usage_idx=%u].\n", debug_d3ddeclusage(usage), usage_idx);
-        *regnum = ~0U;
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
 /* Context activation is done by the caller. */
 void context_stream_info_from_declaration(struct wined3d_context *context,
         const struct wined3d_state *state, struct wined3d_stream_info *stream_info)
@@ -2999,9 +3064,15 @@ void context_stream_info_from_declaration(struct wined3d_context *context,
                         debug_d3dformat(element->format->id), debug_d3ddeclusage(element->usage));
                 stride_used = FALSE;
             }
+            else if ((idx = element->ffp_idx) != ~0U)
+            {
+                stride_used = TRUE;
+            }
             else
             {
-                stride_used = fixed_get_input(element->usage, element->usage_idx, &idx);
+                FIXME("Unsupported input stream [usage=%s, usage_idx=%u].\n",
+                        debug_d3ddeclusage(element->usage), element->usage_idx);
+                stride_used = FALSE;
             }
         }
 
@@ -3044,6 +3115,64 @@ void context_stream_info_from_declaration(struct wined3d_context *context,
     }
 }
 
+/* Context activation is done by the caller. */
+static void context_stream_info_from_cache(struct wined3d_context *context,
+        const struct wined3d_state *state, struct wined3d_stream_info *stream_info)
+{
+    const struct wined3d_shader *vs = use_vs(state) ? state->shader[WINED3D_SHADER_TYPE_VERTEX] : NULL;
+    unsigned int declaration_id = state->vertex_declaration->id, vs_id = vs ? vs->id : 0;
+    struct wined3d_stream_info_cache_entry *entry;
+    WORD stream_mask = 0, instance_mask = 0;
+    unsigned int i;
+    WORD map;
+
+    for (i = 0; i < MAX_STREAMS; ++i)
+    {
+        if (state->streams[i].buffer)
+            stream_mask |= 1u << i;
+        if (state->streams[i].flags & WINED3DSTREAMSOURCE_INSTANCEDATA)
+            instance_mask |= 1u << i;
+    }
+
+    for (i = 0; i < WINED3D_STREAM_INFO_CACHE_SIZE; ++i)
+    {
+        entry = &context->stream_info_cache[i];
+        if (entry->declaration_id == declaration_id && entry->vs_id == vs_id
+                && entry->stream_mask == stream_mask && entry->instance_mask == instance_mask)
+            break;
+    }
+
+    if (i == WINED3D_STREAM_INFO_CACHE_SIZE)
+    {
+        entry = &context->stream_info_cache[context->stream_info_cache_next++ % WINED3D_STREAM_INFO_CACHE_SIZE];
+        context_stream_info_from_declaration(context, state, &entry->stream_info);
+        entry->declaration_id = declaration_id;
+        entry->vs_id = vs_id;
+        entry->stream_mask = stream_mask;
+        entry->instance_mask = instance_mask;
+
+        for (i = 0, map = entry->stream_info.use_map; map; map >>= 1, ++i)
+        {
+            if (map & 1)
+                entry->stream_info.elements[i].data.addr
+                        -= state->streams[entry->stream_info.elements[i].stream_idx].offset;
+        }
+    }
+
+    *stream_info = entry->stream_info;
+    for (i = 0, map = stream_info->use_map; map; map >>= 1, ++i)
+    {
+        struct wined3d_stream_info_element *element = &stream_info->elements[i];
+        const struct wined3d_stream_state *stream = &state->streams[element->stream_idx];
+
+        if (!(map & 1))
+            continue;
+
+        element->data.addr += stream->offset;
+        element->stride = stream->stride;
+    }
+}
+
 /* Context activation is done by the caller. */
 static void context_update_stream_info(struct wined3d_context *context, const struct wined3d_state *state)
 {
@@ -3054,7 +3183,7 @@ static void context_update_stream_info(struct wined3d_context *context, const st
     unsigned int i;
     WORD map;
 
-    context_stream_info_from_declaration(context, state, stream_info);
+    context_stream_info_from_cache(context, state, stream_info);
 
     stream_info->all_vbo = 1;
     context->num_buffer_queries = 0;
@@ -3282,8 +3411,7 @@ static void context_bind_shader_resources(struct wined3d_context *context, const
             context_active_texture(context, gl_info, shader_types[i].base_idx + entry->bind_idx);
             wined3d_texture_bind(texture, context, FALSE);
 
-            GL_EXTCALL(glBindSampler(shader_types[i].base_idx + entry->bind_idx, sampler->name));
-            checkGLcall("glBindSampler");
+            context_bind_sampler(context, shader_types[i].base_idx + entry->bind_idx, sampler);
         }
     }
 }
@@ -3464,9 +3592,23 @@ struct wined3d_context *context_acquire(const struct wined3d_device *device, str
     }
     else if (target->container->swapchain)
     {
-        TRACE("Rendering onscreen.\n");
+        /* In single context mode swapchains render to FBOs, which any
+         * context of the device can do. Only presenting needs the
+         * swapchain's own context. */
+        if (wined3d_settings.single_context && current_context
+                && current_context->swapchain->device == device
+                && wined3d_resource_is_offscreen(&target->container->resource))
+        {
+            TRACE("Rendering swapchain %p offscreen.\n", target->container->swapchain);
 
-        context = swapchain_get_context(target->container->swapchain);
+            context = current_context;
+        }
+        else
+        {
+            TRACE("Rendering onscreen.\n");
+
+            context = swapchain_get_context(target->container->swapchain);
+        }
     }
     else
     {
@@ -3492,11 +3634,13 @@ struct wined3d_context *context_acquire(const struct wined3d_device *device, str
 
     if (context != current_context)
     {
+        ++context->swapchain->device->context_switches;
         if (!context_set_current(context))
             ERR("Failed to activate the new context.\n");
     }
     else if (context->needs_set)
     {
+        ++context->swapchain->device->context_reactivations;
         context_set_gl_context(context);
     }
 
@@ -284,7 +284,7 @@ static void prepare_ds_clear(struct wined3d_surface *ds, struct wined3d_context
     SetRect(out_rect, 0, 0, ds->ds_current_size.cx, ds->ds_current_size.cy);
 }
 
-void device_clear_render_targets(struct wined3d_device *device, UINT rt_count, const struct wined3d_fb_state *fb,
+static void device_issue_clear(struct wined3d_device *device, UINT rt_count, const struct wined3d_fb_state *fb,
         UINT rect_count, const RECT *rects, const RECT *draw_rect, DWORD flags, const struct wined3d_color *color,
         float depth, DWORD stencil)
 {
@@ -478,6 +478,105 @@ void device_clear_render_targets(struct wined3d_device *device, UINT rt_count, c
     context_release(context);
 }
 
+/* A colour clear of whole offscreen render targets only records the colour
+ * in the WINED3D_LOCATION_CLEARED location. Locking the surface fills system
+ * memory on the CPU instead of reading the clear back, the first GPU use does
+ * the GL clear (see device_resolve_clear()), and a clear or blit that
+ * replaces the whole surface in the meantime drops it without any GL work. */
+static BOOL device_defer_clear(const struct wined3d_device *device, UINT rt_count,
+        const struct wined3d_fb_state *fb, const RECT *draw_rect, const RECT *clear_rect, DWORD flags,
+        const struct wined3d_color *color)
+{
+    BOOL srgb_write = device->state.render_states[WINED3D_RS_SRGBWRITEENABLE];
+    struct wined3d_surface *rt;
+    unsigned int i, count = 0;
+
+    if (flags != WINED3DCLEAR_TARGET)
+        return FALSE;
+
+    for (i = 0; i < rt_count; ++i)
+    {
+        if (!fb->render_targets[i])
+            continue;
+        if (!(rt = wined3d_rendertarget_view_get_surface(fb->render_targets[i])))
+            return FALSE;
+        if (rt->resource.format->id == WINED3DFMT_NULL)
+            continue;
+        if (!surface_can_defer_clear(rt) || !is_full_clear(rt, draw_rect, clear_rect))
+            return FALSE;
+        /* The clear would be sRGB encoded, which neither the CPU fill nor
+         * a later GL clear under different state reproduces. */
+        if (srgb_write && rt->container->resource.format_flags & WINED3DFMT_FLAG_SRGB_WRITE)
+            return FALSE;
+        ++count;
+    }
+    if (!count)
+        return FALSE;
+
+    for (i = 0; i < rt_count; ++i)
+    {
+        if (!fb->render_targets[i])
+            continue;
+        rt = wined3d_rendertarget_view_get_surface(fb->render_targets[i]);
+        if (rt->resource.format->id == WINED3DFMT_NULL)
+            continue;
+
+        TRACE("Deferring clear of surface %p.\n", rt);
+        rt->clear_color = *color;
+        surface_validate_location(rt, WINED3D_LOCATION_CLEARED);
+        surface_invalidate_location(rt, ~WINED3D_LOCATION_CLEARED);
+    }
+
+    return TRUE;
+}
+
+void device_clear_render_targets(struct wined3d_device *device, UINT rt_count, const struct wined3d_fb_state *fb,
+        UINT rect_count, const RECT *rects, const RECT *draw_rect, DWORD flags, const struct wined3d_color *color,
+        float depth, DWORD stencil)
+{
+    const RECT *clear_rect = (rect_count > 0 && rects) ? (const RECT *)rects : NULL;
+
+    if (device_defer_clear(device, rt_count, fb, draw_rect, clear_rect, flags, color))
+        return;
+
+    device_issue_clear(device, rt_count, fb, rect_count, rects, draw_rect, flags, color, depth, stencil);
+}
+
+/* Does the GL clear of a surface in WINED3D_LOCATION_CLEARED. Afterwards the
+ * surface is current in its draw binding. Clears are only deferred with sRGB
+ * writes disabled, so make sure the current state doesn't encode this one. */
+void device_resolve_clear(struct wined3d_device *device, struct wined3d_surface *surface)
+{
+    const RECT draw_rect = {0, 0, surface->resource.width, surface->resource.height};
+    const struct wined3d_gl_info *gl_info;
+    struct wined3d_rendertarget_view *view;
+    struct wined3d_fb_state fb = {&view, NULL};
+    struct wined3d_context *context;
+    HRESULT hr;
+
+    TRACE("device %p, surface %p.\n", device, surface);
+
+    if (FAILED(hr = wined3d_rendertarget_view_create_from_surface(surface,
+            NULL, &wined3d_null_parent_ops, &view)))
+    {
+        ERR("Failed to create rendertarget view, hr %#x.\n", hr);
+        return;
+    }
+
+    context = context_acquire(device, surface);
+    gl_info = context->gl_info;
+    if (context->valid && gl_info->supported[ARB_FRAMEBUFFER_SRGB])
+    {
+        gl_info->gl_ops.gl.p_glDisable(GL_FRAMEBUFFER_SRGB);
+        context_invalidate_state(context, STATE_RENDER(WINED3D_RS_SRGBWRITEENABLE));
+    }
+
+    device_issue_clear(device, 1, &fb, 0, NULL, &draw_rect, WINED3DCLEAR_TARGET, &surface->clear_color, 0.0f, 0);
+
+    context_release(context);
+    wined3d_rendertarget_view_decref(view);
+}
+
 ULONG CDECL wined3d_device_incref(struct wined3d_device *device)
 {
     ULONG refcount = InterlockedIncrement(&device->ref);
@@ -538,6 +637,7 @@ ULONG CDECL wined3d_device_decref(struct wined3d_device *device)
         device->hardwareCursor = 0;
 
         wine_rb_destroy(&device->samplers, device_leftover_sampler, NULL);
+        DeleteCriticalSection(&device->resources_cs);
 
         wined3d_decref(device->wined3d);
         device->wined3d = NULL;
@@ -1076,12 +1176,14 @@ HRESULT CDECL wined3d_device_uninit_3d(struct wined3d_device *device)
     state_unbind_resources(&device->state);
 
     /* Unload resources */
+    EnterCriticalSection(&device->resources_cs);
     LIST_FOR_EACH_ENTRY_SAFE(resource, cursor, &device->resources, struct wined3d_resource, resource_list_entry)
     {
         TRACE("Unloading resource %p.\n", resource);
 
         resource->resource_ops->resource_unload(resource);
     }
+    LeaveCriticalSection(&device->resources_cs);
 
     wine_rb_clear(&device->samplers, device_free_sampler, NULL);
 
@@ -3301,6 +3403,10 @@ HRESULT CDECL wined3d_device_end_scene(struct wined3d_device *device)
     context_release(context);
 
     device->inScene = FALSE;
+
+    if (!(++device->frame_count % WINED3D_SYSMEM_TRIM_INTERVAL) && wined3d_settings.trim_sysmem)
+        device_trim_sysmem(device);
+
     return WINED3D_OK;
 }
 
@@ -4386,6 +4492,7 @@ void CDECL wined3d_device_evict_managed_resources(struct wined3d_device *device)
 
     TRACE("device %p.\n", device);
 
+    EnterCriticalSection(&device->resources_cs);
     LIST_FOR_EACH_ENTRY_SAFE(resource, cursor, &device->resources, struct wined3d_resource, resource_list_entry)
     {
         TRACE("Checking resource %p for eviction.\n", resource);
@@ -4396,11 +4503,50 @@ void CDECL wined3d_device_evict_managed_resources(struct wined3d_device *device)
             resource->resource_ops->resource_unload(resource);
         }
     }
+    LeaveCriticalSection(&device->resources_cs);
 
     /* Invalidate stream sources, the buffer(s) may have been evicted. */
     device_invalidate_state(device, STATE_STREAMSRC);
 }
 
+/* Managed resources keep a system memory copy of their contents for the
+ * whole of their lifetime, which for a typical game means every texture is
+ * in memory twice. Copies that weren't mapped for a while are dropped where
+ * the GL texture holds the same data, and compressed otherwise. Buffers are
+ * left alone, the draw code reads their system memory directly. */
+void device_trim_sysmem(struct wined3d_device *device)
+{
+    struct wined3d_resource *resource;
+    SIZE_T budget = WINED3D_SYSMEM_PACK_BUDGET, packed;
+
+    TRACE("device %p.\n", device);
+
+    EnterCriticalSection(&device->resources_cs);
+    LIST_FOR_EACH_ENTRY(resource, &device->resources, struct wined3d_resource, resource_list_entry)
+    {
+        if (resource->pool != WINED3D_POOL_MANAGED || !resource->heap_memory
+                || device->frame_count - resource->access_frame < WINED3D_SYSMEM_IDLE_FRAMES)
+            continue;
+
+        switch (resource->type)
+        {
+            case WINED3D_RTYPE_SURFACE:
+                packed = surface_trim_sysmem(surface_from_resource(resource), !!budget);
+                break;
+
+            case WINED3D_RTYPE_VOLUME:
+                packed = wined3d_volume_trim_sysmem(volume_from_resource(resource), !!budget);
+                break;
+
+            default:
+                continue;
+        }
+
+        budget -= min(budget, packed);
+    }
+    LeaveCriticalSection(&device->resources_cs);
+}
+
 static void delete_opengl_contexts(struct wined3d_device *device, struct wined3d_swapchain *swapchain)
 {
     struct wined3d_resource *resource, *cursor;
@@ -4411,12 +4557,14 @@ static void delete_opengl_contexts(struct wined3d_device *device, struct wined3d
     context = context_acquire(device, NULL);
     gl_info = context->gl_info;
 
+    EnterCriticalSection(&device->resources_cs);
     LIST_FOR_EACH_ENTRY_SAFE(resource, cursor, &device->resources, struct wined3d_resource, resource_list_entry)
     {
         TRACE("Unloading resource %p.\n", resource);
 
         resource->resource_ops->resource_unload(resource);
     }
+    LeaveCriticalSection(&device->resources_cs);
 
     LIST_FOR_EACH_ENTRY(shader, &device->shaders, struct wined3d_shader, shader_list_entry)
     {
@@ -4494,12 +4642,47 @@ static HRESULT create_primary_opengl_context(struct wined3d_device *device, stru
     return WINED3D_OK;
 }
 
+/* The GL contexts only need to be recreated when the pixel format they were
+ * created with may no longer suit the back buffer. Size changes are handled
+ * by resizing the swapchain buffers, and window changes by the contexts
+ * themselves. */
+static BOOL device_reset_needs_new_contexts(const struct wined3d_swapchain_desc *old_desc,
+        const struct wined3d_swapchain_desc *new_desc)
+{
+    return old_desc->backbuffer_format != new_desc->backbuffer_format
+            || old_desc->multisample_type != new_desc->multisample_type
+            || old_desc->multisample_quality != new_desc->multisample_quality;
+}
+
+static BOOL device_reset_buffers_changed(const struct wined3d_swapchain_desc *old_desc,
+        const struct wined3d_swapchain_desc *new_desc)
+{
+    return old_desc->backbuffer_width != new_desc->backbuffer_width
+            || old_desc->backbuffer_height != new_desc->backbuffer_height
+            || device_reset_needs_new_contexts(old_desc, new_desc);
+}
+
+/* Makes the contexts reapply everything after the device state was reset
+ * underneath them. */
+static void device_invalidate_all_states(const struct wined3d_device *device)
+{
+    DWORD state;
+
+    for (state = 0; state <= STATE_HIGHEST; ++state)
+    {
+        if (device->StateTable[state].representative)
+            device_invalidate_state(device, state);
+    }
+}
+
 HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         const struct wined3d_swapchain_desc *swapchain_desc, const struct wined3d_display_mode *mode,
         wined3d_device_reset_cb callback, BOOL reset_state)
 {
     struct wined3d_resource *resource, *cursor;
+    struct wined3d_swapchain_desc old_desc;
     struct wined3d_swapchain *swapchain;
+    BOOL buffers_changed, new_contexts;
     struct wined3d_display_mode m;
     BOOL DisplayModeChanged;
     HRESULT hr = WINED3D_OK;
@@ -4514,6 +4697,7 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         return WINED3DERR_INVALIDCALL;
     }
     DisplayModeChanged = swapchain->reapply_mode;
+    old_desc = swapchain->desc;
 
     if (reset_state)
     {
@@ -4547,12 +4731,17 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
 
     if (reset_state)
     {
+        EnterCriticalSection(&device->resources_cs);
         LIST_FOR_EACH_ENTRY_SAFE(resource, cursor, &device->resources, struct wined3d_resource, resource_list_entry)
         {
             TRACE("Enumerating resource %p.\n", resource);
             if (FAILED(hr = callback(resource)))
+            {
+                LeaveCriticalSection(&device->resources_cs);
                 return hr;
+            }
         }
+        LeaveCriticalSection(&device->resources_cs);
     }
 
     TRACE("New params:\n");
@@ -4681,12 +4870,24 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
             swapchain_desc->multisample_type, swapchain_desc->multisample_quality)))
         return hr;
 
-    if (device->auto_depth_stencil_view)
+    buffers_changed = device_reset_buffers_changed(&old_desc, &swapchain->desc);
+    new_contexts = reset_state && device->d3d_initialized
+            && device_reset_needs_new_contexts(&old_desc, &swapchain->desc);
+    TRACE("Buffers changed %#x, recreating contexts %#x.\n", buffers_changed, new_contexts);
+
+    if (device->auto_depth_stencil_view && (buffers_changed || !swapchain->desc.enable_auto_depth_stencil
+            || !old_desc.enable_auto_depth_stencil
+            || swapchain->desc.auto_depth_stencil_format != old_desc.auto_depth_stencil_format))
     {
         wined3d_rendertarget_view_decref(device->auto_depth_stencil_view);
         device->auto_depth_stencil_view = NULL;
     }
-    if (swapchain->desc.enable_auto_depth_stencil)
+    if (device->auto_depth_stencil_view)
+    {
+        TRACE("Keeping the depth stencil buffer.\n");
+        wined3d_device_set_depth_stencil_view(device, device->auto_depth_stencil_view);
+    }
+    else if (swapchain->desc.enable_auto_depth_stencil)
     {
         struct wined3d_resource_desc texture_desc;
         struct wined3d_texture *texture;
@@ -4728,12 +4929,13 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         wined3d_device_set_depth_stencil_view(device, device->auto_depth_stencil_view);
     }
 
-    if (device->back_buffer_view)
+    if (device->back_buffer_view && buffers_changed)
     {
         wined3d_rendertarget_view_decref(device->back_buffer_view);
         device->back_buffer_view = NULL;
     }
-    if (swapchain->desc.backbuffer_count && FAILED(hr = wined3d_rendertarget_view_create_from_surface(
+    if (!device->back_buffer_view && swapchain->desc.backbuffer_count
+            && FAILED(hr = wined3d_rendertarget_view_create_from_surface(
             surface_from_resource(wined3d_texture_get_sub_resource(swapchain->back_buffers[0], 0)),
             NULL, &wined3d_null_parent_ops, &device->back_buffer_view)))
     {
@@ -4741,7 +4943,9 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         return hr;
     }
 
-    wine_rb_clear(&device->samplers, device_free_sampler, NULL);
+    /* Sampler objects only go away along with the contexts. */
+    if (new_contexts)
+        wine_rb_clear(&device->samplers, device_free_sampler, NULL);
 
     if (reset_state)
     {
@@ -4754,7 +4958,7 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         wined3d_cs_emit_reset_state(device->cs);
         state_cleanup(&device->state);
 
-        if (device->d3d_initialized)
+        if (new_contexts)
             delete_opengl_contexts(device, swapchain);
 
         if (FAILED(hr = state_init(&device->state, &device->fb, &device->adapter->gl_info,
@@ -4762,6 +4966,10 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
             ERR("Failed to initialize device state, hr %#x.\n", hr);
         device->update_state = &device->state;
 
+        /* Kept contexts still have the old state applied. */
+        if (!new_contexts)
+            device_invalidate_all_states(device);
+
         device_init_swapchain_state(device, swapchain);
     }
     else if (device->back_buffer_view)
@@ -4785,7 +4993,7 @@ HRESULT CDECL wined3d_device_reset(struct wined3d_device *device,
         wined3d_cs_emit_set_scissor_rect(device->cs, &state->scissor_rect);
     }
 
-    if (reset_state && device->d3d_initialized)
+    if (new_contexts)
         hr = create_primary_opengl_context(device, swapchain);
 
     /* All done. There is no need to reload resources or shaders, this will happen automatically on the
@@ -4840,14 +5048,18 @@ void device_resource_add(struct wined3d_device *device, struct wined3d_resource
 {
     TRACE("device %p, resource %p.\n", device, resource);
 
+    EnterCriticalSection(&device->resources_cs);
     list_add_head(&device->resources, &resource->resource_list_entry);
+    LeaveCriticalSection(&device->resources_cs);
 }
 
 static void device_resource_remove(struct wined3d_device *device, struct wined3d_resource *resource)
 {
     TRACE("device %p, resource %p.\n", device, resource);
 
+    EnterCriticalSection(&device->resources_cs);
     list_remove(&resource->resource_list_entry);
+    LeaveCriticalSection(&device->resources_cs);
 }
 
 void device_resource_released(struct wined3d_device *device, struct wined3d_resource *resource)
@@ -4960,6 +5172,7 @@ struct wined3d_surface * CDECL wined3d_device_get_surface_from_dc(const struct w
     if (!dc)
         return NULL;
 
+    EnterCriticalSection(&device->resources_cs);
     LIST_FOR_EACH_ENTRY(resource, &device->resources, struct wined3d_resource, resource_list_entry)
     {
         if (resource->type == WINED3D_RTYPE_SURFACE)
@@ -4969,10 +5182,12 @@ struct wined3d_surface * CDECL wined3d_device_get_surface_from_dc(const struct w
             if (s->hDC == dc)
             {
                 TRACE("Found surface %p for dc %p.\n", s, dc);
+                LeaveCriticalSection(&device->resources_cs);
                 return s;
             }
         }
     }
+    LeaveCriticalSection(&device->resources_cs);
 
     return NULL;
 }
@@ -5008,7 +5223,12 @@ HRESULT device_init(struct wined3d_device *device, struct wined3d *wined3d,
     device->adapter = wined3d->adapter_count ? adapter : NULL;
     device->device_parent = device_parent;
     list_init(&device->resources);
+    InitializeCriticalSection(&device->resources_cs);
     list_init(&device->shaders);
+    list_init(&device->pending_queries);
+    device->query_flush_batch = device->query_batch - 1;
+    for (i = 0; i < WINED3D_SHADER_INTERN_BUCKETS; ++i)
+        list_init(&device->shader_intern[i]);
     device->surface_alignment = surface_alignment;
 
     /* Save the creation parameters. */
@@ -5026,6 +5246,7 @@ HRESULT device_init(struct wined3d_device *device, struct wined3d *wined3d,
     if (wine_rb_init(&device->samplers, &wined3d_sampler_rb_functions) == -1)
     {
         ERR("Failed to initialize sampler rbtree.\n");
+        DeleteCriticalSection(&device->resources_cs);
         return E_OUTOFMEMORY;
     }
 
@@ -5036,6 +5257,7 @@ HRESULT device_init(struct wined3d_device *device, struct wined3d *wined3d,
     {
         ERR("Failed to compile state table, hr %#x.\n", hr);
         wine_rb_destroy(&device->samplers, NULL, NULL);
+        DeleteCriticalSection(&device->resources_cs);
         wined3d_decref(device->wined3d);
         return hr;
     }
@@ -5066,6 +5288,7 @@ err:
         free(device->multistate_funcs[i]);
     }
     wine_rb_destroy(&device->samplers, NULL, NULL);
+    DeleteCriticalSection(&device->resources_cs);
     wined3d_decref(device->wined3d);
     return hr;
 }
@@ -5118,8 +5341,19 @@ LRESULT device_process_message(struct wined3d_device *device, HWND window, BOOL
     }
     else if (message == WM_DISPLAYCHANGE)
     {
+        if (device->adapter)
+            wined3d_adapter_invalidate_modes(device->adapter);
         device->device_parent->ops->mode_changed(device->device_parent);
     }
+    else if (message == WM_PAINT)
+    {
+        UINT i;
+
+        /* Part of the window has to be redrawn, the GDI presenter can't
+         * assume the screen still holds what it copied there. */
+        for (i = 0; i < device->swapchain_count; ++i)
+            swapchain_gdi_invalidate(device->swapchains[i]);
+    }
     else if (message == WM_ACTIVATEAPP)
     {
         UINT i;
@@ -461,15 +461,37 @@ fail:
 /* Adjust the amount of used texture memory */
 UINT64 adapter_adjust_memory(struct wined3d_adapter *adapter, INT64 amount)
 {
-    adapter->vram_bytes_used += amount;
+    UINT64 used;
+
+    EnterCriticalSection(&adapter->memory_cs);
+    used = adapter->vram_bytes_used += amount;
+    LeaveCriticalSection(&adapter->memory_cs);
+
     TRACE("Adjusted used adapter memory by 0x%s to 0x%s.\n",
-            wine_dbgstr_longlong(amount),
-            wine_dbgstr_longlong(adapter->vram_bytes_used));
-    return adapter->vram_bytes_used;
+            wine_dbgstr_longlong(amount), wine_dbgstr_longlong(used));
+    return used;
+}
+
+/* Accounts "size" bytes of video memory, unless that is more than is left. */
+BOOL adapter_reserve_memory(struct wined3d_adapter *adapter, UINT64 size)
+{
+    BOOL ret;
+
+    EnterCriticalSection(&adapter->memory_cs);
+    if ((ret = adapter->vram_bytes_used <= adapter->vram_bytes
+            && size <= adapter->vram_bytes - adapter->vram_bytes_used))
+        adapter->vram_bytes_used += size;
+    LeaveCriticalSection(&adapter->memory_cs);
+
+    TRACE("Reserving 0x%s bytes of adapter memory %s.\n",
+            wine_dbgstr_longlong(size), ret ? "succeeded" : "failed");
+    return ret;
 }
 
 static void wined3d_adapter_cleanup(struct wined3d_adapter *adapter)
 {
+    DeleteCriticalSection(&adapter->memory_cs);
+    wined3d_adapter_invalidate_modes(adapter);
     free(adapter->gl_info.formats);
     free(adapter->cfgs);
 }
@@ -4191,6 +4213,137 @@ BOOL EnumDisplaySettingsA95(LPCSTR lpszDeviceName, DWORD iModeNum, DEVMODEA *lpD
 	return EnumDisplaySettingsA(lpszDeviceName, iModeNum, lpDevMode);
 }
 
+void wined3d_adapter_invalidate_modes(struct wined3d_adapter *adapter)
+{
+    struct wined3d_adapter_mode_table *table = &adapter->mode_table;
+    unsigned int i;
+
+    for (i = 0; i < table->filter_count; ++i)
+        free(table->filters[i].indices);
+    free(table->modes);
+    memset(table, 0, sizeof(*table));
+}
+
+static BOOL wined3d_adapter_build_mode_table(const struct wined3d_adapter *adapter,
+        struct wined3d_adapter_mode_table *table)
+{
+    struct wined3d_adapter_mode *modes = NULL, *new_modes, *mode;
+    unsigned int count = 0, size = 0;
+    DEVMODEA m;
+
+    memset(&m, 0, sizeof(m));
+    m.dmSize = sizeof(m);
+
+    while (EnumDisplaySettingsA95(adapter->DeviceName, count, &m))
+    {
+        if (count == size)
+        {
+            size = max(size * 2, 64);
+            if (!(new_modes = realloc(modes, size * sizeof(*modes))))
+            {
+                ERR("Failed to allocate display mode table.\n");
+                free(modes);
+                return FALSE;
+            }
+            modes = new_modes;
+        }
+
+        mode = &modes[count++];
+        mode->width = m.dmPelsWidth;
+        mode->height = m.dmPelsHeight;
+        mode->refresh_rate = DEFAULT_REFRESH_RATE;
+        if (m.dmFields & DM_DISPLAYFREQUENCY)
+            mode->refresh_rate = m.dmDisplayFrequency;
+        mode->bpp = m.dmBitsPerPel;
+
+        if (!(m.dmFields & DM_DISPLAYFLAGS))
+            mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_UNKNOWN;
+        else if (DUMMYACCESS1(m, u2, dmDisplayFlags) & DM_INTERLACED)
+            mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_INTERLACED;
+        else
+            mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_PROGRESSIVE;
+    }
+
+    TRACE("Found %u display modes for adapter %u.\n", count, adapter->ordinal);
+
+    table->modes = modes;
+    table->count = count;
+    table->valid = TRUE;
+
+    return TRUE;
+}
+
+static BOOL wined3d_adapter_mode_matches(const struct wined3d_adapter_mode *mode,
+        enum wined3d_format_id format_id, UINT format_bits, enum wined3d_scanline_ordering scanline_ordering)
+{
+    if (mode->scanline_ordering != WINED3D_SCANLINE_ORDERING_UNKNOWN
+            && scanline_ordering != WINED3D_SCANLINE_ORDERING_UNKNOWN
+            && mode->scanline_ordering != scanline_ordering)
+        return FALSE;
+
+    /* This is for d3d8, do not enumerate P8 here. */
+    if (format_id == WINED3DFMT_UNKNOWN)
+        return mode->bpp == 32 || mode->bpp == 16;
+
+    return mode->bpp == format_bits;
+}
+
+/* Returns the modes matching the format and scanline ordering, so that
+ * counting and enumerating them doesn't have to go through the driver again.
+ * The table is only a cache of what EnumDisplaySettings() reports, so it is
+ * filled in on behalf of const callers. */
+static const struct wined3d_adapter_mode_filter *wined3d_adapter_get_modes(const struct wined3d_adapter *adapter,
+        enum wined3d_format_id format_id, enum wined3d_scanline_ordering scanline_ordering)
+{
+    struct wined3d_adapter_mode_table *table = (struct wined3d_adapter_mode_table *)&adapter->mode_table;
+    struct wined3d_adapter_mode_filter *filter;
+    const struct wined3d_format *format;
+    unsigned int i, *indices;
+    UINT format_bits;
+
+    if (!table->valid && !wined3d_adapter_build_mode_table(adapter, table))
+        return NULL;
+
+    for (i = 0; i < table->filter_count; ++i)
+    {
+        filter = &table->filters[i];
+        if (filter->format_id == format_id && filter->scanline_ordering == scanline_ordering)
+            return filter;
+    }
+
+    format = wined3d_get_format(&adapter->gl_info, format_id);
+    format_bits = format->byte_count * CHAR_BIT;
+
+    if (!(indices = malloc(max(table->count, 1) * sizeof(*indices))))
+    {
+        ERR("Failed to allocate display mode filter.\n");
+        return NULL;
+    }
+
+    if (table->filter_count < WINED3D_MODE_FILTER_COUNT)
+    {
+        filter = &table->filters[table->filter_count++];
+    }
+    else
+    {
+        filter = &table->filters[table->next_filter];
+        table->next_filter = (table->next_filter + 1) % WINED3D_MODE_FILTER_COUNT;
+        free(filter->indices);
+    }
+
+    filter->format_id = format_id;
+    filter->scanline_ordering = scanline_ordering;
+    filter->indices = indices;
+    filter->count = 0;
+    for (i = 0; i < table->count; ++i)
+    {
+        if (wined3d_adapter_mode_matches(&table->modes[i], format_id, format_bits, scanline_ordering))
+            filter->indices[filter->count++] = i;
+    }
+
+    return filter;
+}
+
 /* FIXME: GetAdapterModeCount and EnumAdapterModes currently only returns modes
      of the same bpp but different resolutions                                  */
 
@@ -4198,12 +4351,8 @@ BOOL EnumDisplaySettingsA95(LPCSTR lpszDeviceName, DWORD iModeNum, DEVMODEA *lpD
 UINT CDECL wined3d_get_adapter_mode_count(const struct wined3d *wined3d, UINT adapter_idx,
         enum wined3d_format_id format_id, enum wined3d_scanline_ordering scanline_ordering)
 {
+    const struct wined3d_adapter_mode_filter *filter;
     const struct wined3d_adapter *adapter;
-    const struct wined3d_format *format;
-    unsigned int i = 0;
-    unsigned int j = 0;
-    UINT format_bits;
-    DEVMODEA mode;
 
     TRACE("wined3d %p, adapter_idx %u, format %s, scanline_ordering %#x.\n",
             wined3d, adapter_idx, debug_d3dformat(format_id), scanline_ordering);
@@ -4212,39 +4361,13 @@ UINT CDECL wined3d_get_adapter_mode_count(const struct wined3d *wined3d, UINT ad
         return 0;
 
     adapter = &wined3d->adapters[adapter_idx];
-    format = wined3d_get_format(&adapter->gl_info, format_id);
-    format_bits = format->byte_count * CHAR_BIT;
-
-    memset(&mode, 0, sizeof(mode));
-    mode.dmSize = sizeof(mode);
-
-    while (EnumDisplaySettingsA95(adapter->DeviceName, j++, &mode))
-    {
-        if (mode.dmFields & DM_DISPLAYFLAGS)
-        {
-            if (scanline_ordering == WINED3D_SCANLINE_ORDERING_PROGRESSIVE
-                    && (DUMMYACCESS1(mode, u2, dmDisplayFlags) & DM_INTERLACED))
-                continue;
-
-            if (scanline_ordering == WINED3D_SCANLINE_ORDERING_INTERLACED
-                    && !(DUMMYACCESS1(mode, u2, dmDisplayFlags) & DM_INTERLACED))
-                continue;
-        }
-
-        if (format_id == WINED3DFMT_UNKNOWN)
-        {
-            /* This is for d3d8, do not enumerate P8 here. */
-            if (mode.dmBitsPerPel == 32 || mode.dmBitsPerPel == 16) ++i;
-        }
-        else if (mode.dmBitsPerPel == format_bits)
-        {
-            ++i;
-        }
-    }
+    if (!(filter = wined3d_adapter_get_modes(adapter, format_id, scanline_ordering)))
+        return 0;
 
-    TRACE("Returning %u matching modes (out of %u total) for adapter %u.\n", i, j, adapter_idx);
+    TRACE("Returning %u matching modes (out of %u total) for adapter %u.\n",
+            filter->count, adapter->mode_table.count, adapter_idx);
 
-    return i;
+    return filter->count;
 }
 
 /* Note: dx9 supplies a format. Calls from d3d8 supply WINED3DFMT_UNKNOWN */
@@ -4252,12 +4375,9 @@ HRESULT CDECL wined3d_enum_adapter_modes(const struct wined3d *wined3d, UINT ada
         enum wined3d_format_id format_id, enum wined3d_scanline_ordering scanline_ordering,
         UINT mode_idx, struct wined3d_display_mode *mode)
 {
+    const struct wined3d_adapter_mode_filter *filter;
+    const struct wined3d_adapter_mode *m;
     const struct wined3d_adapter *adapter;
-    const struct wined3d_format *format;
-    UINT format_bits;
-    DEVMODEA m;
-    UINT i = 0;
-    int j = 0;
 
     TRACE("wined3d %p, adapter_idx %u, format %s, scanline_ordering %#x, mode_idx %u, mode %p.\n",
             wined3d, adapter_idx, debug_d3dformat(format_id), scanline_ordering, mode_idx, mode);
@@ -4266,62 +4386,28 @@ HRESULT CDECL wined3d_enum_adapter_modes(const struct wined3d *wined3d, UINT ada
         return WINED3DERR_INVALIDCALL;
 
     adapter = &wined3d->adapters[adapter_idx];
-    format = wined3d_get_format(&adapter->gl_info, format_id);
-    format_bits = format->byte_count * CHAR_BIT;
-
-    memset(&m, 0, sizeof(m));
-    m.dmSize = sizeof(m);
+    if (!(filter = wined3d_adapter_get_modes(adapter, format_id, scanline_ordering)))
+        return WINED3DERR_INVALIDCALL;
 
-    while (i <= mode_idx)
+    if (mode_idx >= filter->count)
     {
-        if (!EnumDisplaySettingsA95(adapter->DeviceName, j++, &m))
-        {
-            WARN("Invalid mode_idx %u.\n", mode_idx);
-            return WINED3DERR_INVALIDCALL;
-        }
-
-        if (m.dmFields & DM_DISPLAYFLAGS)
-        {
-            if (scanline_ordering == WINED3D_SCANLINE_ORDERING_PROGRESSIVE
-                    && (DUMMYACCESS1(m, u2, dmDisplayFlags) & DM_INTERLACED))
-                continue;
-
-            if (scanline_ordering == WINED3D_SCANLINE_ORDERING_INTERLACED
-                    && !(DUMMYACCESS1(m, u2, dmDisplayFlags) & DM_INTERLACED))
-                continue;
-        }
-
-        if (format_id == WINED3DFMT_UNKNOWN)
-        {
-            /* This is for d3d8, do not enumerate P8 here. */
-            if (m.dmBitsPerPel == 32 || m.dmBitsPerPel == 16) ++i;
-        }
-        else if (m.dmBitsPerPel == format_bits)
-        {
-            ++i;
-        }
+        WARN("Invalid mode_idx %u.\n", mode_idx);
+        return WINED3DERR_INVALIDCALL;
     }
+    m = &adapter->mode_table.modes[filter->indices[mode_idx]];
 
-    mode->width = m.dmPelsWidth;
-    mode->height = m.dmPelsHeight;
-    mode->refresh_rate = DEFAULT_REFRESH_RATE;
-    if (m.dmFields & DM_DISPLAYFREQUENCY)
-        mode->refresh_rate = m.dmDisplayFrequency;
+    mode->width = m->width;
+    mode->height = m->height;
+    mode->refresh_rate = m->refresh_rate;
+    mode->scanline_ordering = m->scanline_ordering;
 
     if (format_id == WINED3DFMT_UNKNOWN)
-        mode->format_id = pixelformat_for_depth(m.dmBitsPerPel);
+        mode->format_id = pixelformat_for_depth(m->bpp);
     else
         mode->format_id = format_id;
 
-    if (!(m.dmFields & DM_DISPLAYFLAGS))
-        mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_UNKNOWN;
-    else if (DUMMYACCESS1(m, u2, dmDisplayFlags) & DM_INTERLACED)
-        mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_INTERLACED;
-    else
-        mode->scanline_ordering = WINED3D_SCANLINE_ORDERING_PROGRESSIVE;
-
     TRACE("%ux%u@%u %u bpp, %s %#x.\n", mode->width, mode->height, mode->refresh_rate,
-            m.dmBitsPerPel, debug_d3dformat(mode->format_id), mode->scanline_ordering);
+            m->bpp, debug_d3dformat(mode->format_id), mode->scanline_ordering);
 
     return WINED3D_OK;
 }
@@ -4543,6 +4629,7 @@ HRESULT CDECL wined3d_set_adapter_display_mode(struct wined3d *wined3d,
 
     /* Store the new values. */
     adapter->screen_format = new_format_id;
+    wined3d_adapter_invalidate_modes(adapter);
 
     /* And finally clip mouse to our screen. */
     SetRect(&clip_rc, 0, 0, new_mode.dmPelsWidth, new_mode.dmPelsHeight);
@@ -6362,12 +6449,6 @@ static BOOL wined3d_adapter_init(struct wined3d_adapter *adapter, UINT ordinal)
         return FALSE;
     }
 
-#ifndef VBOX_WITH_WINE_FIX_POLYOFFSET_SCALE
-    gl_info->fixed_polyoffset_scale = wined3d_adapter_find_polyoffset_scale(&caps_gl_ctx, GL_DEPTH_COMPONENT);
-    if (gl_info->supported[ARB_DEPTH_BUFFER_FLOAT])
-        gl_info->float_polyoffset_scale = wined3d_adapter_find_polyoffset_scale(&caps_gl_ctx, GL_DEPTH32F_STENCIL8);
-#endif
-
     adapter->vram_bytes = adapter->driver_info.vram_bytes;
     adapter->vram_bytes_used = 0;
     TRACE("Emulating 0x%s bytes of video ram.\n", wine_dbgstr_longlong(adapter->vram_bytes));
@@ -6430,6 +6511,7 @@ HRESULT wined3d_init(struct wined3d *wined3d, DWORD flags)
     if (flags & WINED3D_NO3D)
     {
         wined3d_adapter_init_nogl(&wined3d->adapters[0], 0);
+        InitializeCriticalSection(&wined3d->adapters[0].memory_cs);
         wined3d->adapter_count = 1;
         return WINED3D_OK;
     }
@@ -6439,6 +6521,7 @@ HRESULT wined3d_init(struct wined3d *wined3d, DWORD flags)
         WARN("Failed to initialize adapter.\n");
         return E_FAIL;
     }
+    InitializeCriticalSection(&wined3d->adapters[0].memory_cs);
     wined3d->adapter_count = 1;
 
     return WINED3D_OK;
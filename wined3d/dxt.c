@@ -0,0 +1,521 @@
+/*
+ * Software DXT (S3TC) decompression for GL drivers without
+ * GL_EXT_texture_compression_s3tc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include "wined3d_private.h"
+
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WINED3D_DXT_SSE2
+#include <emmintrin.h>
+#endif
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+
+enum wined3d_dxt_type
+{
+    WINED3D_DXT_1,
+    WINED3D_DXT_3,
+    WINED3D_DXT_5,
+};
+
+/*****************************************************************************
+ * Block decoding
+ *
+ * Every block is decoded to 16 B8G8R8A8 pixels. The color part is decoded
+ * into a four entry palette (the two endpoints and two interpolated colors),
+ * the alpha part into 16 alpha bytes which then replace the palette alpha.
+ */
+
+static inline DWORD dxt_expand_565(WORD c)
+{
+    DWORD r = (c >> 11) & 0x1f;
+    DWORD g = (c >> 5) & 0x3f;
+    DWORD b = c & 0x1f;
+
+    return 0xff000000u
+            | ((r << 3 | r >> 2) << 16)
+            | ((g << 2 | g >> 4) << 8)
+            | (b << 3 | b >> 2);
+}
+
+#ifdef WINED3D_DXT_SSE2
+static inline __m128i dxt_color_palette(const BYTE *block, BOOL three_color)
+{
+    WORD c0 = block[0] | block[1] << 8;
+    WORD c1 = block[2] | block[3] << 8;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ends, mid;
+
+    /* 16 bits per channel: c0.bgra, c1.bgra */
+    ends = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(dxt_expand_565(c0)),
+            _mm_cvtsi32_si128(dxt_expand_565(c1))), zero);
+
+    if (three_color && c0 <= c1)
+    {
+        /* c2 = (c0 + c1) / 2, c3 = transparent black */
+        mid = _mm_add_epi16(ends, _mm_shuffle_epi32(ends, _MM_SHUFFLE(1, 0, 3, 2)));
+        mid = _mm_srli_epi16(mid, 1);
+        mid = _mm_unpacklo_epi64(mid, zero);
+    }
+    else
+    {
+        /* c2 = (2 * c0 + c1) / 3, c3 = (c0 + 2 * c1) / 3. Multiplying by
+         * 0x5556 and keeping the high half is an exact division by 3 for
+         * every sum that can occur here. */
+        mid = _mm_add_epi16(_mm_add_epi16(ends, ends), _mm_shuffle_epi32(ends, _MM_SHUFFLE(1, 0, 3, 2)));
+        mid = _mm_mulhi_epu16(mid, _mm_set1_epi16(0x5556));
+    }
+
+    return _mm_packus_epi16(ends, mid);
+}
+
+static inline __m128i dxt_gather_row(const DWORD *palette, DWORD indices)
+{
+    return _mm_set_epi32(palette[(indices >> 6) & 3], palette[(indices >> 4) & 3],
+            palette[(indices >> 2) & 3], palette[indices & 3]);
+}
+
+/* Returns the 16 alpha bytes of a block as 4 registers of 4 DWORDs with
+ * the alpha value in the top byte. */
+static inline void dxt_alpha_to_rows(__m128i alpha, __m128i rows[4])
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(zero, alpha);
+    __m128i hi = _mm_unpackhi_epi8(zero, alpha);
+
+    rows[0] = _mm_unpacklo_epi16(zero, lo);
+    rows[1] = _mm_unpackhi_epi16(zero, lo);
+    rows[2] = _mm_unpacklo_epi16(zero, hi);
+    rows[3] = _mm_unpackhi_epi16(zero, hi);
+}
+
+static inline __m128i dxt3_alpha(const BYTE *block)
+{
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    __m128i packed = _mm_loadl_epi64((const __m128i *)block);
+    __m128i lo = _mm_and_si128(packed, nibble_mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble_mask);
+    __m128i alpha = _mm_unpacklo_epi8(lo, hi);
+
+    /* a8 = a4 * 17; no carry can cross a byte since a4 < 16. */
+    return _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+}
+#else
+static inline void dxt_color_palette(const BYTE *block, BOOL three_color, DWORD *palette)
+{
+    WORD c0 = block[0] | block[1] << 8;
+    WORD c1 = block[2] | block[3] << 8;
+    unsigned int i;
+
+    palette[0] = dxt_expand_565(c0);
+    palette[1] = dxt_expand_565(c1);
+
+    if (three_color && c0 <= c1)
+    {
+        palette[2] = 0xff000000u;
+        for (i = 0; i < 24; i += 8)
+            palette[2] |= ((((palette[0] >> i) & 0xff) + ((palette[1] >> i) & 0xff)) / 2) << i;
+        palette[3] = 0x00000000u;
+    }
+    else
+    {
+        palette[2] = palette[3] = 0xff000000u;
+        for (i = 0; i < 24; i += 8)
+        {
+            DWORD a = (palette[0] >> i) & 0xff;
+            DWORD b = (palette[1] >> i) & 0xff;
+
+            palette[2] |= ((2 * a + b) / 3) << i;
+            palette[3] |= ((a + 2 * b) / 3) << i;
+        }
+    }
+}
+
+static inline void dxt3_alpha(const BYTE *block, BYTE *alpha)
+{
+    unsigned int i;
+
+    for (i = 0; i < 8; ++i)
+    {
+        alpha[2 * i] = (block[i] & 0x0f) * 0x11;
+        alpha[2 * i + 1] = (block[i] >> 4) * 0x11;
+    }
+}
+#endif
+
+static inline void dxt5_alpha(const BYTE *block, BYTE *alpha)
+{
+    DWORD a0 = block[0], a1 = block[1];
+    DWORD lo = block[2] | block[3] << 8 | block[4] << 16;
+    DWORD hi = block[5] | block[6] << 8 | block[7] << 16;
+    BYTE table[8];
+    unsigned int i;
+
+    table[0] = a0;
+    table[1] = a1;
+    if (a0 > a1)
+    {
+        for (i = 1; i < 7; ++i)
+            table[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    else
+    {
+        for (i = 1; i < 5; ++i)
+            table[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        table[6] = 0x00;
+        table[7] = 0xff;
+    }
+
+    for (i = 0; i < 8; ++i)
+    {
+        alpha[i] = table[(lo >> (3 * i)) & 7];
+        alpha[i + 8] = table[(hi >> (3 * i)) & 7];
+    }
+}
+
+/* Decodes one block into a 4x4 B8G8R8A8 tile with a pitch of "dst_pitch" bytes. */
+static void dxt_decode_block(enum wined3d_dxt_type type, const BYTE *block, BYTE *dst, UINT dst_pitch)
+{
+    const BYTE *color = type == WINED3D_DXT_1 ? block : block + 8;
+    DWORD indices = color[4] | color[5] << 8 | color[6] << 16 | (DWORD)color[7] << 24;
+    unsigned int y;
+#ifdef WINED3D_DXT_SSE2
+    DWORD palette[4];
+    __m128i alpha_rows[4];
+
+    _mm_storeu_si128((__m128i *)palette, dxt_color_palette(color, type == WINED3D_DXT_1));
+
+    if (type == WINED3D_DXT_1)
+    {
+        for (y = 0; y < 4; ++y, indices >>= 8)
+            _mm_storeu_si128((__m128i *)(dst + y * dst_pitch), dxt_gather_row(palette, indices));
+        return;
+    }
+
+    if (type == WINED3D_DXT_3)
+    {
+        dxt_alpha_to_rows(dxt3_alpha(block), alpha_rows);
+    }
+    else
+    {
+        BYTE alpha[16];
+
+        dxt5_alpha(block, alpha);
+        dxt_alpha_to_rows(_mm_loadu_si128((const __m128i *)alpha), alpha_rows);
+    }
+
+    for (y = 0; y < 4; ++y, indices >>= 8)
+    {
+        __m128i row = _mm_and_si128(dxt_gather_row(palette, indices), _mm_set1_epi32(0x00ffffff));
+        _mm_storeu_si128((__m128i *)(dst + y * dst_pitch), _mm_or_si128(row, alpha_rows[y]));
+    }
+#else
+    DWORD palette[4];
+    BYTE alpha[16];
+    unsigned int x;
+
+    dxt_color_palette(color, type == WINED3D_DXT_1, palette);
+
+    if (type == WINED3D_DXT_1)
+    {
+        for (y = 0; y < 4; ++y)
+        {
+            DWORD *row = (DWORD *)(dst + y * dst_pitch);
+            for (x = 0; x < 4; ++x, indices >>= 2)
+                row[x] = palette[indices & 3];
+        }
+        return;
+    }
+
+    if (type == WINED3D_DXT_3)
+        dxt3_alpha(block, alpha);
+    else
+        dxt5_alpha(block, alpha);
+
+    for (y = 0; y < 4; ++y)
+    {
+        DWORD *row = (DWORD *)(dst + y * dst_pitch);
+        for (x = 0; x < 4; ++x, indices >>= 2)
+            row[x] = (palette[indices & 3] & 0x00ffffff) | (DWORD)alpha[y * 4 + x] << 24;
+    }
+#endif
+}
+
+static void dxt_decode_slice(enum wined3d_dxt_type type, const BYTE *src, BYTE *dst,
+        UINT src_row_pitch, UINT dst_row_pitch, UINT width, UINT height)
+{
+    UINT block_size = type == WINED3D_DXT_1 ? 8 : 16;
+    DWORD tile[16];
+    UINT x, y, w, h, i;
+
+    for (y = 0; y < height; y += 4)
+    {
+        const BYTE *block = src + (y / 4) * src_row_pitch;
+        BYTE *dst_row = dst + y * dst_row_pitch;
+
+        h = min(4, height - y);
+        for (x = 0; x < width; x += 4, block += block_size)
+        {
+            w = min(4, width - x);
+            if (w == 4 && h == 4)
+            {
+                dxt_decode_block(type, block, dst_row + x * 4, dst_row_pitch);
+                continue;
+            }
+
+            /* Partial blocks at the right and bottom edge, and mip levels
+             * smaller than a block. */
+            dxt_decode_block(type, block, (BYTE *)tile, 4 * sizeof(*tile));
+            for (i = 0; i < h; ++i)
+                memcpy(dst_row + i * dst_row_pitch + x * 4, &tile[i * 4], w * sizeof(*tile));
+        }
+    }
+}
+
+/*****************************************************************************
+ * Decoded level cache
+ *
+ * Reloading a texture (after eviction, a device reset or a sRGB switch)
+ * would decode the same data again. Decoded slices are kept in a small LRU
+ * cache, looked up by a hash of the compressed data. A copy of the
+ * compressed data is kept as well so that a hash collision can never
+ * produce a wrong texture.
+ */
+
+#define WINED3D_DXT_CACHE_BUCKETS   256
+/* Decoding anything smaller than this is cheaper than the lookup. */
+#define WINED3D_DXT_CACHE_MIN_SIZE  (64 * 64 * 4)
+
+struct wined3d_dxt_cache_entry
+{
+    struct list entry;
+    struct wined3d_dxt_cache_entry *next;
+    DWORD hash;
+    enum wined3d_dxt_type type;
+    UINT width, height;
+    UINT src_size, dst_size;
+    BYTE *src, *dst;
+};
+
+static struct
+{
+    CRITICAL_SECTION cs;
+    BOOL initialized;
+    struct list lru;
+    struct wined3d_dxt_cache_entry *buckets[WINED3D_DXT_CACHE_BUCKETS];
+    SIZE_T size;
+    unsigned int hits, misses;
+} dxt_cache;
+
+static DWORD dxt_hash_slice(const BYTE *src, UINT src_row_pitch, UINT row_size, UINT row_count)
+{
+    DWORD hash = WINED3D_HASH_SEED;
+    UINT y;
+
+    for (y = 0; y < row_count; ++y, src += src_row_pitch)
+        hash = wined3d_hash_fnv1a(hash, src, row_size);
+
+    return hash;
+}
+
+static BOOL dxt_cache_compare(const struct wined3d_dxt_cache_entry *entry,
+        const BYTE *src, UINT src_row_pitch, UINT row_size, UINT row_count)
+{
+    UINT y;
+
+    for (y = 0; y < row_count; ++y, src += src_row_pitch)
+    {
+        if (memcmp(entry->src + y * row_size, src, row_size))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void dxt_cache_remove(struct wined3d_dxt_cache_entry *entry)
+{
+    struct wined3d_dxt_cache_entry **prev = &dxt_cache.buckets[entry->hash % WINED3D_DXT_CACHE_BUCKETS];
+
+    while (*prev != entry)
+        prev = &(*prev)->next;
+    *prev = entry->next;
+
+    list_remove(&entry->entry);
+    dxt_cache.size -= entry->src_size + entry->dst_size;
+    free(entry);
+}
+
+static BOOL dxt_cache_lookup(enum wined3d_dxt_type type, const BYTE *src, BYTE *dst,
+        UINT src_row_pitch, UINT dst_row_pitch, UINT width, UINT height, DWORD hash)
+{
+    UINT row_size = ((width + 3) / 4) * (type == WINED3D_DXT_1 ? 8 : 16);
+    UINT row_count = (height + 3) / 4;
+    struct wined3d_dxt_cache_entry *entry;
+    UINT y;
+
+    for (entry = dxt_cache.buckets[hash % WINED3D_DXT_CACHE_BUCKETS]; entry; entry = entry->next)
+    {
+        if (entry->hash != hash || entry->type != type
+                || entry->width != width || entry->height != height)
+            continue;
+        if (!dxt_cache_compare(entry, src, src_row_pitch, row_size, row_count))
+            continue;
+
+        for (y = 0; y < height; ++y)
+            memcpy(dst + y * dst_row_pitch, entry->dst + y * width * 4, width * 4);
+
+        list_remove(&entry->entry);
+        list_add_head(&dxt_cache.lru, &entry->entry);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void dxt_cache_insert(enum wined3d_dxt_type type, const BYTE *src, const BYTE *dst,
+        UINT src_row_pitch, UINT dst_row_pitch, UINT width, UINT height, DWORD hash)
+{
+    UINT row_size = ((width + 3) / 4) * (type == WINED3D_DXT_1 ? 8 : 16);
+    UINT row_count = (height + 3) / 4;
+    SIZE_T budget = wined3d_settings.dxt_cache_size;
+    struct wined3d_dxt_cache_entry *entry;
+    UINT src_size = row_size * row_count;
+    UINT dst_size = width * height * 4;
+    UINT y;
+
+    /* Don't let a single huge level flush the whole cache. */
+    if (src_size + dst_size > budget / 4)
+        return;
+
+    while (dxt_cache.size + src_size + dst_size > budget && !list_empty(&dxt_cache.lru))
+        dxt_cache_remove(LIST_ENTRY(list_tail(&dxt_cache.lru), struct wined3d_dxt_cache_entry, entry));
+
+    if (!(entry = malloc(sizeof(*entry) + src_size + dst_size)))
+        return;
+
+    entry->hash = hash;
+    entry->type = type;
+    entry->width = width;
+    entry->height = height;
+    entry->src_size = src_size;
+    entry->dst_size = dst_size;
+    entry->src = (BYTE *)(entry + 1);
+    entry->dst = entry->src + src_size;
+
+    for (y = 0; y < row_count; ++y)
+        memcpy(entry->src + y * row_size, src + y * src_row_pitch, row_size);
+    for (y = 0; y < height; ++y)
+        memcpy(entry->dst + y * width * 4, dst + y * dst_row_pitch, width * 4);
+
+    entry->next = dxt_cache.buckets[hash % WINED3D_DXT_CACHE_BUCKETS];
+    dxt_cache.buckets[hash % WINED3D_DXT_CACHE_BUCKETS] = entry;
+    list_add_head(&dxt_cache.lru, &entry->entry);
+    dxt_cache.size += src_size + dst_size;
+}
+
+void wined3d_dxt_cache_init(void)
+{
+    InitializeCriticalSection(&dxt_cache.cs);
+    list_init(&dxt_cache.lru);
+    dxt_cache.initialized = TRUE;
+}
+
+void wined3d_dxt_cache_cleanup(void)
+{
+    if (!dxt_cache.initialized)
+        return;
+
+    TRACE("DXT cache: %u hits, %u misses, %lu bytes in use.\n",
+            dxt_cache.hits, dxt_cache.misses, (unsigned long)dxt_cache.size);
+
+    while (!list_empty(&dxt_cache.lru))
+        dxt_cache_remove(LIST_ENTRY(list_head(&dxt_cache.lru), struct wined3d_dxt_cache_entry, entry));
+
+    DeleteCriticalSection(&dxt_cache.cs);
+    dxt_cache.initialized = FALSE;
+}
+
+static void dxt_decode(enum wined3d_dxt_type type, const BYTE *src, BYTE *dst,
+        UINT src_row_pitch, UINT src_slice_pitch, UINT dst_row_pitch, UINT dst_slice_pitch,
+        UINT width, UINT height, UINT depth)
+{
+    UINT row_size = ((width + 3) / 4) * (type == WINED3D_DXT_1 ? 8 : 16);
+    BOOL use_cache = dxt_cache.initialized && wined3d_settings.dxt_cache_size
+            && width * height * 4 >= WINED3D_DXT_CACHE_MIN_SIZE;
+    DWORD hash;
+    UINT z;
+
+    TRACE("Decoding %ux%ux%u DXT%u, pitches %u %u.\n", width, height, depth,
+            type == WINED3D_DXT_1 ? 1 : type == WINED3D_DXT_3 ? 3 : 5, src_row_pitch, dst_row_pitch);
+
+    for (z = 0; z < depth; ++z)
+    {
+        const BYTE *src_slice = src + z * src_slice_pitch;
+        BYTE *dst_slice = dst + z * dst_slice_pitch;
+
+        if (!use_cache)
+        {
+            dxt_decode_slice(type, src_slice, dst_slice, src_row_pitch, dst_row_pitch, width, height);
+            continue;
+        }
+
+        hash = dxt_hash_slice(src_slice, src_row_pitch, row_size, (height + 3) / 4);
+
+        EnterCriticalSection(&dxt_cache.cs);
+        if (dxt_cache_lookup(type, src_slice, dst_slice, src_row_pitch, dst_row_pitch, width, height, hash))
+        {
+            ++dxt_cache.hits;
+            LeaveCriticalSection(&dxt_cache.cs);
+            continue;
+        }
+        ++dxt_cache.misses;
+        LeaveCriticalSection(&dxt_cache.cs);
+
+        dxt_decode_slice(type, src_slice, dst_slice, src_row_pitch, dst_row_pitch, width, height);
+
+        EnterCriticalSection(&dxt_cache.cs);
+        dxt_cache_insert(type, src_slice, dst_slice, src_row_pitch, dst_row_pitch, width, height, hash);
+        LeaveCriticalSection(&dxt_cache.cs);
+    }
+}
+
+/* DXT2 and DXT4 use the same block layout as DXT3 and DXT5, the premultiplied
+ * alpha is only a hint for the application. */
+void convert_dxt1_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth)
+{
+    dxt_decode(WINED3D_DXT_1, src, dst, src_row_pitch, src_slice_pitch,
+            dst_row_pitch, dst_slice_pitch, width, height, depth);
+}
+
+void convert_dxt3_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth)
+{
+    dxt_decode(WINED3D_DXT_3, src, dst, src_row_pitch, src_slice_pitch,
+            dst_row_pitch, dst_slice_pitch, width, height, depth);
+}
+
+void convert_dxt5_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth)
+{
+    dxt_decode(WINED3D_DXT_5, src, dst, src_row_pitch, src_slice_pitch,
+            dst_row_pitch, dst_slice_pitch, width, height, depth);
+}
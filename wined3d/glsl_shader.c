@@ -42,6 +42,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
 WINE_DECLARE_DEBUG_CHANNEL(d3d);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
 
 #define WINED3D_GLSL_SAMPLE_PROJECTED   0x1
@@ -105,7 +106,7 @@ struct shader_glsl_priv {
     const struct wined3d_vertex_pipe_ops *vertex_pipe;
     const struct fragment_pipeline *fragment_pipe;
     struct wine_rb_tree ffp_vertex_shaders;
-    struct wine_rb_tree ffp_fragment_shaders;
+    struct wined3d_ffp_frag_programs ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
 };
@@ -211,6 +212,7 @@ struct shader_glsl_ctx_priv {
 struct glsl_context_data
 {
     struct glsl_shader_prog_link *glsl_program;
+    struct glsl_ffp_vertex_shader *ffp_vertex_shader;
 };
 
 struct glsl_ps_compiled_shader
@@ -231,8 +233,12 @@ struct glsl_gs_compiled_shader
     GLuint id;
 };
 
+/* Shared by all wined3d shaders interned from the same byte code, see
+ * shader_find_interned(). */
 struct glsl_shader_private
 {
+    LONG refcount;
+    struct list linked_programs;
     union
     {
         struct glsl_vs_compiled_shader *vs;
@@ -2145,6 +2151,31 @@ static void shader_glsl_gen_modifier(enum wined3d_shader_src_modifier src_modifi
     }
 }
 
+/* The most common register names are built without sprintf(). */
+static char *shader_glsl_append_str(char *dst, const char *src)
+{
+    while ((*dst = *src++))
+        ++dst;
+
+    return dst;
+}
+
+static char *shader_glsl_append_uint(char *dst, unsigned int value)
+{
+    char tmp[10];
+    unsigned int i = 0;
+
+    do
+    {
+        tmp[i++] = '0' + value % 10;
+    } while (value /= 10);
+    while (i)
+        *dst++ = tmp[--i];
+    *dst = '\0';
+
+    return dst;
+}
+
 /** Writes the GLSL variable name that corresponds to the register that the
  * DX opcode parameter is trying to access */
 static void shader_glsl_get_register_name(const struct wined3d_shader_register *reg,
@@ -2160,6 +2191,7 @@ static void shader_glsl_get_register_name(const struct wined3d_shader_register *
     const char *prefix = shader_glsl_get_prefix(version->type);
     struct glsl_src_param rel_param0, rel_param1;
     char imm_str[4][17];
+    char *ptr;
 
     if (reg->idx[0].offset != ~0U && reg->idx[0].rel_addr)
         shader_glsl_add_src_param(ins, reg->idx[0].rel_addr, WINED3DSP_WRITEMASK_0, &rel_param0);
@@ -2170,7 +2202,8 @@ static void shader_glsl_get_register_name(const struct wined3d_shader_register *
     switch (reg->type)
     {
         case WINED3DSPR_TEMP:
-            sprintf(register_name, "R%u", reg->idx[0].offset);
+            register_name[0] = 'R';
+            shader_glsl_append_uint(register_name + 1, reg->idx[0].offset);
             break;
 
         case WINED3DSPR_INPUT:
@@ -2180,7 +2213,9 @@ static void shader_glsl_get_register_name(const struct wined3d_shader_register *
                 struct shader_glsl_ctx_priv *priv = ins->ctx->backend_data;
                 if (priv->cur_vs_args->swizzle_map & (1u << reg->idx[0].offset))
                     *is_color = TRUE;
-                sprintf(register_name, "%s_in%u", prefix, reg->idx[0].offset);
+                ptr = shader_glsl_append_str(register_name, prefix);
+                ptr = shader_glsl_append_str(ptr, "_in");
+                shader_glsl_append_uint(ptr, reg->idx[0].offset);
                 break;
             }
 
@@ -2283,10 +2318,13 @@ static void shader_glsl_get_register_name(const struct wined3d_shader_register *
                 }
                 else
                 {
-                    if (shader_constant_is_local(shader, reg->idx[0].offset))
-                        sprintf(register_name, "%s_lc%u", prefix, reg->idx[0].offset);
-                    else
-                        sprintf(register_name, "%s_c[%u]", prefix, reg->idx[0].offset);
+                    BOOL local = shader_constant_is_local(shader, reg->idx[0].offset);
+
+                    ptr = shader_glsl_append_str(register_name, prefix);
+                    ptr = shader_glsl_append_str(ptr, local ? "_lc" : "_c[");
+                    ptr = shader_glsl_append_uint(ptr, reg->idx[0].offset);
+                    if (!local)
+                        shader_glsl_append_str(ptr, "]");
                 }
             }
             break;
@@ -5224,6 +5262,17 @@ static void shader_glsl_generate_fog_code(struct wined3d_string_buffer *buffer,
             " clamp(fog, 0.0, 1.0));\n");
 }
 
+static void shader_glsl_trace_generation(const struct wined3d_shader *shader,
+        const LARGE_INTEGER *start, const struct wined3d_string_buffer *buffer)
+{
+    LARGE_INTEGER end, freq;
+
+    QueryPerformanceCounter(&end);
+    QueryPerformanceFrequency(&freq);
+    TRACE_(d3d_perf)("Generated %u bytes of GLSL for shader %p in %.3f ms.\n", buffer->content_size,
+            shader, (end.QuadPart - start->QuadPart) * 1000.0 / freq.QuadPart);
+}
+
 /* Context activation is done by the caller. */
 static GLuint shader_glsl_generate_pshader(const struct wined3d_context *context,
         struct wined3d_string_buffer *buffer, struct wined3d_string_buffer_list *string_buffers,
@@ -5232,13 +5281,16 @@ static GLuint shader_glsl_generate_pshader(const struct wined3d_context *context
 {
     const struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
     const struct wined3d_gl_info *gl_info = context->gl_info;
-    const DWORD *function = shader->function;
     struct shader_glsl_ctx_priv priv_ctx;
+    LARGE_INTEGER start;
     BOOL legacy_context = gl_info->supported[WINED3D_GL_LEGACY_CONTEXT];
 
     /* Create the hw GLSL shader object and assign it as the shader->prgId */
     GLuint shader_id = GL_EXTCALL(glCreateShader(GL_FRAGMENT_SHADER));
 
+    if (TRACE_ON(d3d_perf))
+        QueryPerformanceCounter(&start);
+
     memset(&priv_ctx, 0, sizeof(priv_ctx));
     priv_ctx.cur_ps_args = args;
     priv_ctx.cur_np2fixup_info = np2fixup_info;
@@ -5299,7 +5351,7 @@ static GLuint shader_glsl_generate_pshader(const struct wined3d_context *context
         shader_glsl_input_pack(shader, buffer, &shader->input_signature, reg_maps, args, gl_info);
 
     /* Base Shader Body */
-    shader_generate_main(shader, buffer, reg_maps, function, &priv_ctx);
+    shader_generate_main(shader, buffer, reg_maps, &priv_ctx);
 
     /* Pixel shaders < 2.0 place the resulting color in R0 implicitly */
     if (reg_maps->shader_version.major < 2)
@@ -5317,6 +5369,9 @@ static GLuint shader_glsl_generate_pshader(const struct wined3d_context *context
 
     shader_addline(buffer, "}\n");
 
+    if (TRACE_ON(d3d_perf))
+        shader_glsl_trace_generation(shader, &start, buffer);
+
     TRACE("Compiling shader object %u.\n", shader_id);
     shader_glsl_compile(gl_info, shader_id, buffer->buffer);
 
@@ -5331,13 +5386,16 @@ static GLuint shader_glsl_generate_vshader(const struct wined3d_context *context
 {
     const struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
     const struct wined3d_gl_info *gl_info = context->gl_info;
-    const DWORD *function = shader->function;
     struct shader_glsl_ctx_priv priv_ctx;
+    LARGE_INTEGER start;
     BOOL legacy_context = gl_info->supported[WINED3D_GL_LEGACY_CONTEXT];
 
     /* Create the hw GLSL shader program and assign it as the shader->prgId */
     GLuint shader_id = GL_EXTCALL(glCreateShader(GL_VERTEX_SHADER));
 
+    if (TRACE_ON(d3d_perf))
+        QueryPerformanceCounter(&start);
+
     shader_addline(buffer, "%s\n", shader_glsl_get_version(gl_info, &reg_maps->shader_version));
 
     if (gl_info->supported[ARB_DRAW_INSTANCED])
@@ -5357,7 +5415,7 @@ static GLuint shader_glsl_generate_vshader(const struct wined3d_context *context
     shader_generate_glsl_declarations(context, buffer, shader, reg_maps, &priv_ctx);
 
     /* Base Shader Body */
-    shader_generate_main(shader, buffer, reg_maps, function, &priv_ctx);
+    shader_generate_main(shader, buffer, reg_maps, &priv_ctx);
 
     /* Unpack outputs */
     shader_addline(buffer, "order_ps_input(vs_out);\n");
@@ -5404,6 +5462,9 @@ static GLuint shader_glsl_generate_vshader(const struct wined3d_context *context
 
     shader_addline(buffer, "}\n");
 
+    if (TRACE_ON(d3d_perf))
+        shader_glsl_trace_generation(shader, &start, buffer);
+
     TRACE("Compiling shader object %u.\n", shader_id);
     shader_glsl_compile(gl_info, shader_id, buffer->buffer);
 
@@ -5417,7 +5478,6 @@ static GLuint shader_glsl_generate_geometry_shader(const struct wined3d_context
 {
     const struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
     const struct wined3d_gl_info *gl_info = context->gl_info;
-    const DWORD *function = shader->function;
     struct shader_glsl_ctx_priv priv_ctx;
     GLuint shader_id;
 
@@ -5437,7 +5497,7 @@ static GLuint shader_glsl_generate_geometry_shader(const struct wined3d_context
     memset(&priv_ctx, 0, sizeof(priv_ctx));
     priv_ctx.string_buffers = string_buffers;
     shader_generate_glsl_declarations(context, buffer, shader, reg_maps, &priv_ctx);
-    shader_generate_main(shader, buffer, reg_maps, function, &priv_ctx);
+    shader_generate_main(shader, buffer, reg_maps, &priv_ctx);
     shader_addline(buffer, "}\n");
 
     TRACE("Compiling shader object %u.\n", shader_id);
@@ -5446,6 +5506,32 @@ static GLuint shader_glsl_generate_geometry_shader(const struct wined3d_context
     return shader_id;
 }
 
+static struct glsl_shader_private *shader_glsl_get_private(struct wined3d_shader *shader)
+{
+    struct glsl_shader_private *shader_data;
+
+    if (!(shader_data = shader->backend_data))
+    {
+        if (!(shader_data = calloc(1, sizeof(*shader_data))))
+        {
+            ERR("Failed to allocate backend data.\n");
+            return NULL;
+        }
+        shader_data->refcount = 1;
+        list_init(&shader_data->linked_programs);
+        shader->backend_data = shader_data;
+    }
+
+    return shader_data;
+}
+
+static struct list *shader_glsl_linked_programs(const struct wined3d_shader *shader)
+{
+    struct glsl_shader_private *shader_data = shader->backend_data;
+
+    return shader_data ? &shader_data->linked_programs : NULL;
+}
+
 static GLuint find_glsl_pshader(const struct wined3d_context *context,
         struct wined3d_string_buffer *buffer, struct wined3d_string_buffer_list *string_buffers,
         struct wined3d_shader *shader,
@@ -5458,16 +5544,8 @@ static GLuint find_glsl_pshader(const struct wined3d_context *context,
     DWORD new_size;
     GLuint ret;
 
-    if (!shader->backend_data)
-    {
-        shader->backend_data = calloc(1, sizeof(*shader_data));
-        if (!shader->backend_data)
-        {
-            ERR("Failed to allocate backend data.\n");
-            return 0;
-        }
-    }
-    shader_data = shader->backend_data;
+    if (!(shader_data = shader_glsl_get_private(shader)))
+        return 0;
     gl_shaders = shader_data->gl_shaders.ps;
 
     /* Usually we have very few GL shaders for each d3d shader(just 1 or maybe 2),
@@ -5548,16 +5626,8 @@ static GLuint find_glsl_vshader(const struct wined3d_context *context,
     struct glsl_shader_private *shader_data;
     GLuint ret;
 
-    if (!shader->backend_data)
-    {
-        shader->backend_data = calloc(1, sizeof(*shader_data));
-        if (!shader->backend_data)
-        {
-            ERR("Failed to allocate backend data.\n");
-            return 0;
-        }
-    }
-    shader_data = shader->backend_data;
+    if (!(shader_data = shader_glsl_get_private(shader)))
+        return 0;
     gl_shaders = shader_data->gl_shaders.vs;
 
     /* Usually we have very few GL shaders for each d3d shader(just 1 or maybe 2),
@@ -5611,15 +5681,8 @@ static GLuint find_glsl_geometry_shader(const struct wined3d_context *context,
     struct glsl_shader_private *shader_data;
     GLuint ret;
 
-    if (!shader->backend_data)
-    {
-        if (!(shader->backend_data = calloc(1, sizeof(*shader_data))))
-        {
-            ERR("Failed to allocate backend data.\n");
-            return 0;
-        }
-    }
-    shader_data = shader->backend_data;
+    if (!(shader_data = shader_glsl_get_private(shader)))
+        return 0;
     gl_shaders = shader_data->gl_shaders.gs;
 
     if (shader_data->num_gl_shaders)
@@ -6735,13 +6798,17 @@ static GLuint shader_glsl_generate_ffp_fragment_shader(struct shader_glsl_priv *
 }
 
 static struct glsl_ffp_vertex_shader *shader_glsl_find_ffp_vertex_shader(struct shader_glsl_priv *priv,
-        const struct wined3d_gl_info *gl_info, const struct wined3d_ffp_vs_settings *settings)
+        struct glsl_context_data *ctx_data, const struct wined3d_gl_info *gl_info,
+        const struct wined3d_ffp_vs_settings *settings)
 {
     struct glsl_ffp_vertex_shader *shader;
     const struct wine_rb_entry *entry;
 
+    if ((shader = ctx_data->ffp_vertex_shader) && !memcmp(&shader->desc.settings, settings, sizeof(*settings)))
+        return shader;
+
     if ((entry = wine_rb_get(&priv->ffp_vertex_shaders, settings)))
-        return WINE_RB_ENTRY_VALUE(entry, struct glsl_ffp_vertex_shader, desc.entry);
+        return ctx_data->ffp_vertex_shader = WINE_RB_ENTRY_VALUE(entry, struct glsl_ffp_vertex_shader, desc.entry);
 
     if (!(shader = malloc( sizeof(*shader))))
         return NULL;
@@ -6751,17 +6818,19 @@ static struct glsl_ffp_vertex_shader *shader_glsl_find_ffp_vertex_shader(struct
     list_init(&shader->linked_programs);
     if (wine_rb_put(&priv->ffp_vertex_shaders, &shader->desc.settings, &shader->desc.entry) == -1)
         ERR("Failed to insert ffp vertex shader.\n");
+    ctx_data->ffp_vertex_shader = shader;
 
     return shader;
 }
 
 static struct glsl_ffp_fragment_shader *shader_glsl_find_ffp_fragment_shader(struct shader_glsl_priv *priv,
-        const struct wined3d_gl_info *gl_info, const struct ffp_frag_settings *args)
+        struct wined3d_context *context, const struct ffp_frag_settings *args)
 {
+    const struct wined3d_gl_info *gl_info = context->gl_info;
     struct glsl_ffp_fragment_shader *glsl_desc;
     const struct ffp_frag_desc *desc;
 
-    if ((desc = find_ffp_frag_shader(&priv->ffp_fragment_shaders, args)))
+    if ((desc = find_ffp_frag_shader(context, &priv->ffp_fragment_shaders, args)))
         return CONTAINING_RECORD(desc, struct glsl_ffp_fragment_shader, entry);
 
     if (!(glsl_desc = malloc( sizeof(*glsl_desc))))
@@ -6770,7 +6839,7 @@ static struct glsl_ffp_fragment_shader *shader_glsl_find_ffp_fragment_shader(str
     glsl_desc->entry.settings = *args;
     glsl_desc->id = shader_glsl_generate_ffp_fragment_shader(priv, args, gl_info);
     list_init(&glsl_desc->linked_programs);
-    add_ffp_frag_shader(&priv->ffp_fragment_shaders, &glsl_desc->entry);
+    add_ffp_frag_shader(context, &priv->ffp_fragment_shaders, &glsl_desc->entry);
 
     return glsl_desc;
 }
@@ -6939,7 +7008,7 @@ static void shader_glsl_init_uniform_block_bindings(const struct wined3d_gl_info
 }
 
 /* Context activation is done by the caller. */
-static void set_glsl_shader_program(const struct wined3d_context *context, const struct wined3d_state *state,
+static void set_glsl_shader_program(struct wined3d_context *context, const struct wined3d_state *state,
         struct shader_glsl_priv *priv, struct glsl_context_data *ctx_data)
 {
     const struct wined3d_gl_info *gl_info = context->gl_info;
@@ -6984,7 +7053,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
 
         find_vs_compile_args(state, vshader, context->stream_info.swizzle_map, &vs_compile_args, d3d_info);
         vs_id = find_glsl_vshader(context, &priv->shader_buffer, &priv->string_buffers, vshader, &vs_compile_args);
-        vs_list = &vshader->linked_programs;
+        vs_list = shader_glsl_linked_programs(vshader);
 
         if ((gshader = state->shader[WINED3D_SHADER_TYPE_GEOMETRY]))
             gs_id = find_glsl_geometry_shader(context, &priv->shader_buffer, &priv->string_buffers, gshader);
@@ -6995,7 +7064,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         struct wined3d_ffp_vs_settings settings;
 
         wined3d_ffp_get_vs_settings(context, state, &settings);
-        ffp_shader = shader_glsl_find_ffp_vertex_shader(priv, gl_info, &settings);
+        ffp_shader = shader_glsl_find_ffp_vertex_shader(priv, ctx_data, gl_info, &settings);
         vs_id = ffp_shader->id;
         vs_list = &ffp_shader->linked_programs;
     }
@@ -7015,7 +7084,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         find_ps_compile_args(state, pshader, context->stream_info.position_transformed, &ps_compile_args, context);
         ps_id = find_glsl_pshader(context, &priv->shader_buffer, &priv->string_buffers,
                 pshader, &ps_compile_args, &np2fixup_info);
-        ps_list = &pshader->linked_programs;
+        ps_list = shader_glsl_linked_programs(pshader);
     }
     else if (priv->fragment_pipe == &glsl_fragment_pipe)
     {
@@ -7023,7 +7092,7 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         struct ffp_frag_settings settings;
 
         gen_ffp_frag_op(context, state, &settings, FALSE);
-        ffp_shader = shader_glsl_find_ffp_fragment_shader(priv, gl_info, &settings);
+        ffp_shader = shader_glsl_find_ffp_fragment_shader(priv, context, &settings);
         ps_id = ffp_shader->id;
         ps_list = &ffp_shader->linked_programs;
     }
@@ -7121,7 +7190,8 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
                 gshader->u.gs.vertices_out));
         checkGLcall("glProgramParameteriARB");
 
-        list_add_head(&gshader->linked_programs, &entry->gs.shader_entry);
+        if (gs_id)
+            list_add_head(shader_glsl_linked_programs(gshader), &entry->gs.shader_entry);
     }
 
     /* Attach GLSL pshader */
@@ -7530,13 +7600,22 @@ static void shader_glsl_destroy(struct wined3d_shader *shader)
     struct wined3d_device *device = shader->device;
     struct shader_glsl_priv *priv = device->shader_priv;
     const struct wined3d_gl_info *gl_info;
+    struct glsl_shader_prog_link *entry, *entry2;
     const struct list *linked_programs;
     struct wined3d_context *context;
+    unsigned int i;
+
+    if (!shader_data)
+        return;
 
-    if (!shader_data || !shader_data->num_gl_shaders)
+    /* Other shaders with the same byte code still use the GL shaders. */
+    shader->backend_data = NULL;
+    if (--shader_data->refcount)
+        return;
+
+    if (!shader_data->num_gl_shaders)
     {
         free(shader_data);
-        shader->backend_data = NULL;
         return;
     }
 
@@ -7544,104 +7623,109 @@ static void shader_glsl_destroy(struct wined3d_shader *shader)
     gl_info = context->gl_info;
 
     TRACE("Deleting linked programs.\n");
-    linked_programs = &shader->linked_programs;
-    if (linked_programs->next)
+    linked_programs = &shader_data->linked_programs;
+    switch (shader->reg_maps.shader_version.type)
     {
-        struct glsl_shader_prog_link *entry, *entry2;
-        UINT i;
-
-        switch (shader->reg_maps.shader_version.type)
+        case WINED3D_SHADER_TYPE_PIXEL:
         {
-            case WINED3D_SHADER_TYPE_PIXEL:
-            {
-                struct glsl_ps_compiled_shader *gl_shaders = shader_data->gl_shaders.ps;
+            struct glsl_ps_compiled_shader *gl_shaders = shader_data->gl_shaders.ps;
 
-                for (i = 0; i < shader_data->num_gl_shaders; ++i)
-                {
-                    TRACE("Deleting pixel shader %u.\n", gl_shaders[i].id);
-                    GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
-                    checkGLcall("glDeleteShader");
-                }
-                free(shader_data->gl_shaders.ps);
+            for (i = 0; i < shader_data->num_gl_shaders; ++i)
+            {
+                TRACE("Deleting pixel shader %u.\n", gl_shaders[i].id);
+                GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
+                checkGLcall("glDeleteShader");
+            }
+            free(shader_data->gl_shaders.ps);
 
-                LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
-                        struct glsl_shader_prog_link, ps.shader_entry)
-                {
-                    shader_glsl_invalidate_contexts_program(device, entry);
-                    delete_glsl_program_entry(priv, gl_info, entry
+            LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
+                    struct glsl_shader_prog_link, ps.shader_entry)
+            {
+                shader_glsl_invalidate_contexts_program(device, entry);
+                delete_glsl_program_entry(priv, gl_info, entry
 #ifdef VBOX_WITH_WINE_FIX_SHADERCLEANUP
-                            , context
+                        , context
 #endif
-          					);
-                }
-
-                break;
+      					);
             }
 
-            case WINED3D_SHADER_TYPE_VERTEX:
-            {
-                struct glsl_vs_compiled_shader *gl_shaders = shader_data->gl_shaders.vs;
+            break;
+        }
 
-                for (i = 0; i < shader_data->num_gl_shaders; ++i)
-                {
-                    TRACE("Deleting vertex shader %u.\n", gl_shaders[i].id);
-                    GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
-                    checkGLcall("glDeleteShader");
-                }
-                free(shader_data->gl_shaders.vs);
+        case WINED3D_SHADER_TYPE_VERTEX:
+        {
+            struct glsl_vs_compiled_shader *gl_shaders = shader_data->gl_shaders.vs;
 
-                LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
-                        struct glsl_shader_prog_link, vs.shader_entry)
-                {
-                    shader_glsl_invalidate_contexts_program(device, entry);
-                    delete_glsl_program_entry(priv, gl_info, entry
+            for (i = 0; i < shader_data->num_gl_shaders; ++i)
+            {
+                TRACE("Deleting vertex shader %u.\n", gl_shaders[i].id);
+                GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
+                checkGLcall("glDeleteShader");
+            }
+            free(shader_data->gl_shaders.vs);
+
+            LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
+                    struct glsl_shader_prog_link, vs.shader_entry)
+            {
+                shader_glsl_invalidate_contexts_program(device, entry);
+                delete_glsl_program_entry(priv, gl_info, entry
 #ifdef VBOX_WITH_WINE_FIX_SHADERCLEANUP
-                            , context
+                        , context
 #endif
-          					);
-                }
-
-                break;
+      					);
             }
 
-            case WINED3D_SHADER_TYPE_GEOMETRY:
-            {
-                struct glsl_gs_compiled_shader *gl_shaders = shader_data->gl_shaders.gs;
+            break;
+        }
 
-                for (i = 0; i < shader_data->num_gl_shaders; ++i)
-                {
-                    TRACE("Deleting geometry shader %u.\n", gl_shaders[i].id);
-                    GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
-                    checkGLcall("glDeleteShader");
-                }
-                free(shader_data->gl_shaders.gs);
+        case WINED3D_SHADER_TYPE_GEOMETRY:
+        {
+            struct glsl_gs_compiled_shader *gl_shaders = shader_data->gl_shaders.gs;
 
-                LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
-                        struct glsl_shader_prog_link, gs.shader_entry)
-                {
-                    shader_glsl_invalidate_contexts_program(device, entry);
-                    delete_glsl_program_entry(priv, gl_info, entry
+            for (i = 0; i < shader_data->num_gl_shaders; ++i)
+            {
+                TRACE("Deleting geometry shader %u.\n", gl_shaders[i].id);
+                GL_EXTCALL(glDeleteShader(gl_shaders[i].id));
+                checkGLcall("glDeleteShader");
+            }
+            free(shader_data->gl_shaders.gs);
+
+            LIST_FOR_EACH_ENTRY_SAFE(entry, entry2, linked_programs,
+                    struct glsl_shader_prog_link, gs.shader_entry)
+            {
+                shader_glsl_invalidate_contexts_program(device, entry);
+                delete_glsl_program_entry(priv, gl_info, entry
 #ifdef VBOX_WITH_WINE_FIX_SHADERCLEANUP
-                            , context
+                        , context
 #endif
-          					);
-                }
-
-                break;
+      					);
             }
 
-            default:
-                ERR("Unhandled shader type %#x.\n", shader->reg_maps.shader_version.type);
-                break;
+            break;
         }
+
+        default:
+            ERR("Unhandled shader type %#x.\n", shader->reg_maps.shader_version.type);
+            break;
     }
 
-    free(shader->backend_data);
-    shader->backend_data = NULL;
+    free(shader_data);
 
     context_release(context);
 }
 
+/* "shader" was interned from "source", so it can use the same GL shaders. */
+static void shader_glsl_share(struct wined3d_shader *shader, struct wined3d_shader *source)
+{
+    struct glsl_shader_private *shader_data;
+
+    if (!(shader_data = shader_glsl_get_private(source)))
+        return;
+
+    ++shader_data->refcount;
+    shader->backend_data = shader_data;
+}
+
 static int glsl_program_key_compare(const void *key, const struct wine_rb_entry *entry)
 {
     const struct glsl_program_key *k = key;
@@ -8049,6 +8133,7 @@ const struct wined3d_shader_backend_ops glsl_shader_backend =
     shader_glsl_update_float_pixel_constants,
     shader_glsl_load_constants,
     shader_glsl_destroy,
+    shader_glsl_share,
     shader_glsl_alloc,
     shader_glsl_free,
     shader_glsl_allocate_context_data,
@@ -8534,12 +8619,7 @@ static void *glsl_fragment_pipe_alloc(const struct wined3d_shader_backend_ops *s
     if (shader_backend == &glsl_shader_backend)
     {
         priv = shader_priv;
-
-        if (wine_rb_init(&priv->ffp_fragment_shaders, &wined3d_ffp_frag_program_rb_functions) == -1)
-        {
-            ERR("Failed to initialize rbtree.\n");
-            return NULL;
-        }
+        wined3d_ffp_frag_programs_init(&priv->ffp_fragment_shaders);
 
         return priv;
     }
@@ -8549,10 +8629,9 @@ static void *glsl_fragment_pipe_alloc(const struct wined3d_shader_backend_ops *s
     return NULL;
 }
 
-static void shader_glsl_free_ffp_fragment_shader(struct wine_rb_entry *entry, void *context)
+static void shader_glsl_free_ffp_fragment_shader(struct ffp_frag_desc *desc, void *context)
 {
-    struct glsl_ffp_fragment_shader *shader = WINE_RB_ENTRY_VALUE(entry,
-            struct glsl_ffp_fragment_shader, entry.entry);
+    struct glsl_ffp_fragment_shader *shader = CONTAINING_RECORD(desc, struct glsl_ffp_fragment_shader, entry);
     struct glsl_shader_prog_link *program, *program2;
     struct glsl_ffp_destroy_ctx *ctx = context;
 
@@ -8580,7 +8659,7 @@ static void glsl_fragment_pipe_free(struct wined3d_device *device)
 #ifdef VBOX_WITH_WINE_FIX_SHADERCLEANUP
     ctx.context = device->contexts[0];
 #endif
-    wine_rb_destroy(&priv->ffp_fragment_shaders, shader_glsl_free_ffp_fragment_shader, &ctx);
+    wined3d_ffp_frag_programs_destroy(&priv->ffp_fragment_shaders, shader_glsl_free_ffp_fragment_shader, &ctx);
 }
 
 static void glsl_fragment_pipe_shader(struct wined3d_context *context,
@@ -0,0 +1,214 @@
+/*
+ * Fast LZ77 codec for packing idle system memory copies of resources
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+
+/* The stream is a sequence of
+ *
+ *   token, [literal length bytes], literals, offset (2 bytes), [match length bytes]
+ *
+ * The high nibble of the token is the literal count and the low nibble the
+ * match length minus WINED3D_LZ_MIN_MATCH. A nibble of 15 is continued by
+ * bytes that are added to it, up to and including the first one below 255.
+ * The last sequence has no offset and no match. Texture data is mostly
+ * either very repetitive or not compressible at all, so there is no entropy
+ * coding; speed matters more than ratio here. */
+
+#define WINED3D_LZ_MIN_MATCH    4
+#define WINED3D_LZ_MAX_OFFSET   0xffff
+#define WINED3D_LZ_HASH_BITS    12
+/* Matches are not searched for in the last bytes, so that reading a 4 byte
+ * sequence never goes past the end. */
+#define WINED3D_LZ_TAIL         8
+
+static inline DWORD lz_read32(const BYTE *ptr)
+{
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (DWORD)ptr[3] << 24;
+}
+
+static inline unsigned int lz_hash(DWORD value)
+{
+    return (value * 2654435761u) >> (32 - WINED3D_LZ_HASH_BITS);
+}
+
+static BYTE *lz_put_length(BYTE *dst, const BYTE *dst_end, SIZE_T length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        if (dst >= dst_end)
+            return NULL;
+        *dst++ = 255;
+    }
+    if (dst >= dst_end)
+        return NULL;
+    *dst++ = length;
+
+    return dst;
+}
+
+static BYTE *lz_put_sequence(BYTE *dst, const BYTE *dst_end, const BYTE *literals,
+        SIZE_T literal_count, SIZE_T offset, SIZE_T match_length)
+{
+    BYTE *token;
+
+    if (dst >= dst_end)
+        return NULL;
+    token = dst++;
+
+    *token = (literal_count < 15 ? literal_count : 15) << 4;
+    if (literal_count >= 15 && !(dst = lz_put_length(dst, dst_end, literal_count - 15)))
+        return NULL;
+    if ((SIZE_T)(dst_end - dst) < literal_count)
+        return NULL;
+    memcpy(dst, literals, literal_count);
+    dst += literal_count;
+
+    if (!offset)
+        return dst;
+
+    if (dst_end - dst < 2)
+        return NULL;
+    *dst++ = offset & 0xff;
+    *dst++ = offset >> 8;
+
+    match_length -= WINED3D_LZ_MIN_MATCH;
+    *token |= match_length < 15 ? match_length : 15;
+    if (match_length >= 15 && !(dst = lz_put_length(dst, dst_end, match_length - 15)))
+        return NULL;
+
+    return dst;
+}
+
+/* Returns the compressed size, or 0 if the data doesn't fit into "dst_size"
+ * bytes. */
+SIZE_T wined3d_lz_compress(const void *src, SIZE_T src_size, void *dst, SIZE_T dst_size)
+{
+    const BYTE *in = src, *in_end = in + src_size, *anchor = in, *match;
+    const BYTE *limit = src_size > WINED3D_LZ_TAIL ? in_end - WINED3D_LZ_TAIL : in;
+    BYTE *out = dst, *out_end = out + dst_size;
+    const BYTE **table;
+    SIZE_T length;
+    unsigned int h;
+
+    if (!(table = calloc(1 << WINED3D_LZ_HASH_BITS, sizeof(*table))))
+        return 0;
+
+    while (in < limit)
+    {
+        h = lz_hash(lz_read32(in));
+        match = table[h];
+        table[h] = in;
+
+        if (!match || in - match > WINED3D_LZ_MAX_OFFSET || lz_read32(match) != lz_read32(in))
+        {
+            ++in;
+            continue;
+        }
+
+        length = WINED3D_LZ_MIN_MATCH;
+        while (in + length < in_end && match[length] == in[length])
+            ++length;
+
+        if (!(out = lz_put_sequence(out, out_end, anchor, in - anchor, in - match, length)))
+            break;
+
+        in += length;
+        anchor = in;
+    }
+
+    if (out)
+        out = lz_put_sequence(out, out_end, anchor, in_end - anchor, 0, 0);
+    free(table);
+
+    return out ? out - (BYTE *)dst : 0;
+}
+
+static const BYTE *lz_get_length(const BYTE *src, const BYTE *src_end, SIZE_T *length)
+{
+    BYTE value;
+
+    do
+    {
+        if (src >= src_end)
+            return NULL;
+        value = *src++;
+        *length += value;
+    } while (value == 255);
+
+    return src;
+}
+
+/* Returns FALSE if "src" isn't a valid stream that decompresses to exactly
+ * "dst_size" bytes. */
+BOOL wined3d_lz_decompress(const void *src, SIZE_T src_size, void *dst, SIZE_T dst_size)
+{
+    const BYTE *in = src, *in_end = in + src_size, *match;
+    BYTE *out = dst, *out_end = out + dst_size;
+    SIZE_T length, offset;
+    BYTE token;
+
+    while (in < in_end)
+    {
+        token = *in++;
+
+        length = token >> 4;
+        if (length == 15 && !(in = lz_get_length(in, in_end, &length)))
+            return FALSE;
+        if ((SIZE_T)(in_end - in) < length || (SIZE_T)(out_end - out) < length)
+            return FALSE;
+        memcpy(out, in, length);
+        in += length;
+        out += length;
+
+        if (in == in_end)
+            break;
+
+        if (in_end - in < 2)
+            return FALSE;
+        offset = in[0] | in[1] << 8;
+        in += 2;
+        if (!offset || offset > (SIZE_T)(out - (BYTE *)dst))
+            return FALSE;
+
+        length = token & 0xf;
+        if (length == 15 && !(in = lz_get_length(in, in_end, &length)))
+            return FALSE;
+        length += WINED3D_LZ_MIN_MATCH;
+        if ((SIZE_T)(out_end - out) < length)
+            return FALSE;
+
+        match = out - offset;
+        if (offset >= length)
+        {
+            memcpy(out, match, length);
+            out += length;
+        }
+        else
+        {
+            while (length--)
+                *out++ = *match++;
+        }
+    }
+
+    return out == out_end;
+}
@@ -36,7 +36,7 @@ void wined3d_event_query_destroy(struct wined3d_event_query *query)
     free(query);
 }
 
-static enum wined3d_event_query_result wined3d_event_query_test(const struct wined3d_event_query *query,
+enum wined3d_event_query_result wined3d_event_query_test(const struct wined3d_event_query *query,
         const struct wined3d_device *device)
 {
     struct wined3d_context *context;
@@ -241,6 +241,9 @@ ULONG CDECL wined3d_query_decref(struct wined3d_query *query)
 
     if (!refcount)
     {
+        if (query->polling)
+            list_remove(&query->poll_entry);
+
         /* Queries are specific to the GL context that created them. Not
          * deleting the query will obviously leak it, but that's still better
          * than potentially deleting a different query with the same id in this
@@ -300,16 +303,118 @@ static void fill_query_data(void *out, unsigned int out_size, const void *result
     memcpy(out, result, min(out_size, result_size));
 }
 
+static void wined3d_query_stop_polling(struct wined3d_query *query)
+{
+    query->result_valid = FALSE;
+    if (!query->polling)
+        return;
+    list_remove(&query->poll_entry);
+    query->polling = FALSE;
+}
+
+/* Called when the query is ended. The first GetData() after that always goes
+ * to GL. */
+static void wined3d_query_start_polling(struct wined3d_query *query)
+{
+    struct wined3d_device *device = query->device;
+
+    query->result_valid = FALSE;
+    query->poll_batch = device->query_batch - 1;
+    if (query->polling)
+        return;
+    list_add_tail(&device->pending_queries, &query->poll_entry);
+    query->polling = TRUE;
+}
+
+static struct wined3d_context *wined3d_query_get_context(const struct wined3d_query *query)
+{
+    if (query->type == WINED3D_QUERY_TYPE_OCCLUSION)
+        return ((struct wined3d_occlusion_query *)query->extendedData)->context;
+    return ((struct wined3d_event_query *)query->extendedData)->context;
+}
+
+/* Submits the commands the query waits for. Done at most once per batch,
+ * however often the application passes WINED3DGETDATA_FLUSH. */
+static void wined3d_query_flush(struct wined3d_query *query)
+{
+    struct wined3d_device *device = query->device;
+    struct wined3d_context *context = wined3d_query_get_context(query);
+
+    if (device->query_flush_batch == device->query_batch
+            || !context || context->tid != GetCurrentThreadId())
+        return;
+
+    context = context_acquire(device, context->current_rt);
+    context->gl_info->gl_ops.gl.p_glFlush();
+    context_release(context);
+    device->query_flush_batch = device->query_batch;
+}
+
+static HRESULT wined3d_query_poll(struct wined3d_query *query)
+{
+    HRESULT hr;
+
+    hr = query->query_ops->query_poll(query);
+    query->poll_batch = query->device->query_batch;
+    query->spin_count = 0;
+    if (hr == S_OK)
+    {
+        wined3d_query_stop_polling(query);
+        query->result_valid = TRUE;
+    }
+
+    return hr;
+}
+
+/* Applications tend to spin on GetData(), with or without
+ * WINED3DGETDATA_FLUSH. Once a query has been found busy, GL isn't asked
+ * again until something was drawn or presented, or the application called
+ * WINED3D_QUERY_SPIN_COUNT more times. */
+static HRESULT wined3d_query_update_result(struct wined3d_query *query, DWORD flags)
+{
+    if (query->result_valid)
+        return S_OK;
+
+    if (flags & WINED3DGETDATA_FLUSH)
+        wined3d_query_flush(query);
+
+    if (query->poll_batch == query->device->query_batch
+            && ++query->spin_count < WINED3D_QUERY_SPIN_COUNT)
+    {
+        TRACE("Query %p was already polled in this batch.\n", query);
+        return S_FALSE;
+    }
+
+    return wined3d_query_poll(query);
+}
+
+/* Context activation is done by the caller. Polls the queries that belong
+ * to the current context, once per present. */
+void wined3d_query_poll_pending(struct wined3d_device *device, const struct wined3d_context *context)
+{
+    struct wined3d_query *query, *next;
+    unsigned int count = 0;
+
+    LIST_FOR_EACH_ENTRY_SAFE(query, next, &device->pending_queries, struct wined3d_query, poll_entry)
+    {
+        if (wined3d_query_get_context(query) != context)
+            continue;
+
+        wined3d_query_poll(query);
+        ++count;
+    }
+
+    TRACE("Polled %u queries.\n", count);
+}
+
 static HRESULT wined3d_occlusion_query_ops_get_data(struct wined3d_query *query,
         void *data, DWORD size, DWORD flags)
 {
     struct wined3d_occlusion_query *oq = query->extendedData;
     struct wined3d_device *device = query->device;
     const struct wined3d_gl_info *gl_info = &device->adapter->gl_info;
-    struct wined3d_context *context;
-    GLuint available;
     GLuint samples;
-    HRESULT res;
+    HRESULT hr;
 
     TRACE("query %p, data %p, size %#x, flags %#x.\n", query, data, size, flags);
 
@@ -348,7 +453,24 @@ static HRESULT wined3d_occlusion_query_ops_get_data(struct wined3d_query *query,
         return S_OK;
     }
 
+    if ((hr = wined3d_query_update_result(query, flags)) == S_OK)
+    {
+        TRACE("Returning %u samples.\n", query->result);
+        fill_query_data(data, size, &query->result, sizeof(query->result));
+    }
+
+    return hr;
+}
+
+static HRESULT wined3d_occlusion_query_ops_poll(struct wined3d_query *query)
+{
+    struct wined3d_occlusion_query *oq = query->extendedData;
+    const struct wined3d_gl_info *gl_info;
+    struct wined3d_context *context;
+    GLuint available, samples;
+
     context = context_acquire(query->device, oq->context->current_rt);
+    gl_info = context->gl_info;
 
     GL_EXTCALL(glGetQueryObjectuiv(oq->id, GL_QUERY_RESULT_AVAILABLE, &available));
     checkGLcall("glGetQueryObjectuiv(GL_QUERY_RESULT_AVAILABLE)");
@@ -356,23 +478,14 @@ static HRESULT wined3d_occlusion_query_ops_get_data(struct wined3d_query *query,
 
     if (available)
     {
-        if (size)
-        {
-            GL_EXTCALL(glGetQueryObjectuiv(oq->id, GL_QUERY_RESULT, &samples));
-            checkGLcall("glGetQueryObjectuiv(GL_QUERY_RESULT)");
-            TRACE("Returning %d samples.\n", samples);
-            fill_query_data(data, size, &samples, sizeof(samples));
-        }
-        res = S_OK;
-    }
-    else
-    {
-        res = S_FALSE;
+        GL_EXTCALL(glGetQueryObjectuiv(oq->id, GL_QUERY_RESULT, &samples));
+        checkGLcall("glGetQueryObjectuiv(GL_QUERY_RESULT)");
+        query->result = samples;
     }
 
     context_release(context);
 
-    return res;
+    return available ? S_OK : S_FALSE;
 }
 
 static HRESULT wined3d_event_query_ops_get_data(struct wined3d_query *query,
@@ -380,7 +493,7 @@ static HRESULT wined3d_event_query_ops_get_data(struct wined3d_query *query,
 {
     struct wined3d_event_query *event_query = query->extendedData;
     BOOL signaled;
-    enum wined3d_event_query_result ret;
+    HRESULT hr;
 
     TRACE("query %p, data %p, size %#x, flags %#x.\n", query, data, size, flags);
 
@@ -393,32 +506,37 @@ static HRESULT wined3d_event_query_ops_get_data(struct wined3d_query *query,
         return S_OK;
     }
 
-    ret = wined3d_event_query_test(event_query, query->device);
-    switch(ret)
+    if (FAILED(hr = wined3d_query_update_result(query, flags)))
+        return hr;
+
+    signaled = hr == S_OK && query->result;
+    fill_query_data(data, size, &signaled, sizeof(signaled));
+
+    return S_OK;
+}
+
+static HRESULT wined3d_event_query_ops_poll(struct wined3d_query *query)
+{
+    switch (wined3d_event_query_test(query->extendedData, query->device))
     {
         case WINED3D_EVENT_QUERY_OK:
         case WINED3D_EVENT_QUERY_NOT_STARTED:
-            signaled = TRUE;
-            fill_query_data(data, size, &signaled, sizeof(signaled));
-            break;
+            query->result = TRUE;
+            return S_OK;
 
         case WINED3D_EVENT_QUERY_WAITING:
-            signaled = FALSE;
-            fill_query_data(data, size, &signaled, sizeof(signaled));
-            break;
+            return S_FALSE;
 
         case WINED3D_EVENT_QUERY_WRONG_THREAD:
             FIXME("(%p) Wrong thread, reporting GPU idle.\n", query);
-            signaled = TRUE;
-            fill_query_data(data, size, &signaled, sizeof(signaled));
-            break;
+            query->result = TRUE;
+            return S_OK;
 
         case WINED3D_EVENT_QUERY_ERROR:
+        default:
             ERR("The GL event query failed, returning D3DERR_INVALIDCALL\n");
             return WINED3DERR_INVALIDCALL;
     }
-
-    return S_OK;
 }
 
 void * CDECL wined3d_query_get_parent(const struct wined3d_query *query)
@@ -448,6 +566,7 @@ static HRESULT wined3d_event_query_ops_issue(struct wined3d_query *query, DWORD
         if (!event_query) return WINED3D_OK;
 
         wined3d_event_query_issue(event_query, query->device);
+        wined3d_query_start_polling(query);
     }
     else if (flags & WINED3DISSUE_BEGIN)
     {
@@ -478,6 +597,8 @@ static HRESULT wined3d_occlusion_query_ops_issue(struct wined3d_query *query, DW
         /* This is allowed according to msdn and our tests. Reset the query and restart */
         if (flags & WINED3DISSUE_BEGIN)
         {
+            wined3d_query_stop_polling(query);
+
             if (query->state == QUERY_BUILDING)
             {
                 if (oq->context->tid != GetCurrentThreadId())
@@ -528,6 +649,7 @@ static HRESULT wined3d_occlusion_query_ops_issue(struct wined3d_query *query, DW
                     checkGLcall("glEndQuery()");
 
                     context_release(context);
+                    wined3d_query_start_polling(query);
                 }
             }
         }
@@ -685,24 +807,28 @@ static const struct wined3d_query_ops event_query_ops =
 {
     wined3d_event_query_ops_get_data,
     wined3d_event_query_ops_issue,
+    wined3d_event_query_ops_poll,
 };
 
 static const struct wined3d_query_ops occlusion_query_ops =
 {
     wined3d_occlusion_query_ops_get_data,
     wined3d_occlusion_query_ops_issue,
+    wined3d_occlusion_query_ops_poll,
 };
 
 static const struct wined3d_query_ops timestamp_query_ops =
 {
     wined3d_timestamp_query_ops_get_data,
     wined3d_timestamp_query_ops_issue,
+    NULL,
 };
 
 static const struct wined3d_query_ops timestamp_disjoint_query_ops =
 {
     wined3d_timestamp_disjoint_query_ops_get_data,
     wined3d_timestamp_disjoint_query_ops_issue,
+    NULL,
 };
 
 static HRESULT query_init(struct wined3d_query *query, struct wined3d_device *device,
@@ -188,6 +188,10 @@ HRESULT resource_init(struct wined3d_resource *resource, struct wined3d_device *
     resource->depth = depth;
     resource->size = size;
     resource->priority = 0;
+    resource->packed_memory = NULL;
+    resource->packed_size = 0;
+    resource->access_frame = device->frame_count;
+    resource->incompressible = FALSE;
     resource->parent = parent;
     resource->parent_ops = parent_ops;
     resource->resource_ops = resource_ops;
@@ -207,18 +211,20 @@ HRESULT resource_init(struct wined3d_resource *resource, struct wined3d_device *
     }
 
     /* Check that we have enough video ram left */
-    if (pool == WINED3D_POOL_DEFAULT && d3d->flags & WINED3D_VIDMEM_ACCOUNTING)
+    if (pool == WINED3D_POOL_DEFAULT && d3d->flags & WINED3D_VIDMEM_ACCOUNTING
+            && !adapter_reserve_memory(device->adapter, size))
     {
-        if (size > wined3d_device_get_available_texture_mem(device))
-        {
-            ERR("Out of adapter memory\n");
-            wined3d_resource_free_sysmem(resource);
-            return WINED3DERR_OUTOFVIDEOMEMORY;
-        }
-        adapter_adjust_memory(device->adapter, size);
+        ERR("Out of adapter memory\n");
+        wined3d_resource_free_sysmem(resource);
+        return WINED3DERR_OUTOFVIDEOMEMORY;
     }
 
-    device_resource_add(device, resource);
+    /* The front ends create textures and buffers without the wined3d mutex,
+     * so that worker threads loading resources don't wait for the rendering
+     * thread. The resource is only added to the device's list, which has a
+     * lock of its own, once it is complete; until then nothing else can see
+     * it. See wined3d_texture_create() and buffer_init(). */
+    list_init(&resource->resource_list_entry);
 
     return WINED3D_OK;
 }
@@ -237,7 +243,9 @@ void resource_cleanup(struct wined3d_resource *resource)
 
     wined3d_resource_free_sysmem(resource);
 
-    device_resource_released(resource->device, resource);
+    /* When creation failed, the resource never made it to the device. */
+    if (!list_empty(&resource->resource_list_entry))
+        device_resource_released(resource->device, resource);
 }
 
 void resource_unload(struct wined3d_resource *resource)
@@ -281,6 +289,10 @@ void CDECL wined3d_resource_set_parent(struct wined3d_resource *resource, void *
     resource->parent = parent;
 }
 
+/* The front ends call this without holding the wined3d mutex for textures,
+ * volumes and buffers, whose description is fixed once they are returned to
+ * the application. Swapchain buffers and ddraw surfaces can change through
+ * wined3d_texture_update_desc(), so queries for those still take it. */
 void CDECL wined3d_resource_get_desc(const struct wined3d_resource *resource, struct wined3d_resource_desc *desc)
 {
     desc->resource_type = resource->type;
@@ -313,32 +325,85 @@ HRESULT CDECL wined3d_resource_unmap(struct wined3d_resource *resource, unsigned
 
 BOOL wined3d_resource_allocate_sysmem(struct wined3d_resource *resource)
 {
-    void **p;
-    SIZE_T align = RESOURCE_ALIGNMENT - 1 + sizeof(*p);
-    void *mem;
-
-    if (!(mem = calloc(1, resource->size + align)))
+    if (!(resource->heap_memory = wined3d_sysmem_alloc(resource->size)))
         return FALSE;
-
-    p = (void **)(((ULONG_PTR)mem + align) & ~(RESOURCE_ALIGNMENT - 1)) - 1;
-    *p = mem;
-
-    resource->heap_memory = ++p;
+    resource->heap_size = resource->size;
 
     return TRUE;
 }
 
 void wined3d_resource_free_sysmem(struct wined3d_resource *resource)
 {
-    void **p = resource->heap_memory;
+    free(resource->packed_memory);
+    resource->packed_memory = NULL;
+    resource->packed_size = 0;
 
-    if (!p)
+    if (!resource->heap_memory)
         return;
 
-    free(*(--p));
+    wined3d_sysmem_free(resource->heap_memory, resource->heap_size);
     resource->heap_memory = NULL;
 }
 
+/* Replaces the system memory copy with a compressed one. Fails if that
+ * wouldn't save at least a quarter of the memory, in which case it isn't
+ * tried again until the resource is mapped for writing. */
+BOOL wined3d_resource_pack_sysmem(struct wined3d_resource *resource)
+{
+    SIZE_T limit = resource->size - resource->size / 4, size;
+    void *packed, *shrunk;
+
+    if (!resource->heap_memory || resource->packed_memory || resource->incompressible || !limit)
+        return FALSE;
+
+    if (!(packed = malloc(limit)))
+        return FALSE;
+    if (!(size = wined3d_lz_compress(resource->heap_memory, resource->size, packed, limit)))
+    {
+        TRACE("Resource %p doesn't compress well, keeping it as it is.\n", resource);
+        resource->incompressible = TRUE;
+        free(packed);
+        return FALSE;
+    }
+    if ((shrunk = realloc(packed, size)))
+        packed = shrunk;
+
+    wined3d_resource_free_sysmem(resource);
+    resource->packed_memory = packed;
+    resource->packed_size = size;
+    TRACE("Packed resource %p from %u to %lu bytes.\n", resource, resource->size, (unsigned long)size);
+
+    return TRUE;
+}
+
+/* Brings back the system memory copy replaced by wined3d_resource_pack_sysmem(). */
+BOOL wined3d_resource_unpack_sysmem(struct wined3d_resource *resource)
+{
+    void *packed = resource->packed_memory;
+    SIZE_T size = resource->packed_size;
+
+    resource->access_frame = resource->device->frame_count;
+    if (!packed)
+        return TRUE;
+
+    TRACE("Unpacking resource %p.\n", resource);
+
+    resource->packed_memory = NULL;
+    resource->packed_size = 0;
+    if (!wined3d_resource_allocate_sysmem(resource))
+    {
+        ERR("Failed to allocate system memory.\n");
+        resource->packed_memory = packed;
+        resource->packed_size = size;
+        return FALSE;
+    }
+    if (!wined3d_lz_decompress(packed, size, resource->heap_memory, resource->size))
+        ERR("Packed data of resource %p is corrupted.\n", resource);
+    free(packed);
+
+    return TRUE;
+}
+
 DWORD wined3d_resource_sanitize_map_flags(const struct wined3d_resource *resource, DWORD flags)
 {
     /* Not all flags make sense together, but Windows never returns an error.
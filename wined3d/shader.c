@@ -287,11 +287,111 @@ BOOL string_buffer_resize(struct wined3d_string_buffer *buffer, int rc)
     return TRUE;
 }
 
+static BOOL string_buffer_reserve(struct wined3d_string_buffer *buffer, unsigned int size)
+{
+    return buffer->buffer_size - buffer->content_size > size || string_buffer_resize(buffer, size);
+}
+
+static char *shader_format_uint(char *end, unsigned int value, unsigned int base)
+{
+    *--end = '\0';
+    do
+    {
+        *--end = "0123456789abcdef"[value % base];
+    } while (value /= base);
+
+    return end;
+}
+
+/* Nearly all generated shader code only uses plain %s, %u, %d, %x and %c
+ * conversions, so those are formatted here instead of going through
+ * vsnprintf() and retrying after growing the buffer. Returns 1 without
+ * reading any argument if the format needs vsnprintf(), -1 without changing
+ * the buffer if memory couldn't be allocated, and 0 on success. */
+static int shader_vaddline_simple(struct wined3d_string_buffer *buffer, const char *format, va_list args)
+{
+    unsigned int start = buffer->content_size, len;
+    const char *p, *str;
+    char num[12], *ptr;
+    int value;
+
+    for (p = format; *p; ++p)
+    {
+        if (*p == '%' && (!*++p || !strchr("sudxc%", *p)))
+            return 1;
+    }
+
+    p = format;
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            for (str = p; *p && *p != '%'; ++p);
+            len = p - str;
+        }
+        else
+        {
+            switch (*++p)
+            {
+                case 's':
+                    if (!(str = va_arg(args, const char *)))
+                        str = "(null)";
+                    break;
+
+                case 'u':
+                    str = shader_format_uint(&num[ARRAY_SIZE(num)], va_arg(args, unsigned int), 10);
+                    break;
+
+                case 'x':
+                    str = shader_format_uint(&num[ARRAY_SIZE(num)], va_arg(args, unsigned int), 16);
+                    break;
+
+                case 'd':
+                    value = va_arg(args, int);
+                    ptr = shader_format_uint(&num[ARRAY_SIZE(num)], value < 0 ? -(unsigned int)value : value, 10);
+                    if (value < 0)
+                        *--ptr = '-';
+                    str = ptr;
+                    break;
+
+                case 'c':
+                    num[0] = va_arg(args, int);
+                    num[1] = '\0';
+                    str = num;
+                    break;
+
+                default:
+                    str = "%";
+                    break;
+            }
+            len = strlen(str);
+            ++p;
+        }
+
+        if (!string_buffer_reserve(buffer, len))
+        {
+            buffer->content_size = start;
+            buffer->buffer[start] = '\0';
+            return -1;
+        }
+        memcpy(&buffer->buffer[buffer->content_size], str, len);
+        buffer->content_size += len;
+    }
+    buffer->buffer[buffer->content_size] = '\0';
+
+    return 0;
+}
+
 int shader_vaddline(struct wined3d_string_buffer *buffer, const char *format, va_list args)
 {
     unsigned int rem;
     int rc;
 
+    /* A format that needs vsnprintf() is rejected before any argument is
+     * read, so "args" can still be passed on. */
+    if ((rc = shader_vaddline_simple(buffer, format, args)) <= 0)
+        return rc;
+
     rem = buffer->buffer_size - buffer->content_size;
     rc = vsnprintf(&buffer->buffer[buffer->content_size], rem, format, args);
     if (rc < 0 /* C89 */ || (unsigned int)rc >= rem /* C99 */)
@@ -682,25 +782,207 @@ static unsigned int get_instr_extra_regcount(enum WINED3D_SHADER_INSTRUCTION_HAN
     }
 }
 
+/* The byte code is decoded once when the shader is created, and register
+ * usage analysis and every backend variant walk the decoded instructions
+ * instead of going through the frontend again. The instructions and the
+ * parameters they point to, including relative addressing parameters, are
+ * stored in a single allocation. */
+struct shader_ir_size
+{
+    unsigned int instruction_count;
+    unsigned int dst_count;
+    unsigned int src_count;
+};
+
+struct shader_ir_builder
+{
+    struct wined3d_shader_dst_param *dst;
+    struct wined3d_shader_src_param *src;
+};
+
+static void shader_ir_count_src_params(const struct wined3d_shader_src_param *src, unsigned int count,
+        struct shader_ir_size *size);
+
+static void shader_ir_count_register(const struct wined3d_shader_register *reg, struct shader_ir_size *size)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(reg->idx); ++i)
+    {
+        if (reg->idx[i].rel_addr)
+            shader_ir_count_src_params(reg->idx[i].rel_addr, 1, size);
+    }
+}
+
+static void shader_ir_count_src_params(const struct wined3d_shader_src_param *src, unsigned int count,
+        struct shader_ir_size *size)
+{
+    unsigned int i;
+
+    size->src_count += count;
+    for (i = 0; i < count; ++i)
+        shader_ir_count_register(&src[i].reg, size);
+}
+
+static void shader_ir_count_dst_params(const struct wined3d_shader_dst_param *dst, unsigned int count,
+        struct shader_ir_size *size)
+{
+    unsigned int i;
+
+    size->dst_count += count;
+    for (i = 0; i < count; ++i)
+        shader_ir_count_register(&dst[i].reg, size);
+}
+
+static const struct wined3d_shader_src_param *shader_ir_copy_src_params(struct shader_ir_builder *builder,
+        const struct wined3d_shader_src_param *src, unsigned int count);
+
+static void shader_ir_copy_register(struct shader_ir_builder *builder, struct wined3d_shader_register *reg)
+{
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(reg->idx); ++i)
+    {
+        if (reg->idx[i].rel_addr)
+            reg->idx[i].rel_addr = shader_ir_copy_src_params(builder, reg->idx[i].rel_addr, 1);
+    }
+}
+
+static const struct wined3d_shader_src_param *shader_ir_copy_src_params(struct shader_ir_builder *builder,
+        const struct wined3d_shader_src_param *src, unsigned int count)
+{
+    struct wined3d_shader_src_param *params = builder->src;
+    unsigned int i;
+
+    if (!count)
+        return NULL;
+
+    builder->src += count;
+    memcpy(params, src, count * sizeof(*params));
+    for (i = 0; i < count; ++i)
+        shader_ir_copy_register(builder, &params[i].reg);
+
+    return params;
+}
+
+static const struct wined3d_shader_dst_param *shader_ir_copy_dst_params(struct shader_ir_builder *builder,
+        const struct wined3d_shader_dst_param *dst, unsigned int count)
+{
+    struct wined3d_shader_dst_param *params = builder->dst;
+    unsigned int i;
+
+    if (!count)
+        return NULL;
+
+    builder->dst += count;
+    memcpy(params, dst, count * sizeof(*params));
+    for (i = 0; i < count; ++i)
+        shader_ir_copy_register(builder, &params[i].reg);
+
+    return params;
+}
+
+/* Returns the size of the byte code in bytes. */
+static UINT shader_ir_measure(const struct wined3d_shader_frontend *fe, void *fe_data,
+        const DWORD *byte_code, struct shader_ir_size *size)
+{
+    struct wined3d_shader_version shader_version;
+    struct wined3d_shader_instruction ins;
+    const DWORD *ptr = byte_code;
+
+    memset(size, 0, sizeof(*size));
+    fe->shader_read_header(fe_data, &ptr, &shader_version);
+    while (!fe->shader_is_end(fe_data, &ptr))
+    {
+        fe->shader_read_instruction(fe_data, &ptr, &ins);
+
+        /* Unhandled opcode, and its parameters. */
+        if (ins.handler_idx == WINED3DSIH_TABLE_SIZE)
+            continue;
+
+        ++size->instruction_count;
+        if (ins.predicate)
+            shader_ir_count_src_params(ins.predicate, 1, size);
+        shader_ir_count_dst_params(ins.dst, ins.dst_count, size);
+        shader_ir_count_src_params(ins.src, ins.src_count, size);
+        if (ins.handler_idx == WINED3DSIH_DCL)
+            shader_ir_count_register(&ins.declaration.semantic.reg.reg, size);
+        else if (ins.handler_idx == WINED3DSIH_DCL_CONSTANT_BUFFER)
+            shader_ir_count_register(&ins.declaration.src.reg, size);
+    }
+
+    return (const char *)ptr - (const char *)byte_code;
+}
+
+static struct wined3d_shader_ir *shader_ir_create(const struct wined3d_shader_frontend *fe, void *fe_data,
+        const DWORD *byte_code, const struct shader_ir_size *size)
+{
+    struct wined3d_shader_instruction *ins;
+    struct shader_ir_builder builder;
+    struct wined3d_shader_ir *ir;
+    const DWORD *ptr = byte_code;
+
+    if (!(ir = malloc(sizeof(*ir) + size->instruction_count * sizeof(*ir->instructions)
+            + size->dst_count * sizeof(*builder.dst) + size->src_count * sizeof(*builder.src))))
+        return NULL;
+
+    ir->refcount = 1;
+    ir->instruction_count = size->instruction_count;
+    ir->instructions = (struct wined3d_shader_instruction *)(ir + 1);
+    builder.dst = (struct wined3d_shader_dst_param *)(ir->instructions + size->instruction_count);
+    builder.src = (struct wined3d_shader_src_param *)(builder.dst + size->dst_count);
+
+    ins = ir->instructions;
+    fe->shader_read_header(fe_data, &ptr, &ir->shader_version);
+    while (!fe->shader_is_end(fe_data, &ptr))
+    {
+        fe->shader_read_instruction(fe_data, &ptr, ins);
+
+        if (ins->handler_idx == WINED3DSIH_TABLE_SIZE)
+        {
+            TRACE("Skipping unrecognized instruction.\n");
+            continue;
+        }
+
+        ins->ctx = NULL;
+        if (ins->predicate)
+            ins->predicate = shader_ir_copy_src_params(&builder, ins->predicate, 1);
+        ins->dst = shader_ir_copy_dst_params(&builder, ins->dst, ins->dst_count);
+        ins->src = shader_ir_copy_src_params(&builder, ins->src, ins->src_count);
+        if (ins->handler_idx == WINED3DSIH_DCL)
+            shader_ir_copy_register(&builder, &ins->declaration.semantic.reg.reg);
+        else if (ins->handler_idx == WINED3DSIH_DCL_CONSTANT_BUFFER)
+            shader_ir_copy_register(&builder, &ins->declaration.src.reg);
+        ++ins;
+    }
+
+    return ir;
+}
+
+static void shader_ir_release(struct wined3d_shader_ir *ir)
+{
+    if (ir && !InterlockedDecrement(&ir->refcount))
+        free(ir);
+}
+
 /* Note that this does not count the loop register as an address register. */
-static HRESULT shader_get_registers_used(struct wined3d_shader *shader, const struct wined3d_shader_frontend *fe,
-        struct wined3d_shader_reg_maps *reg_maps, struct wined3d_shader_signature *input_signature,
-        struct wined3d_shader_signature *output_signature, const DWORD *byte_code, DWORD constf_size)
+static HRESULT shader_get_registers_used(struct wined3d_shader *shader, struct wined3d_shader_reg_maps *reg_maps,
+        struct wined3d_shader_signature *input_signature, struct wined3d_shader_signature *output_signature,
+        DWORD constf_size)
 {
     struct wined3d_shader_signature_element input_signature_elements[max(MAX_ATTRIBS, MAX_REG_INPUT)];
     struct wined3d_shader_signature_element output_signature_elements[MAX_REG_OUTPUT];
     unsigned int cur_loop_depth = 0, max_loop_depth = 0;
-    void *fe_data = shader->frontend_data;
+    const struct wined3d_shader_ir *ir = shader->ir;
     struct wined3d_shader_version shader_version;
-    const DWORD *ptr = byte_code;
-    unsigned int i;
+    unsigned int i, ins_idx;
 
     memset(reg_maps, 0, sizeof(*reg_maps));
     memset(input_signature_elements, 0, sizeof(input_signature_elements));
     memset(output_signature_elements, 0, sizeof(output_signature_elements));
     reg_maps->min_rel_offset = ~0U;
 
-    fe->shader_read_header(fe_data, &ptr, &shader_version);
+    shader_version = ir->shader_version;
     reg_maps->shader_version = shader_version;
 
     shader_set_limits(shader);
@@ -713,19 +995,9 @@ static HRESULT shader_get_registers_used(struct wined3d_shader *shader, const st
         return E_OUTOFMEMORY;
     }
 
-    while (!fe->shader_is_end(fe_data, &ptr))
+    for (ins_idx = 0; ins_idx < ir->instruction_count; ++ins_idx)
     {
-        struct wined3d_shader_instruction ins;
-
-        /* Fetch opcode. */
-        fe->shader_read_instruction(fe_data, &ptr, &ins);
-
-        /* Unhandled opcode, and its parameters. */
-        if (ins.handler_idx == WINED3DSIH_TABLE_SIZE)
-        {
-            TRACE("Skipping unrecognized instruction.\n");
-            continue;
-        }
+        struct wined3d_shader_instruction ins = ir->instructions[ins_idx];
 
         /* Handle declarations. */
         if (ins.handler_idx == WINED3DSIH_DCL)
@@ -1100,8 +1372,6 @@ static HRESULT shader_get_registers_used(struct wined3d_shader *shader, const st
     if (shader_version.major < 2 && shader_version.type == WINED3D_SHADER_TYPE_PIXEL)
         reg_maps->rt_mask |= (1u << 0);
 
-    shader->functionLength = ((const char *)ptr - (const char *)byte_code);
-
     if (input_signature->elements)
     {
         for (i = 0; i < input_signature->element_count; ++i)
@@ -1616,17 +1886,15 @@ void shader_dump_src_param(const struct wined3d_shader_src_param *param,
 /* Shared code in order to generate the bulk of the shader string.
  * NOTE: A description of how to parse tokens can be found on MSDN. */
 void shader_generate_main(const struct wined3d_shader *shader, struct wined3d_string_buffer *buffer,
-        const struct wined3d_shader_reg_maps *reg_maps, const DWORD *byte_code, void *backend_ctx)
+        const struct wined3d_shader_reg_maps *reg_maps, void *backend_ctx)
 {
     struct wined3d_device *device = shader->device;
-    const struct wined3d_shader_frontend *fe = shader->frontend;
-    void *fe_data = shader->frontend_data;
-    struct wined3d_shader_version shader_version;
+    const struct wined3d_shader_ir *ir = shader->ir;
     struct wined3d_shader_loop_state loop_state;
     struct wined3d_shader_instruction ins;
     struct wined3d_shader_tex_mx tex_mx;
     struct wined3d_shader_context ctx;
-    const DWORD *ptr = byte_code;
+    unsigned int i;
 
     /* Initialize current parsing state. */
     tex_mx.current_row = 0;
@@ -1640,21 +1908,11 @@ void shader_generate_main(const struct wined3d_shader *shader, struct wined3d_st
     ctx.tex_mx = &tex_mx;
     ctx.loop_state = &loop_state;
     ctx.backend_data = backend_ctx;
-    ins.ctx = &ctx;
-
-    fe->shader_read_header(fe_data, &ptr, &shader_version);
 
-    while (!fe->shader_is_end(fe_data, &ptr))
+    for (i = 0; i < ir->instruction_count; ++i)
     {
-        /* Read opcode. */
-        fe->shader_read_instruction(fe_data, &ptr, &ins);
-
-        /* Unknown opcode and its parameters. */
-        if (ins.handler_idx == WINED3DSIH_TABLE_SIZE)
-        {
-            TRACE("Skipping unrecognized instruction.\n");
-            continue;
-        }
+        ins = ir->instructions[i];
+        ins.ctx = &ctx;
 
         if (ins.predicate)
             FIXME("Predicates not implemented.\n");
@@ -1881,10 +2139,12 @@ static void shader_cleanup(struct wined3d_shader *shader)
     free(shader->reg_maps.constf);
     free(shader->reg_maps.sampler_map.entries);
     free(shader->function);
+    shader_ir_release(shader->ir);
     shader_delete_constant_list(&shader->constantsF);
     shader_delete_constant_list(&shader->constantsB);
     shader_delete_constant_list(&shader->constantsI);
     list_remove(&shader->shader_list_entry);
+    list_remove(&shader->intern_entry);
 
     if (shader->frontend && shader->frontend_data)
         shader->frontend->shader_free(shader->frontend_data);
@@ -1906,6 +2166,7 @@ static void shader_none_update_float_pixel_constants(struct wined3d_device *devi
 static void shader_none_load_constants(void *shader_priv, struct wined3d_context *context,
         const struct wined3d_state *state) {}
 static void shader_none_destroy(struct wined3d_shader *shader) {}
+static void shader_none_share(struct wined3d_shader *shader, struct wined3d_shader *source) {}
 static void shader_none_free_context_data(struct wined3d_context *context) {}
 static void shader_none_init_context_state(struct wined3d_context *context) {}
 
@@ -2023,6 +2284,7 @@ const struct wined3d_shader_backend_ops none_shader_backend =
     shader_none_update_float_pixel_constants,
     shader_none_load_constants,
     shader_none_destroy,
+    shader_none_share,
     shader_none_alloc,
     shader_none_free,
     shader_none_allocate_context_data,
@@ -2033,12 +2295,187 @@ const struct wined3d_shader_backend_ops none_shader_backend =
     shader_none_has_ffp_proj_control,
 };
 
+#define WINED3D_SHADER_INTERN_INPUT_SIGNATURE   0x00000001
+#define WINED3D_SHADER_INTERN_OUTPUT_SIGNATURE  0x00000002
+
+/* Applications frequently create the same shader many times, e.g. once per
+ * material. Live shaders are kept in a per-device hash table keyed on the
+ * byte code and signatures, and a new shader that matches one of them copies
+ * its register maps instead of parsing the byte code again, and shares its
+ * GL shaders through the backend. */
+static DWORD shader_hash_signature(DWORD hash, const struct wined3d_shader_signature *signature)
+{
+    const struct wined3d_shader_signature_element *e;
+    unsigned int i;
+
+    for (i = 0; i < signature->element_count; ++i)
+    {
+        e = &signature->elements[i];
+        hash = wined3d_hash_fnv1a(hash, e->semantic_name, strlen(e->semantic_name) + 1);
+        hash = wined3d_hash_fnv1a(hash, &e->semantic_idx, sizeof(e->semantic_idx));
+        hash = wined3d_hash_fnv1a(hash, &e->sysval_semantic, sizeof(e->sysval_semantic));
+        hash = wined3d_hash_fnv1a(hash, &e->component_type, sizeof(e->component_type));
+        hash = wined3d_hash_fnv1a(hash, &e->register_idx, sizeof(e->register_idx));
+        hash = wined3d_hash_fnv1a(hash, &e->mask, sizeof(e->mask));
+    }
+
+    return hash;
+}
+
+static BOOL shader_signature_equal(const struct wined3d_shader_signature *s1,
+        const struct wined3d_shader_signature *s2)
+{
+    const struct wined3d_shader_signature_element *e1, *e2;
+    unsigned int i;
+
+    if (s1->element_count != s2->element_count)
+        return FALSE;
+
+    for (i = 0; i < s1->element_count; ++i)
+    {
+        e1 = &s1->elements[i];
+        e2 = &s2->elements[i];
+        if (e1->semantic_idx != e2->semantic_idx || e1->sysval_semantic != e2->sysval_semantic
+                || e1->component_type != e2->component_type || e1->register_idx != e2->register_idx
+                || e1->mask != e2->mask || strcmp(e1->semantic_name, e2->semantic_name))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The byte code, signatures, float constant count and maximum version have to
+ * be set. Signatures that were passed in are part of the key, ones generated
+ * from the byte code are not. */
+static struct wined3d_shader *shader_find_interned(struct wined3d_shader *shader,
+        const DWORD *byte_code, enum wined3d_shader_type type)
+{
+    struct wined3d_shader *source;
+    DWORD hash = WINED3D_HASH_SEED;
+    struct list *bucket;
+
+    shader->intern_flags = 0;
+    if (shader->input_signature.elements)
+    {
+        shader->intern_flags |= WINED3D_SHADER_INTERN_INPUT_SIGNATURE;
+        hash = shader_hash_signature(hash, &shader->input_signature);
+    }
+    if (shader->output_signature.elements)
+    {
+        shader->intern_flags |= WINED3D_SHADER_INTERN_OUTPUT_SIGNATURE;
+        hash = shader_hash_signature(hash, &shader->output_signature);
+    }
+    hash = wined3d_hash_fnv1a(hash, &type, sizeof(type));
+    hash = wined3d_hash_fnv1a(hash, &shader->intern_flags, sizeof(shader->intern_flags));
+    hash = wined3d_hash_fnv1a(hash, &shader->float_const_count, sizeof(shader->float_const_count));
+    hash = wined3d_hash_fnv1a(hash, &shader->max_version, sizeof(shader->max_version));
+    shader->intern_hash = wined3d_hash_fnv1a(hash, byte_code, shader->functionLength);
+
+    bucket = &shader->device->shader_intern[shader->intern_hash % WINED3D_SHADER_INTERN_BUCKETS];
+    LIST_FOR_EACH_ENTRY(source, bucket, struct wined3d_shader, intern_entry)
+    {
+        if (source->intern_hash != shader->intern_hash || source->reg_maps.shader_version.type != type
+                || source->intern_flags != shader->intern_flags
+                || source->float_const_count != shader->float_const_count
+                || source->max_version != shader->max_version
+                || source->functionLength != shader->functionLength
+                || memcmp(source->function, byte_code, shader->functionLength))
+            continue;
+
+        if ((shader->intern_flags & WINED3D_SHADER_INTERN_INPUT_SIGNATURE)
+                && !shader_signature_equal(&source->input_signature, &shader->input_signature))
+            continue;
+        if ((shader->intern_flags & WINED3D_SHADER_INTERN_OUTPUT_SIGNATURE)
+                && !shader_signature_equal(&source->output_signature, &shader->output_signature))
+            continue;
+
+        return source;
+    }
+
+    return NULL;
+}
+
+static HRESULT shader_copy_constant_list(struct list *dst, const struct list *src)
+{
+    const struct wined3d_shader_lconst *lconst;
+    struct wined3d_shader_lconst *copy;
+
+    LIST_FOR_EACH_ENTRY(lconst, src, struct wined3d_shader_lconst, entry)
+    {
+        if (!(copy = malloc(sizeof(*copy))))
+            return E_OUTOFMEMORY;
+        copy->idx = lconst->idx;
+        memcpy(copy->value, lconst->value, sizeof(copy->value));
+        list_add_tail(dst, &copy->entry);
+    }
+
+    return WINED3D_OK;
+}
+
+static HRESULT shader_copy_signature(struct wined3d_shader_signature *dst,
+        const struct wined3d_shader_signature *src)
+{
+    /* Generated signatures only reference static semantic names. */
+    if (!(dst->elements = malloc(sizeof(*dst->elements) * src->element_count)))
+        return E_OUTOFMEMORY;
+    memcpy(dst->elements, src->elements, sizeof(*dst->elements) * src->element_count);
+    dst->element_count = src->element_count;
+
+    return WINED3D_OK;
+}
+
+/* Everything shader_get_registers_used() would have derived from the byte code. */
+static HRESULT shader_copy_parse_info(struct wined3d_shader *shader, const struct wined3d_shader *source)
+{
+    struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
+    const struct wined3d_shader_sampler_map *sampler_map = &source->reg_maps.sampler_map;
+    SIZE_T size;
+    HRESULT hr;
+
+    shader->limits = source->limits;
+    shader->lconst_inf_or_nan = source->lconst_inf_or_nan;
+    shader->u = source->u;
+
+    *reg_maps = source->reg_maps;
+    reg_maps->constf = NULL;
+    memset(&reg_maps->sampler_map, 0, sizeof(reg_maps->sampler_map));
+
+    size = sizeof(*reg_maps->constf) * ((min(shader->limits->constant_float, shader->float_const_count) + 31) / 32);
+    if (!(reg_maps->constf = calloc(1, size)))
+        return E_OUTOFMEMORY;
+    memcpy(reg_maps->constf, source->reg_maps.constf, size);
+
+    if (sampler_map->count)
+    {
+        if (!(reg_maps->sampler_map.entries = malloc(sizeof(*sampler_map->entries) * sampler_map->count)))
+            return E_OUTOFMEMORY;
+        memcpy(reg_maps->sampler_map.entries, sampler_map->entries, sizeof(*sampler_map->entries) * sampler_map->count);
+        reg_maps->sampler_map.size = reg_maps->sampler_map.count = sampler_map->count;
+    }
+
+    if (FAILED(hr = shader_copy_constant_list(&shader->constantsF, &source->constantsF))
+            || FAILED(hr = shader_copy_constant_list(&shader->constantsI, &source->constantsI))
+            || FAILED(hr = shader_copy_constant_list(&shader->constantsB, &source->constantsB)))
+        return hr;
+
+    if (!(shader->intern_flags & WINED3D_SHADER_INTERN_INPUT_SIGNATURE) && source->input_signature.elements
+            && FAILED(hr = shader_copy_signature(&shader->input_signature, &source->input_signature)))
+        return hr;
+    if (!(shader->intern_flags & WINED3D_SHADER_INTERN_OUTPUT_SIGNATURE) && source->output_signature.elements
+            && FAILED(hr = shader_copy_signature(&shader->output_signature, &source->output_signature)))
+        return hr;
+
+    return WINED3D_OK;
+}
+
 static HRESULT shader_set_function(struct wined3d_shader *shader, const DWORD *byte_code,
         const struct wined3d_shader_signature *output_signature, DWORD float_const_count,
         enum wined3d_shader_type type, unsigned int max_version)
 {
     struct wined3d_shader_reg_maps *reg_maps = &shader->reg_maps;
     const struct wined3d_shader_frontend *fe;
+    struct wined3d_shader *source;
+    struct shader_ir_size ir_size;
     HRESULT hr;
     unsigned int backend_version;
     const struct wined3d_d3d_info *d3d_info = &shader->device->adapter->d3d_info;
@@ -2069,10 +2506,28 @@ static HRESULT shader_set_function(struct wined3d_shader *shader, const DWORD *b
     if (TRACE_ON(d3d_shader))
         shader_trace_init(fe, shader->frontend_data, byte_code);
 
-    /* Second pass: figure out which registers are used, what the semantics are, etc. */
-    if (FAILED(hr = shader_get_registers_used(shader, fe, reg_maps, &shader->input_signature,
-            &shader->output_signature, byte_code, float_const_count)))
-        return hr;
+    shader->float_const_count = float_const_count;
+    shader->max_version = max_version;
+    shader->functionLength = shader_ir_measure(fe, shader->frontend_data, byte_code, &ir_size);
+    if ((source = shader_find_interned(shader, byte_code, type)))
+    {
+        TRACE("Using instructions and register maps of identical shader %p.\n", source);
+        InterlockedIncrement(&source->ir->refcount);
+        shader->ir = source->ir;
+        if (FAILED(hr = shader_copy_parse_info(shader, source)))
+            return hr;
+    }
+    else
+    {
+        /* Second pass: decode the instructions. */
+        if (!(shader->ir = shader_ir_create(fe, shader->frontend_data, byte_code, &ir_size)))
+            return E_OUTOFMEMORY;
+
+        /* Third pass: figure out which registers are used, what the semantics are, etc. */
+        if (FAILED(hr = shader_get_registers_used(shader, reg_maps, &shader->input_signature,
+                &shader->output_signature, float_const_count)))
+            return hr;
+    }
 
     if (reg_maps->shader_version.type != type)
     {
@@ -2115,6 +2570,11 @@ static HRESULT shader_set_function(struct wined3d_shader *shader, const DWORD *b
         return E_OUTOFMEMORY;
     memcpy(shader->function, byte_code, shader->functionLength);
 
+    list_add_head(&shader->device->shader_intern[shader->intern_hash % WINED3D_SHADER_INTERN_BUCKETS],
+            &shader->intern_entry);
+    if (source)
+        shader->device->shader_backend->shader_share(shader, source);
+
     return WINED3D_OK;
 }
 
@@ -2306,9 +2766,11 @@ static HRESULT shader_init(struct wined3d_shader *shader, struct wined3d_device
         return WINED3DERR_INVALIDCALL;
 
     shader->ref = 1;
+    shader->id = wined3d_generate_object_id();
     shader->device = device;
     shader->parent = parent;
     shader->parent_ops = parent_ops;
+    list_init(&shader->intern_entry);
 
     total = 0;
     if (desc->input_signature)
@@ -2353,7 +2815,6 @@ static HRESULT shader_init(struct wined3d_shader *shader, struct wined3d_device
         return hr;
     }
 
-    list_init(&shader->linked_programs);
     list_add_head(&device->shaders, &shader->shader_list_entry);
 
     if (FAILED(hr = shader_set_function(shader, desc->byte_code, desc->output_signature,
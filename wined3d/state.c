@@ -3582,7 +3582,10 @@ static void sampler(struct wined3d_context *context, const struct wined3d_state
         {
             wined3d_texture_apply_sampler_desc(texture, &desc, gl_info);
         }
-        else
+        /* Most of the time the unit still has a sampler object with the
+         * same states bound, because only the texture changed. */
+        else if (!context->bound_samplers[mapped_stage]
+                || memcmp(&context->bound_samplers[mapped_stage]->desc, &desc, sizeof(desc)))
         {
             struct wined3d_device *device = context->swapchain->device;
             struct wined3d_sampler *sampler;
@@ -3607,10 +3610,7 @@ static void sampler(struct wined3d_context *context, const struct wined3d_state
             }
 
             if (sampler)
-            {
-                GL_EXTCALL(glBindSampler(mapped_stage, sampler->name));
-                checkGLcall("glBindSampler");
-            }
+                context_bind_sampler(context, mapped_stage, sampler);
         }
 
         if (texture->flags & WINED3D_TEXTURE_COND_NP2)
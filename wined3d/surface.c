@@ -549,6 +549,8 @@ static void surface_prepare_system_memory(struct wined3d_surface *surface)
 {
     TRACE("surface %p.\n", surface);
 
+    if (surface->resource.packed_memory)
+        wined3d_resource_unpack_sysmem(&surface->resource);
     if (surface->resource.heap_memory)
         return;
 
@@ -603,6 +605,41 @@ static void surface_evict_sysmem(struct wined3d_surface *surface)
     surface_invalidate_location(surface, WINED3D_LOCATION_SYSMEM);
 }
 
+/* Called for managed surfaces that haven't been mapped for a while. The
+ * system memory copy is dropped if the texture holds the same data, and
+ * otherwise compressed if "pack" is set. Returns the number of bytes that
+ * went through the compressor. */
+SIZE_T surface_trim_sysmem(struct wined3d_surface *surface, BOOL pack)
+{
+    struct wined3d_resource *resource = &surface->resource;
+
+    if (!resource->heap_memory || resource->map_count || resource->map_binding != WINED3D_LOCATION_SYSMEM
+            || surface->flags & SFLAG_CLIENT || surface->container->flags & WINED3D_TEXTURE_PIN_SYSMEM)
+        return 0;
+
+    if (!(surface->locations & WINED3D_LOCATION_SYSMEM))
+    {
+        TRACE("Freeing stale system memory of surface %p.\n", surface);
+        wined3d_resource_free_sysmem(resource);
+        return 0;
+    }
+
+    if (surface->locations & (WINED3D_LOCATION_TEXTURE_RGB | WINED3D_LOCATION_TEXTURE_SRGB)
+            && !(surface->container->flags & WINED3D_TEXTURE_CONVERTED))
+    {
+        TRACE("Evicting system memory of surface %p.\n", surface);
+        wined3d_resource_free_sysmem(resource);
+        surface_invalidate_location(surface, WINED3D_LOCATION_SYSMEM);
+        return 0;
+    }
+
+    if (!pack || resource->incompressible)
+        return 0;
+    wined3d_resource_pack_sysmem(resource);
+
+    return resource->size;
+}
+
 static void surface_release_client_storage(struct wined3d_surface *surface)
 {
     struct wined3d_context *context = context_acquire(surface->resource.device, NULL);
@@ -1304,6 +1341,21 @@ static const struct wined3d_surface_ops gdi_surface_ops =
     gdi_surface_unmap,
 };
 
+/* Keeps track of what the GDI presenter has to copy to the screen. */
+static void surface_add_gdi_damage(struct wined3d_surface *surface, const struct wined3d_box *box)
+{
+    RECT rect;
+
+    if (surface->surface_ops != &gdi_surface_ops)
+        return;
+
+    if (box)
+        SetRect(&rect, box->left, box->top, box->right, box->bottom);
+    else
+        SetRect(&rect, 0, 0, surface->resource.width, surface->resource.height);
+    UnionRect(&surface->gdi_damage, &surface->gdi_damage, &rect);
+}
+
 /* This call just downloads data, the caller is responsible for binding the
  * correct texture. */
 /* Context activation is done by the caller. */
@@ -2648,6 +2700,24 @@ static void convert_dxt3_a4r4g4b4(const BYTE *src, BYTE *dst,
     }
 }
 
+static void convert_dxt1_a8r8g8b8(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    convert_dxt1_b8g8r8a8_unorm(src, dst, pitch_in, 0, pitch_out, 0, w, h, 1);
+}
+
+static void convert_dxt3_a8r8g8b8(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    convert_dxt3_b8g8r8a8_unorm(src, dst, pitch_in, 0, pitch_out, 0, w, h, 1);
+}
+
+static void convert_dxt5_a8r8g8b8(const BYTE *src, BYTE *dst,
+        DWORD pitch_in, DWORD pitch_out, unsigned int w, unsigned int h)
+{
+    convert_dxt5_b8g8r8a8_unorm(src, dst, pitch_in, 0, pitch_out, 0, w, h, 1);
+}
+
 
 struct d3dfmt_converter_desc
 {
@@ -2666,6 +2736,11 @@ static const struct d3dfmt_converter_desc converters[] =
     {WINED3DFMT_DXT1,           WINED3DFMT_B4G4R4A4_UNORM,  convert_dxt1_a4r4g4b4},
     {WINED3DFMT_DXT1,           WINED3DFMT_B5G5R5X1_UNORM,  convert_dxt1_x1r5g5b5},
     {WINED3DFMT_DXT3,           WINED3DFMT_B4G4R4A4_UNORM,  convert_dxt3_a4r4g4b4},
+    {WINED3DFMT_DXT1,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt1_a8r8g8b8},
+    {WINED3DFMT_DXT2,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt3_a8r8g8b8},
+    {WINED3DFMT_DXT3,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt3_a8r8g8b8},
+    {WINED3DFMT_DXT4,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt5_a8r8g8b8},
+    {WINED3DFMT_DXT5,           WINED3DFMT_B8G8R8A8_UNORM,  convert_dxt5_a8r8g8b8},
 };
 
 static inline const struct d3dfmt_converter_desc *find_converter(enum wined3d_format_id from,
@@ -2835,6 +2910,7 @@ HRESULT CDECL wined3d_surface_map(struct wined3d_surface *surface,
         WARN("Surface is already mapped.\n");
         return WINED3DERR_INVALIDCALL;
     }
+    wined3d_resource_mark_mapped(&surface->resource, flags);
 
     if ((fmt_flags & WINED3DFMT_FLAG_BLOCKS) && box
             && !surface_check_block_align(surface, box))
@@ -2891,7 +2967,15 @@ HRESULT CDECL wined3d_surface_map(struct wined3d_surface *surface,
     }
 
     if (!(flags & (WINED3D_MAP_NO_DIRTY_UPDATE | WINED3D_MAP_READONLY)))
-        surface_invalidate_location(surface, ~surface->resource.map_binding);
+    {
+        if (box && !(flags & WINED3D_MAP_DISCARD))
+            surface_invalidate_location_box(surface, ~surface->resource.map_binding, box);
+        else
+            surface_invalidate_location(surface, ~surface->resource.map_binding);
+    }
+
+    if (!(flags & WINED3D_MAP_READONLY))
+        surface_add_gdi_damage(surface, box);
 
     switch (surface->resource.map_binding)
     {
@@ -3008,6 +3092,7 @@ HRESULT CDECL wined3d_surface_getdc(struct wined3d_surface *surface, HDC *dc)
 
     surface_load_location(surface, context, WINED3D_LOCATION_DIB);
     surface_invalidate_location(surface, ~WINED3D_LOCATION_DIB);
+    surface_add_gdi_damage(surface, NULL);
 
     if (context)
         context_release(context);
@@ -4137,6 +4222,8 @@ void surface_validate_location(struct wined3d_surface *surface, DWORD location)
     TRACE("surface %p, location %s.\n", surface, wined3d_debug_location(location));
 
     surface->locations |= location;
+    if (!(surface->partial_locations &= ~location))
+        surface->dirty_rect_count = 0;
 }
 
 void surface_invalidate_location(struct wined3d_surface *surface, DWORD location)
@@ -4157,11 +4244,107 @@ void surface_invalidate_location(struct wined3d_surface *surface, DWORD location
 				}
 		}
     surface->locations &= ~location;
+    if (!(surface->partial_locations &= ~location))
+        surface->dirty_rect_count = 0;
+
+    /* A packed copy is never brought up to date, only thrown away. */
+    if (location & WINED3D_LOCATION_SYSMEM && surface->resource.packed_memory)
+        wined3d_resource_free_sysmem(&surface->resource);
 
     if (!surface->locations)
         ERR("Surface %p does not have any up to date location.\n", surface);
 }
 
+static BOOL surface_add_dirty_rect(struct wined3d_surface *surface, const struct wined3d_box *box)
+{
+    const struct wined3d_format *format = surface->resource.format;
+    unsigned int i, best = 0;
+    LONG area, best_area;
+    RECT rect, *r;
+
+    /* Uploads of block based formats have to start at a block boundary. */
+    SetRect(&rect, box->left - box->left % format->block_width, box->top - box->top % format->block_height,
+            min(box->right, surface->resource.width), min(box->bottom, surface->resource.height));
+    if (IsRectEmpty(&rect))
+        return TRUE;
+
+    /* Fold every rectangle touching the new one into it. */
+    for (i = 0; i < surface->dirty_rect_count;)
+    {
+        r = &surface->dirty_rects[i];
+        if (r->left > rect.right || rect.left > r->right || r->top > rect.bottom || rect.top > r->bottom)
+        {
+            ++i;
+            continue;
+        }
+
+        SetRect(&rect, min(r->left, rect.left), min(r->top, rect.top),
+                max(r->right, rect.right), max(r->bottom, rect.bottom));
+        surface->dirty_rects[i] = surface->dirty_rects[--surface->dirty_rect_count];
+        i = 0;
+    }
+
+    if (surface->dirty_rect_count == WINED3D_SURFACE_MAX_DIRTY_RECTS)
+    {
+        /* Merge with the rectangle whose bounding box grows the least. */
+        best_area = LONG_MAX;
+        for (i = 0; i < surface->dirty_rect_count; ++i)
+        {
+            r = &surface->dirty_rects[i];
+            area = (max(r->right, rect.right) - min(r->left, rect.left))
+                    * (max(r->bottom, rect.bottom) - min(r->top, rect.top))
+                    - (r->right - r->left) * (r->bottom - r->top);
+            if (area < best_area)
+            {
+                best_area = area;
+                best = i;
+            }
+        }
+
+        r = &surface->dirty_rects[best];
+        SetRect(&rect, min(r->left, rect.left), min(r->top, rect.top),
+                max(r->right, rect.right), max(r->bottom, rect.bottom));
+        surface->dirty_rects[best] = surface->dirty_rects[--surface->dirty_rect_count];
+    }
+    surface->dirty_rects[surface->dirty_rect_count++] = rect;
+
+    /* Once most of the surface is dirty a single full upload is cheaper. */
+    for (i = 0, area = 0; i < surface->dirty_rect_count; ++i)
+    {
+        r = &surface->dirty_rects[i];
+        area += (r->right - r->left) * (r->bottom - r->top);
+    }
+
+    return area * 4 < (LONG)(surface->resource.width * surface->resource.height) * 3;
+}
+
+/* Like surface_invalidate_location(), but currently valid texture locations
+ * only become out of date inside "box". surface_load_texture() then uploads
+ * just the dirty rectangles instead of the whole level. The map binding is
+ * expected to hold the current contents of the complete surface. */
+void surface_invalidate_location_box(struct wined3d_surface *surface, DWORD location,
+        const struct wined3d_box *box)
+{
+    DWORD partial = (surface->locations | surface->partial_locations) & location
+            & (WINED3D_LOCATION_TEXTURE_RGB | WINED3D_LOCATION_TEXTURE_SRGB);
+    unsigned int rect_count = surface->partial_locations ? surface->dirty_rect_count : 0;
+
+    surface_invalidate_location(surface, location);
+
+    if (!partial || surface->flags & SFLAG_CLIENT
+            || surface->container->resource.format_flags & (WINED3DFMT_FLAG_HEIGHT_SCALE | WINED3DFMT_FLAG_BROKEN_PITCH))
+        return;
+
+    surface->dirty_rect_count = rect_count;
+    if (!surface_add_dirty_rect(surface, box))
+    {
+        TRACE("Surface %p is mostly dirty, uploading it completely.\n", surface);
+        surface->dirty_rect_count = 0;
+        return;
+    }
+    surface->partial_locations |= partial;
+}
+
 static DWORD resource_access_from_location(DWORD location)
 {
     switch (location)
@@ -4374,6 +4557,29 @@ static HRESULT surface_load_texture(struct wined3d_surface *surface,
         return WINED3DERR_INVALIDCALL;
     }
 
+    if (surface->partial_locations & (srgb ? WINED3D_LOCATION_TEXTURE_SRGB : WINED3D_LOCATION_TEXTURE_RGB)
+            && texture->flags & (srgb ? WINED3D_TEXTURE_SRGB_ALLOCATED : WINED3D_TEXTURE_RGB_ALLOCATED)
+            && !(texture->flags & WINED3D_TEXTURE_CONVERTED) && !texture->resource.format->convert && !wined3d_format_get_color_key_conversion(texture, TRUE))
+    {
+        unsigned int i;
+
+        TRACE("Uploading %u dirty rectangles of surface %p.\n", surface->dirty_rect_count, surface);
+
+        wined3d_texture_bind_and_dirtify(texture, context, srgb);
+        src_pitch = wined3d_surface_get_pitch(surface);
+        surface_get_memory(surface, &data, surface->locations);
+
+        for (i = 0; i < surface->dirty_rect_count; ++i)
+        {
+            dst_point.x = surface->dirty_rects[i].left;
+            dst_point.y = surface->dirty_rects[i].top;
+            wined3d_surface_upload_data(surface, gl_info, texture->resource.format, &surface->dirty_rects[i],
+                    src_pitch, &dst_point, srgb, wined3d_const_bo_address(&data));
+        }
+
+        return WINED3D_OK;
+    }
+
     wined3d_texture_prepare_texture(texture, context, srgb);
     wined3d_texture_bind_and_dirtify(texture, context, srgb);
 
@@ -4408,6 +4614,8 @@ static HRESULT surface_load_texture(struct wined3d_surface *surface,
         UINT height = surface->resource.height;
 
         format.byte_count = format.conv_byte_count;
+        /* Block based formats are decoded to plain pixels (DXT without S3TC). */
+        format.flags[WINED3D_GL_RES_TYPE_TEX_2D] &= ~WINED3DFMT_FLAG_BLOCKS;
         dst_pitch = wined3d_format_calculate_pitch(&format, width);
 
         if (!(mem = malloc( dst_pitch * height)))
@@ -4465,6 +4673,95 @@ static void surface_multisample_resolve(struct wined3d_surface *surface, struct
             surface, WINED3D_LOCATION_RB_MULTISAMPLE, &rect, surface, WINED3D_LOCATION_RB_RESOLVED, &rect);
 }
 
+/* Formats wined3d_format_convert_from_float() handles, and so formats a
+ * deferred clear can be done for with _Blt_ColorFill(). */
+static BOOL surface_cpu_fill_supported(const struct wined3d_format *format)
+{
+    switch (format->id)
+    {
+        case WINED3DFMT_B8G8R8A8_UNORM:
+        case WINED3DFMT_B8G8R8X8_UNORM:
+        case WINED3DFMT_B8G8R8_UNORM:
+        case WINED3DFMT_B5G6R5_UNORM:
+        case WINED3DFMT_B5G5R5A1_UNORM:
+        case WINED3DFMT_B5G5R5X1_UNORM:
+        case WINED3DFMT_R8_UNORM:
+        case WINED3DFMT_A8_UNORM:
+        case WINED3DFMT_B4G4R4A4_UNORM:
+        case WINED3DFMT_B4G4R4X4_UNORM:
+        case WINED3DFMT_B2G3R3_UNORM:
+        case WINED3DFMT_R8G8B8A8_UNORM:
+        case WINED3DFMT_R8G8B8X8_UNORM:
+        case WINED3DFMT_B10G10R10A2_UNORM:
+        case WINED3DFMT_R10G10B10A2_UNORM:
+        case WINED3DFMT_P8_UINT:
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+/* Whether a full colour clear of the surface can be left in
+ * WINED3D_LOCATION_CLEARED. The format has to be one we can fill on the CPU,
+ * so that the clear can still be done without a context. */
+BOOL surface_can_defer_clear(const struct wined3d_surface *surface)
+{
+    return wined3d_settings.offscreen_rendering_mode == ORM_FBO
+            && surface->resource.pool == WINED3D_POOL_DEFAULT
+            && surface->container->resource.draw_binding != WINED3D_LOCATION_DRAWABLE
+            && !surface->resource.map_count
+            && surface_cpu_fill_supported(surface->resource.format);
+}
+
+/* Context activation is done by the caller. Context may be NULL in ddraw-only mode.
+ * Does the clear that WINED3D_LOCATION_CLEARED stands for. Client memory is
+ * filled directly. Anything else gets the GL clear in the draw binding, or
+ * if that isn't possible a system memory fill the location can be loaded
+ * from. */
+static void surface_load_cleared(struct wined3d_surface *surface, struct wined3d_context *context, DWORD location)
+{
+    static const DWORD cpu_locations = WINED3D_LOCATION_SYSMEM
+            | WINED3D_LOCATION_USER_MEMORY | WINED3D_LOCATION_DIB;
+    struct wined3d_device *device = surface->resource.device;
+    struct wined3d_bo_address data;
+
+    TRACE("surface %p, context %p, location %s.\n", surface, context, wined3d_debug_location(location));
+
+    if (!(location & cpu_locations) && context)
+    {
+        struct wined3d_surface *restore_rt = context->current_rt;
+
+        device_resolve_clear(device, surface);
+        if (restore_rt && context->current_rt != restore_rt)
+            context_release(context_acquire(device, restore_rt));
+
+        if (!(surface->locations & WINED3D_LOCATION_CLEARED))
+            return;
+        WARN("GL clear of surface %p failed, filling system memory.\n", surface);
+    }
+
+    if (!(location & cpu_locations))
+        location = WINED3D_LOCATION_SYSMEM;
+    if (location == WINED3D_LOCATION_SYSMEM)
+        surface_prepare_system_memory(surface);
+
+    surface_get_memory(surface, &data, location);
+    if (!data.addr)
+    {
+        ERR("Surface %p has no memory for location %s.\n", surface, wined3d_debug_location(location));
+        return;
+    }
+
+    TRACE("Filling %s of surface %p.\n", wined3d_debug_location(location), surface);
+    _Blt_ColorFill(data.addr, surface->resource.width, surface->resource.height,
+            surface->resource.format->byte_count, wined3d_surface_get_pitch(surface),
+            wined3d_format_convert_from_float(surface, &surface->clear_color));
+
+    surface_validate_location(surface, location);
+    surface_invalidate_location(surface, WINED3D_LOCATION_CLEARED);
+}
+
 /* Context activation is done by the caller. Context may be NULL in ddraw-only mode. */
 HRESULT surface_load_location(struct wined3d_surface *surface, struct wined3d_context *context, DWORD location)
 {
@@ -4500,6 +4797,9 @@ HRESULT surface_load_location(struct wined3d_surface *surface, struct wined3d_co
         }
     }
 
+    if (surface->resource.packed_memory && !wined3d_resource_unpack_sysmem(&surface->resource))
+        return E_OUTOFMEMORY;
+
     if (surface->locations & location)
     {
         TRACE("Location already up to date.\n");
@@ -4517,6 +4817,13 @@ HRESULT surface_load_location(struct wined3d_surface *surface, struct wined3d_co
         }
     //}
 
+    if (surface->locations & WINED3D_LOCATION_CLEARED)
+    {
+        surface_load_cleared(surface, context, location);
+        if (surface->locations & location)
+            return WINED3D_OK;
+    }
+
     if (!surface->locations)
     {
         ERR("Surface %p does not have any up to date location.\n", surface);
@@ -5540,6 +5847,30 @@ HRESULT CDECL wined3d_surface_blt(struct wined3d_surface *dst_surface, const REC
         flags &= ~WINEDDBLT_DONOTWAIT;
     }
 
+    /* ddraw shows flips by blitting the whole new primary to the front
+     * buffer. With GDI surfaces, only copy where it differs from the screen. */
+    if (!flags && src_surface && src_surface != dst_surface
+            && dst_surface->surface_ops == &gdi_surface_ops
+            && (dst_swapchain = dst_surface->container->swapchain)
+            && dst_surface->container == dst_swapchain->front_buffer
+            && !src_rect.left && !src_rect.top && EqualRect(&src_rect, &dst_rect)
+            && src_rect.right == src_surface->resource.width && src_rect.bottom == src_surface->resource.height
+            && dst_rect.right == dst_surface->resource.width && dst_rect.bottom == dst_surface->resource.height)
+    {
+        HRESULT hr = WINED3D_OK;
+
+        swapchain_gdi_get_damage(dst_swapchain, src_surface, &dst_rect);
+        TRACE("Damaged area %s.\n", wine_dbgstr_rect(&dst_rect));
+        if (!IsRectEmpty(&dst_rect))
+        {
+            src_rect = dst_rect;
+            hr = surface_cpu_blt(dst_surface, &dst_rect, src_surface, &src_rect, flags, fx, filter);
+        }
+        if (SUCCEEDED(hr))
+            swapchain_gdi_set_shown(dst_swapchain, src_surface);
+        return hr;
+    }
+
     if (!device->d3d_initialized)
     {
         WARN("D3D not initialized, using fallback.\n");
@@ -24,9 +24,25 @@
 #include "wine/port.h"
 #include "wined3d_private.h"
 
+#if defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WINED3D_GDI_SSE2
+#include <emmintrin.h>
+#endif
+
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 WINE_DECLARE_DEBUG_CHANNEL(fps);
 
+static void swapchain_gdi_destroy_staging(struct wined3d_swapchain *swapchain)
+{
+    if (swapchain->gdi_staging_dc)
+        DeleteDC(swapchain->gdi_staging_dc);
+    if (swapchain->gdi_staging_bitmap)
+        DeleteObject(swapchain->gdi_staging_bitmap);
+    swapchain->gdi_staging_dc = NULL;
+    swapchain->gdi_staging_bitmap = NULL;
+    swapchain->gdi_staging_bits = NULL;
+}
+
 static void swapchain_cleanup(struct wined3d_swapchain *swapchain)
 {
     HRESULT hr;
@@ -34,6 +50,12 @@ static void swapchain_cleanup(struct wined3d_swapchain *swapchain)
 
     TRACE("Destroying swapchain %p.\n", swapchain);
 
+    for (i = 0; i < WINED3D_MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        if (swapchain->frame_fences[i])
+            wined3d_event_query_destroy(swapchain->frame_fences[i]);
+    }
+
     wined3d_swapchain_set_gamma_ramp(swapchain, 0, &swapchain->orig_gamma);
 
     /* Release the swapchain's draw buffers. Make sure swapchain->back_buffers[0]
@@ -86,6 +108,8 @@ static void swapchain_cleanup(struct wined3d_swapchain *swapchain)
         wined3d_release_dc(swapchain->backup_wnd, swapchain->backup_dc);
         DestroyWindow(swapchain->backup_wnd);
     }
+
+    swapchain_gdi_destroy_staging(swapchain);
 }
 
 ULONG CDECL wined3d_swapchain_incref(struct wined3d_swapchain *swapchain)
@@ -425,6 +449,133 @@ static void swapchain_blit(const struct wined3d_swapchain *swapchain,
     }
 }
 
+static LONGLONG swapchain_get_time(void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter(&counter);
+
+    return counter.QuadPart;
+}
+
+/* Waits until the next frame is due according to the MaxFPS setting. Most
+ * of the wait is done with Sleep(), and the last part, where Sleep() has
+ * been seen to overshoot, is spun away. */
+static void swapchain_limit_frame_rate(struct wined3d_swapchain *swapchain)
+{
+    LONGLONG now, period, remaining, start, overshoot;
+    DWORD ms;
+
+    if (!wined3d_settings.max_fps || !swapchain->qpc_frequency)
+        return;
+
+    period = swapchain->qpc_frequency / wined3d_settings.max_fps;
+    now = swapchain_get_time();
+
+    /* Don't try to catch up after a slow frame, just start over. */
+    if (now - swapchain->next_present > period)
+        swapchain->next_present = now;
+
+    while ((remaining = swapchain->next_present - now) > 0)
+    {
+        if (remaining > swapchain->sleep_slack
+                && (ms = (remaining - swapchain->sleep_slack) * 1000 / swapchain->qpc_frequency))
+        {
+            start = now;
+            Sleep(ms);
+            now = swapchain_get_time();
+
+            overshoot = now - start - ms * swapchain->qpc_frequency / 1000;
+            if (overshoot > swapchain->sleep_slack)
+                swapchain->sleep_slack = overshoot;
+            else
+                swapchain->sleep_slack -= swapchain->sleep_slack / 16;
+        }
+        else
+        {
+            Sleep(0);
+            now = swapchain_get_time();
+        }
+    }
+
+    swapchain->next_present += period;
+}
+
+/* Waits for the frame presented MaxFramesInFlight presents ago to complete. */
+static void swapchain_limit_frames_in_flight(struct wined3d_swapchain *swapchain,
+        const struct wined3d_gl_info *gl_info)
+{
+    unsigned int max_frames = wined3d_settings.max_frames_in_flight;
+    struct wined3d_event_query **fence;
+
+    if (!max_frames)
+        return;
+
+    if (!wined3d_event_query_supported(gl_info))
+    {
+        static unsigned int once;
+
+        if (!once++)
+            WARN("Fences are not supported, not limiting queued frames.\n");
+        return;
+    }
+
+    fence = &swapchain->frame_fences[swapchain->frame_fence_idx];
+    swapchain->frame_fence_idx = (swapchain->frame_fence_idx + 1) % max_frames;
+
+    if (!*fence && !(*fence = calloc(1, sizeof(**fence))))
+    {
+        ERR("Failed to allocate frame fence.\n");
+        return;
+    }
+
+    if ((*fence)->context && wined3d_event_query_finish(*fence, swapchain->device) != WINED3D_EVENT_QUERY_OK)
+        WARN("Failed to wait for frame fence %p.\n", *fence);
+    wined3d_event_query_issue(*fence, swapchain->device);
+}
+
+static void swapchain_update_frame_stats(struct wined3d_swapchain *swapchain)
+{
+    const struct wined3d_device *device = swapchain->device;
+    LONGLONG now = swapchain_get_time(), frame_time;
+    DWORD time = GetTickCount();
+
+    ++swapchain->frames;
+
+    if (swapchain->last_present && swapchain->qpc_frequency)
+    {
+        frame_time = now - swapchain->last_present;
+        if (!swapchain->frame_time_min || frame_time < swapchain->frame_time_min)
+            swapchain->frame_time_min = frame_time;
+        if (frame_time > swapchain->frame_time_max)
+            swapchain->frame_time_max = frame_time;
+        swapchain->frame_time_sum += frame_time;
+    }
+    swapchain->last_present = now;
+
+    /* every 1.5 seconds */
+    if (time - swapchain->prev_time > 1500)
+    {
+        if (swapchain->qpc_frequency)
+            TRACE_(fps)("%p @ approx %.2ffps, frame time min %.2fms avg %.2fms max %.2fms\n",
+                    swapchain, 1000.0 * swapchain->frames / (time - swapchain->prev_time),
+                    1000.0 * swapchain->frame_time_min / swapchain->qpc_frequency,
+                    1000.0 * swapchain->frame_time_sum / swapchain->frames / swapchain->qpc_frequency,
+                    1000.0 * swapchain->frame_time_max / swapchain->qpc_frequency);
+        else
+            TRACE_(fps)("%p @ approx %.2ffps\n",
+                    swapchain, 1000.0 * swapchain->frames / (time - swapchain->prev_time));
+        TRACE_(fps)("%p: %u context switches, %u reactivations\n", swapchain,
+                device->context_switches - swapchain->prev_context_switches,
+                device->context_reactivations - swapchain->prev_context_reactivations);
+        swapchain->prev_context_switches = device->context_switches;
+        swapchain->prev_context_reactivations = device->context_reactivations;
+        swapchain->prev_time = time;
+        swapchain->frames = 0;
+        swapchain->frame_time_min = swapchain->frame_time_max = swapchain->frame_time_sum = 0;
+    }
+}
+
 static void swapchain_gl_present(struct wined3d_swapchain *swapchain, const RECT *src_rect_in,
         const RECT *dst_rect_in, const RGNDATA *dirty_region, DWORD flags)
 {
@@ -437,7 +588,13 @@ static void swapchain_gl_present(struct wined3d_swapchain *swapchain, const RECT
     RECT src_rect, dst_rect;
     BOOL render_to_fbo;
 
-    context = context_acquire(swapchain->device, back_buffer);
+    /* In single context mode the back buffer can be rendered by any context,
+     * the front buffer selects the one that draws to the window. */
+    if (wined3d_settings.single_context && swapchain->render_to_fbo)
+        context = context_acquire(swapchain->device,
+                surface_from_resource(wined3d_texture_get_sub_resource(swapchain->front_buffer, 0)));
+    else
+        context = context_acquire(swapchain->device, back_buffer);
     if (!context->valid)
     {
         context_release(context);
@@ -546,25 +703,21 @@ static void swapchain_gl_present(struct wined3d_swapchain *swapchain, const RECT
     if (swapchain->num_contexts > 1)
         gl_info->gl_ops.gl.p_glFinish();
 
+    swapchain_limit_frame_rate(swapchain);
+
     /* call wglSwapBuffers through the gl table to avoid confusing the Steam overlay */
     gl_info->gl_ops.wgl.p_wglSwapBuffers(context->hdc); /* TODO: cycle through the swapchain buffers */
 
     TRACE("SwapBuffers called, Starting new frame\n");
+
+    swapchain_limit_frames_in_flight(swapchain, gl_info);
+
+    ++swapchain->device->query_batch;
+    wined3d_query_poll_pending(swapchain->device, context);
+
     /* FPS support */
     if (TRACE_ON(fps))
-    {
-        DWORD time = GetTickCount();
-        ++swapchain->frames;
-
-        /* every 1.5 seconds */
-        if (time - swapchain->prev_time > 1500)
-        {
-            TRACE_(fps)("%p @ approx %.2ffps\n",
-                    swapchain, 1000.0 * swapchain->frames / (time - swapchain->prev_time));
-            swapchain->prev_time = time;
-            swapchain->frames = 0;
-        }
-    }
+        swapchain_update_frame_stats(swapchain);
 
     front = surface_from_resource(wined3d_texture_get_sub_resource(swapchain->front_buffer, 0));
 
@@ -603,21 +756,172 @@ static const struct wined3d_swapchain_ops swapchain_gl_ops =
     swapchain_gl_present,
 };
 
+static BOOL swapchain_gdi_prepare_staging(struct wined3d_swapchain *swapchain,
+        unsigned int width, unsigned int height)
+{
+    BITMAPINFO info;
+
+    if (swapchain->gdi_staging_dc && swapchain->gdi_staging_width == width
+            && swapchain->gdi_staging_height == height)
+        return TRUE;
+
+    swapchain_gdi_destroy_staging(swapchain);
+
+    memset(&info, 0, sizeof(info));
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = 0 - height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    if (!(swapchain->gdi_staging_dc = CreateCompatibleDC(NULL)))
+        return FALSE;
+    if (!(swapchain->gdi_staging_bitmap = CreateDIBSection(swapchain->gdi_staging_dc, &info,
+            DIB_RGB_COLORS, &swapchain->gdi_staging_bits, NULL, 0)))
+    {
+        WARN("Failed to create a %ux%u staging DIB section.\n", width, height);
+        swapchain_gdi_destroy_staging(swapchain);
+        return FALSE;
+    }
+    SelectObject(swapchain->gdi_staging_dc, swapchain->gdi_staging_bitmap);
+    swapchain->gdi_staging_width = width;
+    swapchain->gdi_staging_height = height;
+
+    return TRUE;
+}
+
+static void swapchain_gdi_expand_p8(DWORD *dst, const BYTE *src, unsigned int count, const DWORD *lut)
+{
+    while (count--)
+        *dst++ = lut[*src++];
+}
+
+/* Expands x5y5z5 / x5y6z5 pixels to x8y8z8, replicating the top bits into
+ * the low ones the way the DXT decoder does. */
+static void swapchain_gdi_expand_16(DWORD *dst, const WORD *src, unsigned int count, unsigned int g_bits)
+{
+    unsigned int r_shift = 5 + g_bits, g_mask = (1u << g_bits) - 1;
+    unsigned int g_left = 8 - g_bits, g_right = 2 * g_bits - 8;
+    DWORD r, g, b;
+
+#ifdef WINED3D_GDI_SSE2
+    const __m128i mask5 = _mm_set1_epi16(0x1f), mask_g = _mm_set1_epi16(g_mask);
+    const __m128i shift_r = _mm_cvtsi32_si128(r_shift);
+    const __m128i shift_gl = _mm_cvtsi32_si128(g_left), shift_gr = _mm_cvtsi32_si128(g_right);
+    __m128i p, vr, vg, vb;
+
+    for (; count >= 8; count -= 8, src += 8, dst += 8)
+    {
+        p = _mm_loadu_si128((const __m128i *)src);
+        vr = _mm_and_si128(_mm_srl_epi16(p, shift_r), mask5);
+        vg = _mm_and_si128(_mm_srli_epi16(p, 5), mask_g);
+        vb = _mm_and_si128(p, mask5);
+        vr = _mm_or_si128(_mm_slli_epi16(vr, 3), _mm_srli_epi16(vr, 2));
+        vg = _mm_or_si128(_mm_sll_epi16(vg, shift_gl), _mm_srl_epi16(vg, shift_gr));
+        vb = _mm_or_si128(_mm_slli_epi16(vb, 3), _mm_srli_epi16(vb, 2));
+        /* 16 bit g8b8 and 00r8 halves, interleaved into 00r8g8b8. */
+        vb = _mm_or_si128(vb, _mm_slli_epi16(vg, 8));
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(vb, vr));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(vb, vr));
+    }
+#endif
+
+    while (count--)
+    {
+        r = *src >> r_shift & 0x1f;
+        g = *src >> 5 & g_mask;
+        b = *src++ & 0x1f;
+        *dst++ = (r << 3 | r >> 2) << 16 | (g << g_left | g >> g_right) << 8 | (b << 3 | b >> 2);
+    }
+}
+
+/* GDI converts 8 and 16 bpp DIBs to a 32 bpp screen one pixel at a time.
+ * Do that here instead, into a staging DIB that matches the screen. Returns
+ * the DC to copy "rect" from. */
+static HDC swapchain_gdi_expand(struct wined3d_swapchain *swapchain, struct wined3d_surface *front,
+        HDC dst_dc, const RECT *rect)
+{
+    const struct wined3d_format *format = front->resource.format;
+    unsigned int width = rect->right - rect->left;
+    unsigned int y, src_pitch, g_bits = 0;
+    const BYTE *src;
+    DWORD lut[256];
+    DWORD *dst;
+
+    switch (format->id)
+    {
+        case WINED3DFMT_P8_UINT:
+            if (!swapchain->palette)
+                return front->hDC;
+            for (y = 0; y < 256; ++y)
+                lut[y] = swapchain->gdi_colors[y].rgbRed << 16
+                        | swapchain->gdi_colors[y].rgbGreen << 8
+                        | swapchain->gdi_colors[y].rgbBlue;
+            break;
+
+        case WINED3DFMT_B5G6R5_UNORM:
+            g_bits = 6;
+            break;
+
+        case WINED3DFMT_B5G5R5X1_UNORM:
+        case WINED3DFMT_B5G5R5A1_UNORM:
+            g_bits = 5;
+            break;
+
+        default:
+            return front->hDC;
+    }
+
+    if (GetDeviceCaps(dst_dc, BITSPIXEL) != 32
+            || !swapchain_gdi_prepare_staging(swapchain, front->resource.width, front->resource.height))
+        return front->hDC;
+
+    /* Drawing through the surface DC may still be batched. */
+    GdiFlush();
+
+    src_pitch = wined3d_surface_get_pitch(front);
+    src = (const BYTE *)front->dib.bitmap_data + rect->top * src_pitch + rect->left * format->byte_count;
+    dst = (DWORD *)swapchain->gdi_staging_bits + rect->top * swapchain->gdi_staging_width + rect->left;
+    for (y = rect->top; y < rect->bottom; ++y)
+    {
+        if (g_bits)
+            swapchain_gdi_expand_16(dst, (const WORD *)src, width, g_bits);
+        else
+            swapchain_gdi_expand_p8(dst, src, width, lut);
+        src += src_pitch;
+        dst += swapchain->gdi_staging_width;
+    }
+
+    return swapchain->gdi_staging_dc;
+}
+
 /* Helper function that blits the front buffer contents to the target window. */
-void x11_copy_to_screen(const struct wined3d_swapchain *swapchain, const RECT *rect)
+void x11_copy_to_screen(struct wined3d_swapchain *swapchain, const RECT *rect)
 {
     struct wined3d_surface *front;
     POINT offset = {0, 0};
     HDC src_dc, dst_dc;
     RECT draw_rect;
+    unsigned int id;
     HWND window;
 
     TRACE("swapchain %p, rect %s.\n", swapchain, wine_dbgstr_rect(rect));
 
     front = surface_from_resource(wined3d_texture_get_sub_resource(swapchain->front_buffer, 0));
     if (swapchain->palette)
+    {
         wined3d_palette_apply_to_dc(swapchain->palette, front->hDC);
 
+        /* Every P8 pixel on screen changes along with the palette. */
+        if (front->resource.format->id == WINED3DFMT_P8_UINT
+                && memcmp(swapchain->gdi_colors, swapchain->palette->colors, sizeof(swapchain->gdi_colors)))
+        {
+            memcpy(swapchain->gdi_colors, swapchain->palette->colors, sizeof(swapchain->gdi_colors));
+            swapchain->gdi_refresh = TRUE;
+        }
+    }
+
     if (front->resource.map_count)
         ERR("Trying to blit a mapped surface.\n");
 
@@ -625,7 +929,6 @@ void x11_copy_to_screen(const struct wined3d_swapchain *swapchain, const RECT *r
 
     surface_load_location(front, NULL, WINED3D_LOCATION_DIB);
 
-    src_dc = front->hDC;
     window = swapchain->win_handle;
     dst_dc = GetDCEx(window, 0, DCX_CLIPSIBLINGS | DCX_CACHE);
 
@@ -643,24 +946,81 @@ void x11_copy_to_screen(const struct wined3d_swapchain *swapchain, const RECT *r
 
     TRACE("offset %s.\n", wine_dbgstr_point(&offset));
 
+    if (offset.x != swapchain->gdi_offset.x || offset.y != swapchain->gdi_offset.y)
+    {
+        swapchain->gdi_offset = offset;
+        swapchain->gdi_refresh = TRUE;
+    }
+
     draw_rect.left = 0;
     draw_rect.right = front->resource.width;
     draw_rect.top = 0;
     draw_rect.bottom = front->resource.height;
 
-    if (rect)
+    if (rect && !swapchain->gdi_refresh)
         IntersectRect(&draw_rect, &draw_rect, rect);
 
-    BitBlt(dst_dc, draw_rect.left - offset.x, draw_rect.top - offset.y,
-            draw_rect.right - draw_rect.left, draw_rect.bottom - draw_rect.top,
-            src_dc, draw_rect.left, draw_rect.top, SRCCOPY);
+    if (!IsRectEmpty(&draw_rect))
+    {
+        src_dc = swapchain_gdi_expand(swapchain, front, dst_dc, &draw_rect);
+
+        BitBlt(dst_dc, draw_rect.left - offset.x, draw_rect.top - offset.y,
+                draw_rect.right - draw_rect.left, draw_rect.bottom - draw_rect.top,
+                src_dc, draw_rect.left, draw_rect.top, SRCCOPY);
+
+        id = ++swapchain->gdi_copy_count;
+        swapchain->gdi_copies[id % WINED3D_GDI_COPY_HISTORY] = draw_rect;
+        if (swapchain->gdi_refresh)
+        {
+            swapchain->gdi_copy_valid = id;
+            swapchain->gdi_refresh = FALSE;
+        }
+    }
     ReleaseDC(window, dst_dc);
 }
 
+/* Returns the area in which "surface" may differ from what is on screen: what
+ * was written to it, plus what was copied to the screen since it was shown.
+ * Screen invalidation is only noticed through the WM_PAINT hook, which only
+ * sees the focus window, so any other window always gets a full copy. */
+void swapchain_gdi_get_damage(const struct wined3d_swapchain *swapchain,
+        const struct wined3d_surface *surface, RECT *rect)
+{
+    unsigned int id;
+
+    if (swapchain->gdi_refresh || swapchain->win_handle != swapchain->device->focus_window
+            || !surface->gdi_copy_id
+            || surface->gdi_copy_id < swapchain->gdi_copy_valid
+            || surface->gdi_copy_id > swapchain->gdi_copy_count
+            || swapchain->gdi_copy_count - surface->gdi_copy_id > WINED3D_GDI_COPY_HISTORY)
+    {
+        SetRect(rect, 0, 0, surface->resource.width, surface->resource.height);
+        return;
+    }
+
+    *rect = surface->gdi_damage;
+    for (id = surface->gdi_copy_id + 1; id <= swapchain->gdi_copy_count; ++id)
+        UnionRect(rect, rect, &swapchain->gdi_copies[id % WINED3D_GDI_COPY_HISTORY]);
+}
+
+/* The screen contents were changed behind our back, copy everything next time. */
+void swapchain_gdi_invalidate(struct wined3d_swapchain *swapchain)
+{
+    swapchain->gdi_refresh = TRUE;
+}
+
+/* "surface" was just copied to the screen. */
+void swapchain_gdi_set_shown(const struct wined3d_swapchain *swapchain, struct wined3d_surface *surface)
+{
+    surface->gdi_copy_id = swapchain->gdi_copy_count;
+    SetRectEmpty(&surface->gdi_damage);
+}
+
 static void swapchain_gdi_present(struct wined3d_swapchain *swapchain, const RECT *src_rect_in,
         const RECT *dst_rect_in, const RGNDATA *dirty_region, DWORD flags)
 {
     struct wined3d_surface *front, *back;
+    RECT rect;
 
     front = surface_from_resource(wined3d_texture_get_sub_resource(swapchain->front_buffer, 0));
     back = surface_from_resource(wined3d_texture_get_sub_resource(swapchain->back_buffers[0], 0));
@@ -696,24 +1056,29 @@ static void swapchain_gdi_present(struct wined3d_swapchain *swapchain, const REC
             ERR("GDI Surface %p has heap memory allocated.\n", back);
     }
 
-    /* FPS support */
-    if (TRACE_ON(fps))
+    /* The damage describes the surface data, so it goes along. */
     {
-        static LONG prev_time, frames;
-        DWORD time = GetTickCount();
+        unsigned int tmp_id;
+        RECT tmp;
+
+        tmp = front->gdi_damage;
+        front->gdi_damage = back->gdi_damage;
+        back->gdi_damage = tmp;
+        tmp_id = front->gdi_copy_id;
+        front->gdi_copy_id = back->gdi_copy_id;
+        back->gdi_copy_id = tmp_id;
+    }
 
-        ++frames;
+    swapchain_limit_frame_rate(swapchain);
 
-        /* every 1.5 seconds */
-        if (time - prev_time > 1500)
-        {
-            TRACE_(fps)("@ approx %.2ffps\n", 1000.0 * frames / (time - prev_time));
-            prev_time = time;
-            frames = 0;
-        }
-    }
+    /* FPS support */
+    if (TRACE_ON(fps))
+        swapchain_update_frame_stats(swapchain);
 
-    x11_copy_to_screen(swapchain, NULL);
+    swapchain_gdi_get_damage(swapchain, front, &rect);
+    TRACE("Damaged area %s.\n", wine_dbgstr_rect(&rect));
+    x11_copy_to_screen(swapchain, &rect);
+    swapchain_gdi_set_shown(swapchain, front);
 }
 
 static const struct wined3d_swapchain_ops swapchain_gdi_ops =
@@ -745,7 +1110,8 @@ static void swapchain_update_render_to_fbo(struct wined3d_swapchain *swapchain)
             swapchain->desc.multisample_type,
             swapchain->desc.multisample_quality);
 
-    if (!wined3d_settings.always_offscreen && !swapchain->desc.multisample_type
+    if (!wined3d_settings.always_offscreen && !wined3d_settings.single_context
+            && !swapchain->desc.multisample_type
             && swapchain->desc.backbuffer_width == client_rect.right
             && swapchain->desc.backbuffer_height == client_rect.bottom)
     {
@@ -765,6 +1131,7 @@ static HRESULT swapchain_init(struct wined3d_swapchain *swapchain, struct wined3
     struct wined3d_resource_desc texture_desc;
     struct wined3d_surface *front_buffer;
     BOOL displaymode_set = FALSE;
+    LARGE_INTEGER frequency;
     RECT client_rect;
     HWND window;
     HRESULT hr;
@@ -789,6 +1156,14 @@ static HRESULT swapchain_init(struct wined3d_swapchain *swapchain, struct wined3
     swapchain->ref = 1;
     swapchain->win_handle = window;
     swapchain->device_window = window;
+    swapchain->gdi_refresh = TRUE;
+
+    if (QueryPerformanceFrequency(&frequency))
+    {
+        swapchain->qpc_frequency = frequency.QuadPart;
+        /* Sleep() is assumed to overshoot by up to 2ms until measured otherwise. */
+        swapchain->sleep_slack = frequency.QuadPart / 500;
+    }
 
     if (FAILED(hr = wined3d_get_adapter_display_mode(device->wined3d,
             adapter->ordinal, &swapchain->original_mode, NULL)))
@@ -0,0 +1,291 @@
+/*
+ * Allocator for the system memory copies of resources
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d);
+
+/* Games create and destroy lots of small textures (fonts, sprites,
+ * lightmaps), and giving each of them its own heap block fragments the
+ * Win9x heap over a long session. Small allocations are instead carved out
+ * of 64 KiB slabs, one set of slabs per size class. VirtualAlloc() hands out
+ * memory at the 64 KiB allocation granularity, so the slab an object belongs
+ * to is found by masking its address, and since the slab header and all
+ * class sizes are multiples of RESOURCE_ALIGNMENT, so is every object.
+ *
+ * Large allocations get their own VirtualAlloc() region, which is page
+ * aligned and given back to the system as a whole when freed. Anything in
+ * between still comes from the heap.
+ *
+ * All memory is returned zeroed, like calloc() does. */
+
+#define WINED3D_SYSMEM_SLAB_SIZE    0x10000
+#define WINED3D_SYSMEM_SLAB_HEADER  ((sizeof(struct wined3d_sysmem_slab) + 63) & ~63)
+#define WINED3D_SYSMEM_LARGE_SIZE   0x10000
+
+struct wined3d_sysmem_slab
+{
+    struct list entry;
+    struct wined3d_sysmem_class *class;
+    void *free;
+    unsigned int used;
+    /* Objects past this offset have never been handed out. */
+    unsigned int unused;
+};
+
+struct wined3d_sysmem_class
+{
+    unsigned int size;
+    unsigned int capacity;
+    /* Slabs with at least one free object. */
+    struct list partial;
+    unsigned int slab_count;
+    unsigned int empty_count;
+    unsigned int used, peak;
+};
+
+static const unsigned int sysmem_class_sizes[] =
+{
+    64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536,
+    2048, 3072, 4096, 6144, 8192, 12288, 16384,
+};
+
+#define WINED3D_SYSMEM_CLASS_COUNT (sizeof(sysmem_class_sizes) / sizeof(*sysmem_class_sizes))
+
+static struct
+{
+    CRITICAL_SECTION cs;
+    BOOL initialized;
+    struct wined3d_sysmem_class classes[WINED3D_SYSMEM_CLASS_COUNT];
+    unsigned int large_count;
+    SIZE_T large_size;
+} sysmem;
+
+static struct wined3d_sysmem_class *sysmem_get_class(SIZE_T size)
+{
+    unsigned int i;
+
+    if (!sysmem.initialized)
+        return NULL;
+
+    for (i = 0; i < WINED3D_SYSMEM_CLASS_COUNT; ++i)
+    {
+        if (size <= sysmem.classes[i].size)
+            return &sysmem.classes[i];
+    }
+
+    return NULL;
+}
+
+static void *sysmem_slab_alloc(struct wined3d_sysmem_class *class)
+{
+    struct wined3d_sysmem_slab *slab;
+    void *mem;
+
+    if (list_empty(&class->partial))
+    {
+        if (!(slab = VirtualAlloc(NULL, WINED3D_SYSMEM_SLAB_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)))
+            return NULL;
+        if ((ULONG_PTR)slab & (WINED3D_SYSMEM_SLAB_SIZE - 1))
+        {
+            ERR("Slab %p is not aligned to the allocation granularity.\n", slab);
+            VirtualFree(slab, 0, MEM_RELEASE);
+            return NULL;
+        }
+
+        slab->class = class;
+        slab->free = NULL;
+        slab->used = 0;
+        slab->unused = WINED3D_SYSMEM_SLAB_HEADER;
+        list_add_head(&class->partial, &slab->entry);
+        ++class->slab_count;
+        ++class->empty_count;
+        TRACE("Created slab %p for %u byte objects.\n", slab, class->size);
+    }
+    slab = LIST_ENTRY(list_head(&class->partial), struct wined3d_sysmem_slab, entry);
+
+    if ((mem = slab->free))
+    {
+        slab->free = *(void **)mem;
+        memset(mem, 0, class->size);
+    }
+    else
+    {
+        /* Fresh memory from VirtualAlloc() is already zeroed. */
+        mem = (BYTE *)slab + slab->unused;
+        slab->unused += class->size;
+    }
+
+    if (!slab->used++)
+        --class->empty_count;
+    if (slab->used == class->capacity)
+        list_remove(&slab->entry);
+    if (++class->used > class->peak)
+        class->peak = class->used;
+
+    return mem;
+}
+
+static void sysmem_slab_free(struct wined3d_sysmem_class *class, void *mem)
+{
+    struct wined3d_sysmem_slab *slab = (void *)((ULONG_PTR)mem & ~(ULONG_PTR)(WINED3D_SYSMEM_SLAB_SIZE - 1));
+
+    if (slab->class != class)
+    {
+        ERR("Freeing %p with the wrong size, slab class %u, expected %u.\n",
+                mem, slab->class->size, class->size);
+        class = slab->class;
+    }
+
+    if (slab->used-- == class->capacity)
+        list_add_head(&class->partial, &slab->entry);
+    *(void **)mem = slab->free;
+    slab->free = mem;
+    --class->used;
+
+    if (slab->used)
+        return;
+
+    /* Keep one empty slab around, so that a texture being created and
+     * destroyed every frame doesn't map and unmap memory every time. */
+    if (class->empty_count)
+    {
+        list_remove(&slab->entry);
+        --class->slab_count;
+        VirtualFree(slab, 0, MEM_RELEASE);
+        return;
+    }
+    ++class->empty_count;
+}
+
+/* Returns zeroed memory aligned to RESOURCE_ALIGNMENT, to be freed with
+ * wined3d_sysmem_free() using the same size. */
+void *wined3d_sysmem_alloc(SIZE_T size)
+{
+    struct wined3d_sysmem_class *class;
+    SIZE_T align;
+    void **p, *mem;
+
+    if ((class = sysmem_get_class(size)))
+    {
+        EnterCriticalSection(&sysmem.cs);
+        mem = sysmem_slab_alloc(class);
+        LeaveCriticalSection(&sysmem.cs);
+        return mem;
+    }
+
+    if (size >= WINED3D_SYSMEM_LARGE_SIZE && sysmem.initialized)
+    {
+        if (!(mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)))
+            return NULL;
+        EnterCriticalSection(&sysmem.cs);
+        ++sysmem.large_count;
+        sysmem.large_size += size;
+        LeaveCriticalSection(&sysmem.cs);
+        return mem;
+    }
+
+    align = RESOURCE_ALIGNMENT - 1 + sizeof(*p);
+    if (!(mem = calloc(1, size + align)))
+        return NULL;
+
+    p = (void **)(((ULONG_PTR)mem + align) & ~(RESOURCE_ALIGNMENT - 1)) - 1;
+    *p = mem;
+
+    return ++p;
+}
+
+void wined3d_sysmem_free(void *mem, SIZE_T size)
+{
+    struct wined3d_sysmem_class *class;
+    void **p = mem;
+
+    if (!mem)
+        return;
+
+    if ((class = sysmem_get_class(size)))
+    {
+        EnterCriticalSection(&sysmem.cs);
+        sysmem_slab_free(class, mem);
+        LeaveCriticalSection(&sysmem.cs);
+        return;
+    }
+
+    if (size >= WINED3D_SYSMEM_LARGE_SIZE && sysmem.initialized)
+    {
+        VirtualFree(mem, 0, MEM_RELEASE);
+        EnterCriticalSection(&sysmem.cs);
+        --sysmem.large_count;
+        sysmem.large_size -= size;
+        LeaveCriticalSection(&sysmem.cs);
+        return;
+    }
+
+    free(*(--p));
+}
+
+void wined3d_sysmem_init(void)
+{
+    unsigned int i;
+
+    InitializeCriticalSection(&sysmem.cs);
+    for (i = 0; i < WINED3D_SYSMEM_CLASS_COUNT; ++i)
+    {
+        struct wined3d_sysmem_class *class = &sysmem.classes[i];
+
+        class->size = sysmem_class_sizes[i];
+        class->capacity = (WINED3D_SYSMEM_SLAB_SIZE - WINED3D_SYSMEM_SLAB_HEADER) / class->size;
+        list_init(&class->partial);
+    }
+    sysmem.initialized = TRUE;
+}
+
+void wined3d_sysmem_cleanup(void)
+{
+    struct wined3d_sysmem_slab *slab, *cursor;
+    unsigned int i;
+
+    if (!sysmem.initialized)
+        return;
+
+    for (i = 0; i < WINED3D_SYSMEM_CLASS_COUNT; ++i)
+    {
+        struct wined3d_sysmem_class *class = &sysmem.classes[i];
+
+        if (class->peak)
+            TRACE("Class %u: %u slabs, %u of %u objects in use, peak %u.\n", class->size,
+                    class->slab_count, class->used, class->slab_count * class->capacity, class->peak);
+
+        /* Full slabs aren't on any list. Objects still in use at this point
+         * are leaked, and so are their slabs. */
+        LIST_FOR_EACH_ENTRY_SAFE(slab, cursor, &class->partial, struct wined3d_sysmem_slab, entry)
+        {
+            if (slab->used)
+                continue;
+            list_remove(&slab->entry);
+            VirtualFree(slab, 0, MEM_RELEASE);
+        }
+    }
+    TRACE("%u large allocations, %lu bytes in use.\n", sysmem.large_count, (unsigned long)sysmem.large_size);
+
+    DeleteCriticalSection(&sysmem.cs);
+    sysmem.initialized = FALSE;
+}
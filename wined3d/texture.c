@@ -793,7 +793,10 @@ static void texture2d_sub_resource_add_dirty_region(struct wined3d_resource *sub
     context = context_acquire(surface->resource.device, NULL);
     surface_load_location(surface, context, surface->resource.map_binding);
     context_release(context);
-    surface_invalidate_location(surface, ~surface->resource.map_binding);
+    if (dirty_region)
+        surface_invalidate_location_box(surface, ~surface->resource.map_binding, dirty_region);
+    else
+        surface_invalidate_location(surface, ~surface->resource.map_binding);
 }
 
 static void texture2d_sub_resource_cleanup(struct wined3d_resource *sub_resource)
@@ -1511,6 +1514,7 @@ HRESULT CDECL wined3d_texture_create(struct wined3d_device *device, const struct
         const struct wined3d_parent_ops *parent_ops, struct wined3d_texture **texture)
 {
     struct wined3d_texture *object;
+    unsigned int i;
     HRESULT hr;
 
     TRACE("device %p, desc %p, level_count %u, surface_flags %#x, data %p, parent %p, parent_ops %p, texture %p.\n",
@@ -1561,6 +1565,12 @@ HRESULT CDECL wined3d_texture_create(struct wined3d_device *device, const struct
         return hr;
     }
 
+    EnterCriticalSection(&device->resources_cs);
+    device_resource_add(device, &object->resource);
+    for (i = 0; i < object->level_count * object->layer_count; ++i)
+        device_resource_add(device, object->sub_resources[i]);
+    LeaveCriticalSection(&device->resources_cs);
+
     TRACE("Created texture %p.\n", object);
     *texture = object;
 
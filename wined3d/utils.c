@@ -926,6 +926,28 @@ static const struct wined3d_format_texture_info format_texture_info[] =
             GL_ALPHA,                   GL_UNSIGNED_BYTE,                 0,
             WINED3DFMT_FLAG_FILTERING,
             WINED3D_GL_EXT_NONE,        NULL},
+    /* Without S3TC the DXT formats are decoded on the CPU. The compressed
+     * entries below override these when the extension is available. */
+    {WINED3DFMT_DXT1,                   GL_RGBA8,                         GL_RGBA8,                               0,
+            GL_BGRA,                    GL_UNSIGNED_INT_8_8_8_8_REV,      4,
+            WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING,
+            WINED3D_GL_EXT_NONE,        convert_dxt1_b8g8r8a8_unorm},
+    {WINED3DFMT_DXT2,                   GL_RGBA8,                         GL_RGBA8,                               0,
+            GL_BGRA,                    GL_UNSIGNED_INT_8_8_8_8_REV,      4,
+            WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING,
+            WINED3D_GL_EXT_NONE,        convert_dxt3_b8g8r8a8_unorm},
+    {WINED3DFMT_DXT3,                   GL_RGBA8,                         GL_RGBA8,                               0,
+            GL_BGRA,                    GL_UNSIGNED_INT_8_8_8_8_REV,      4,
+            WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING,
+            WINED3D_GL_EXT_NONE,        convert_dxt3_b8g8r8a8_unorm},
+    {WINED3DFMT_DXT4,                   GL_RGBA8,                         GL_RGBA8,                               0,
+            GL_BGRA,                    GL_UNSIGNED_INT_8_8_8_8_REV,      4,
+            WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING,
+            WINED3D_GL_EXT_NONE,        convert_dxt5_b8g8r8a8_unorm},
+    {WINED3DFMT_DXT5,                   GL_RGBA8,                         GL_RGBA8,                               0,
+            GL_BGRA,                    GL_UNSIGNED_INT_8_8_8_8_REV,      4,
+            WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING,
+            WINED3D_GL_EXT_NONE,        convert_dxt5_b8g8r8a8_unorm},
     {WINED3DFMT_DXT1,                   GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0,
             GL_RGBA,                    GL_UNSIGNED_BYTE,                 0,
             WINED3DFMT_FLAG_TEXTURE | WINED3DFMT_FLAG_POSTPIXELSHADER_BLENDING | WINED3DFMT_FLAG_FILTERING
@@ -2704,6 +2726,8 @@ BOOL initPixelFormatsNoGL(struct wined3d_gl_info *gl_info)
 BOOL wined3d_adapter_init_format_info(struct wined3d_adapter *adapter, struct wined3d_caps_gl_ctx *ctx)
 {
     struct wined3d_gl_info *gl_info = &adapter->gl_info;
+    unsigned int format_count = sizeof(formats) / sizeof(*formats);
+    DWORD format_hash;
 
     if (!init_format_base_info(gl_info)) return FALSE;
 
@@ -2712,8 +2736,22 @@ BOOL wined3d_adapter_init_format_info(struct wined3d_adapter *adapter, struct wi
     if (!init_format_vertex_info(gl_info)) goto fail;
 
     apply_format_fixups(adapter, gl_info);
-    init_format_fbo_compat_info(ctx);
-    init_format_filter_info(gl_info, adapter->driver_info.vendor);
+
+    if (!wined3d_caps_cache_load(adapter, format_count))
+    {
+        format_hash = wined3d_caps_cache_hash_formats(gl_info, format_count);
+
+        init_format_fbo_compat_info(ctx);
+        init_format_filter_info(gl_info, adapter->driver_info.vendor);
+
+#ifndef VBOX_WITH_WINE_FIX_POLYOFFSET_SCALE
+        gl_info->fixed_polyoffset_scale = wined3d_adapter_find_polyoffset_scale(ctx, GL_DEPTH_COMPONENT);
+        if (gl_info->supported[ARB_DEPTH_BUFFER_FLOAT])
+            gl_info->float_polyoffset_scale = wined3d_adapter_find_polyoffset_scale(ctx, GL_DEPTH32F_STENCIL8);
+#endif
+
+        wined3d_caps_cache_store(adapter, format_count, format_hash);
+    }
 
     return TRUE;
 
@@ -4289,8 +4327,8 @@ unsigned int wined3d_max_compat_varyings(const struct wined3d_gl_info *gl_info)
     return gl_info->supported[WINED3D_GL_LEGACY_CONTEXT] ? MAX_TEXTURES * 4 : (MAX_TEXTURES + 2) * 4 + 1;
 }
 
-void gen_ffp_frag_op(const struct wined3d_context *context, const struct wined3d_state *state,
-        struct ffp_frag_settings *settings, BOOL ignore_textype)
+static void gen_ffp_frag_stage_op(const struct wined3d_state *state, unsigned int stage,
+        BOOL ignore_textype, struct texture_stage_op *op)
 {
 #define ARG1 0x01
 #define ARG2 0x02
@@ -4325,183 +4363,269 @@ void gen_ffp_frag_op(const struct wined3d_context *context, const struct wined3d
         /* D3DTOP_MULTIPLYADD               */  ARG1 | ARG2 | ARG0,
         /* D3DTOP_LERP                      */  ARG1 | ARG2 | ARG0
     };
-    unsigned int i;
-    DWORD ttff;
     DWORD cop, aop, carg0, carg1, carg2, aarg0, aarg1, aarg2;
-    if(state->fb->render_targets[0] == NULL)
-    {
-    	return;
-    }
-    
-    unsigned int rt_fmt_flags = state->fb->render_targets[0]->format_flags;
-    const struct wined3d_gl_info *gl_info = context->gl_info;
-    const struct wined3d_d3d_info *d3d_info = context->d3d_info;
-
-    settings->padding = 0;
+    const struct wined3d_texture *texture;
+    DWORD ttff;
 
-#ifdef VBOX_WITH_WINE_FIX_INITCLEAR
-    memset(settings, 0, sizeof(*settings));
-#endif
+    op->padding = 0;
+    if (state->texture_states[stage][WINED3D_TSS_COLOR_OP] == WINED3D_TOP_DISABLE)
+    {
+        op->cop = WINED3D_TOP_DISABLE;
+        op->aop = WINED3D_TOP_DISABLE;
+        op->carg0 = op->carg1 = op->carg2 = ARG_UNUSED;
+        op->aarg0 = op->aarg1 = op->aarg2 = ARG_UNUSED;
+        op->color_fixup = COLOR_FIXUP_IDENTITY;
+        op->dst = resultreg;
+        op->tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
+        op->projected = proj_none;
+        return;
+    }
 
-    for (i = 0; i < d3d_info->limits.ffp_blend_stages; ++i)
+    if ((texture = state->textures[stage]))
     {
-        const struct wined3d_texture *texture;
-
-        settings->op[i].padding = 0;
-        if (state->texture_states[i][WINED3D_TSS_COLOR_OP] == WINED3D_TOP_DISABLE)
+        op->color_fixup = texture->resource.format->color_fixup;
+        if (ignore_textype)
         {
-            settings->op[i].cop = WINED3D_TOP_DISABLE;
-            settings->op[i].aop = WINED3D_TOP_DISABLE;
-            settings->op[i].carg0 = settings->op[i].carg1 = settings->op[i].carg2 = ARG_UNUSED;
-            settings->op[i].aarg0 = settings->op[i].aarg1 = settings->op[i].aarg2 = ARG_UNUSED;
-            settings->op[i].color_fixup = COLOR_FIXUP_IDENTITY;
-            settings->op[i].dst = resultreg;
-            settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
-            settings->op[i].projected = proj_none;
-            i++;
-            break;
+            op->tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
         }
-
-        if ((texture = state->textures[i]))
+        else
         {
-            settings->op[i].color_fixup = texture->resource.format->color_fixup;
-            if (ignore_textype)
-            {
-                settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
-            }
-            else
+            switch (texture->target)
             {
-                switch (texture->target)
-                {
-                    case GL_TEXTURE_1D:
-                        settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
-                        break;
-                    case GL_TEXTURE_2D:
-                        settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_2D;
-                        break;
-                    case GL_TEXTURE_3D:
-                        settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_3D;
-                        break;
-                    case GL_TEXTURE_CUBE_MAP_ARB:
-                        settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_CUBE;
-                        break;
-                    case GL_TEXTURE_RECTANGLE_ARB:
-                        settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_RECT;
-                        break;
-                }
+                case GL_TEXTURE_1D:
+                    op->tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
+                    break;
+                case GL_TEXTURE_2D:
+                    op->tex_type = WINED3D_GL_RES_TYPE_TEX_2D;
+                    break;
+                case GL_TEXTURE_3D:
+                    op->tex_type = WINED3D_GL_RES_TYPE_TEX_3D;
+                    break;
+                case GL_TEXTURE_CUBE_MAP_ARB:
+                    op->tex_type = WINED3D_GL_RES_TYPE_TEX_CUBE;
+                    break;
+                case GL_TEXTURE_RECTANGLE_ARB:
+                    op->tex_type = WINED3D_GL_RES_TYPE_TEX_RECT;
+                    break;
             }
-        } else {
-            settings->op[i].color_fixup = COLOR_FIXUP_IDENTITY;
-            settings->op[i].tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
         }
+    } else {
+        op->color_fixup = COLOR_FIXUP_IDENTITY;
+        op->tex_type = WINED3D_GL_RES_TYPE_TEX_1D;
+    }
 
-        cop = state->texture_states[i][WINED3D_TSS_COLOR_OP];
-        aop = state->texture_states[i][WINED3D_TSS_ALPHA_OP];
+    cop = state->texture_states[stage][WINED3D_TSS_COLOR_OP];
+    aop = state->texture_states[stage][WINED3D_TSS_ALPHA_OP];
 
-        carg1 = (args[cop] & ARG1) ? state->texture_states[i][WINED3D_TSS_COLOR_ARG1] : ARG_UNUSED;
-        carg2 = (args[cop] & ARG2) ? state->texture_states[i][WINED3D_TSS_COLOR_ARG2] : ARG_UNUSED;
-        carg0 = (args[cop] & ARG0) ? state->texture_states[i][WINED3D_TSS_COLOR_ARG0] : ARG_UNUSED;
+    carg1 = (args[cop] & ARG1) ? state->texture_states[stage][WINED3D_TSS_COLOR_ARG1] : ARG_UNUSED;
+    carg2 = (args[cop] & ARG2) ? state->texture_states[stage][WINED3D_TSS_COLOR_ARG2] : ARG_UNUSED;
+    carg0 = (args[cop] & ARG0) ? state->texture_states[stage][WINED3D_TSS_COLOR_ARG0] : ARG_UNUSED;
 
-        if (is_invalid_op(state, i, cop, carg1, carg2, carg0))
-        {
-            carg0 = ARG_UNUSED;
-            carg2 = ARG_UNUSED;
-            carg1 = WINED3DTA_CURRENT;
-            cop = WINED3D_TOP_SELECT_ARG1;
-        }
+    if (is_invalid_op(state, stage, cop, carg1, carg2, carg0))
+    {
+        carg0 = ARG_UNUSED;
+        carg2 = ARG_UNUSED;
+        carg1 = WINED3DTA_CURRENT;
+        cop = WINED3D_TOP_SELECT_ARG1;
+    }
 
-        if (cop == WINED3D_TOP_DOTPRODUCT3)
-        {
-            /* A dotproduct3 on the colorop overwrites the alphaop operation and replicates
-             * the color result to the alpha component of the destination
-             */
-            aop = cop;
-            aarg1 = carg1;
-            aarg2 = carg2;
-            aarg0 = carg0;
-        }
-        else
-        {
-            aarg1 = (args[aop] & ARG1) ? state->texture_states[i][WINED3D_TSS_ALPHA_ARG1] : ARG_UNUSED;
-            aarg2 = (args[aop] & ARG2) ? state->texture_states[i][WINED3D_TSS_ALPHA_ARG2] : ARG_UNUSED;
-            aarg0 = (args[aop] & ARG0) ? state->texture_states[i][WINED3D_TSS_ALPHA_ARG0] : ARG_UNUSED;
-        }
+    if (cop == WINED3D_TOP_DOTPRODUCT3)
+    {
+        /* A dotproduct3 on the colorop overwrites the alphaop operation and replicates
+         * the color result to the alpha component of the destination
+         */
+        aop = cop;
+        aarg1 = carg1;
+        aarg2 = carg2;
+        aarg0 = carg0;
+    }
+    else
+    {
+        aarg1 = (args[aop] & ARG1) ? state->texture_states[stage][WINED3D_TSS_ALPHA_ARG1] : ARG_UNUSED;
+        aarg2 = (args[aop] & ARG2) ? state->texture_states[stage][WINED3D_TSS_ALPHA_ARG2] : ARG_UNUSED;
+        aarg0 = (args[aop] & ARG0) ? state->texture_states[stage][WINED3D_TSS_ALPHA_ARG0] : ARG_UNUSED;
+    }
 
-        if (!i && state->textures[0] && state->render_states[WINED3D_RS_COLORKEYENABLE])
-        {
-            GLenum texture_dimensions;
+    if (!stage && state->textures[0] && state->render_states[WINED3D_RS_COLORKEYENABLE])
+    {
+        GLenum texture_dimensions;
 
-            texture = state->textures[0];
-            texture_dimensions = texture->target;
+        texture = state->textures[0];
+        texture_dimensions = texture->target;
 
-            if (texture_dimensions == GL_TEXTURE_2D || texture_dimensions == GL_TEXTURE_RECTANGLE_ARB)
+        if (texture_dimensions == GL_TEXTURE_2D || texture_dimensions == GL_TEXTURE_RECTANGLE_ARB)
+        {
+            if (texture->async.color_key_flags & WINED3D_CKEY_SRC_BLT && !texture->resource.format->alpha_size)
             {
-                if (texture->async.color_key_flags & WINED3D_CKEY_SRC_BLT && !texture->resource.format->alpha_size)
+                if (aop == WINED3D_TOP_DISABLE)
+                {
+                   aarg1 = WINED3DTA_TEXTURE;
+                   aop = WINED3D_TOP_SELECT_ARG1;
+                }
+                else if (aop == WINED3D_TOP_SELECT_ARG1 && aarg1 != WINED3DTA_TEXTURE)
                 {
-                    if (aop == WINED3D_TOP_DISABLE)
+                    if (state->render_states[WINED3D_RS_ALPHABLENDENABLE])
                     {
-                       aarg1 = WINED3DTA_TEXTURE;
-                       aop = WINED3D_TOP_SELECT_ARG1;
+                        aarg2 = WINED3DTA_TEXTURE;
+                        aop = WINED3D_TOP_MODULATE;
                     }
-                    else if (aop == WINED3D_TOP_SELECT_ARG1 && aarg1 != WINED3DTA_TEXTURE)
+                    else aarg1 = WINED3DTA_TEXTURE;
+                }
+                else if (aop == WINED3D_TOP_SELECT_ARG2 && aarg2 != WINED3DTA_TEXTURE)
+                {
+                    if (state->render_states[WINED3D_RS_ALPHABLENDENABLE])
                     {
-                        if (state->render_states[WINED3D_RS_ALPHABLENDENABLE])
-                        {
-                            aarg2 = WINED3DTA_TEXTURE;
-                            aop = WINED3D_TOP_MODULATE;
-                        }
-                        else aarg1 = WINED3DTA_TEXTURE;
-                    }
-                    else if (aop == WINED3D_TOP_SELECT_ARG2 && aarg2 != WINED3DTA_TEXTURE)
-                    {
-                        if (state->render_states[WINED3D_RS_ALPHABLENDENABLE])
-                        {
-                            aarg1 = WINED3DTA_TEXTURE;
-                            aop = WINED3D_TOP_MODULATE;
-                        }
-                        else aarg2 = WINED3DTA_TEXTURE;
+                        aarg1 = WINED3DTA_TEXTURE;
+                        aop = WINED3D_TOP_MODULATE;
                     }
+                    else aarg2 = WINED3DTA_TEXTURE;
                 }
             }
         }
+    }
 
-        if (is_invalid_op(state, i, aop, aarg1, aarg2, aarg0))
-        {
-               aarg0 = ARG_UNUSED;
-               aarg2 = ARG_UNUSED;
-               aarg1 = WINED3DTA_CURRENT;
-               aop = WINED3D_TOP_SELECT_ARG1;
-        }
+    if (is_invalid_op(state, stage, aop, aarg1, aarg2, aarg0))
+    {
+           aarg0 = ARG_UNUSED;
+           aarg2 = ARG_UNUSED;
+           aarg1 = WINED3DTA_CURRENT;
+           aop = WINED3D_TOP_SELECT_ARG1;
+    }
+
+    if (carg1 == WINED3DTA_TEXTURE || carg2 == WINED3DTA_TEXTURE || carg0 == WINED3DTA_TEXTURE
+            || aarg1 == WINED3DTA_TEXTURE || aarg2 == WINED3DTA_TEXTURE || aarg0 == WINED3DTA_TEXTURE)
+    {
+        ttff = state->texture_states[stage][WINED3D_TSS_TEXTURE_TRANSFORM_FLAGS];
+        if (ttff == (WINED3D_TTFF_PROJECTED | WINED3D_TTFF_COUNT3))
+            op->projected = proj_count3;
+        else if (ttff & WINED3D_TTFF_PROJECTED)
+            op->projected = proj_count4;
+        else
+            op->projected = proj_none;
+    }
+    else
+    {
+        op->projected = proj_none;
+    }
+
+    op->cop = cop;
+    op->aop = aop;
+    op->carg0 = carg0;
+    op->carg1 = carg1;
+    op->carg2 = carg2;
+    op->aarg0 = aarg0;
+    op->aarg1 = aarg1;
+    op->aarg2 = aarg2;
+
+    if (state->texture_states[stage][WINED3D_TSS_RESULT_ARG] == WINED3DTA_TEMP)
+        op->dst = tempreg;
+    else
+        op->dst = resultreg;
+}
+
+/* Everything gen_ffp_frag_stage_op() reads for one stage. Formats are never
+ * freed, so the format pointer covers the colour fixup and the alpha size. */
+struct ffp_frag_stage_key
+{
+    DWORD states[10];
+    const struct wined3d_format *format;
+    GLenum target;
+    DWORD ignore_textype : 1;
+    DWORD color_key : 1;
+    DWORD color_key_src_blt : 1;
+    DWORD alpha_blend : 1;
+    DWORD padding : 28;
+};
+
+/* Per context memo of the fragment pipeline settings. Only the stages whose
+ * inputs changed since the last draw are derived again, and the program
+ * found last is checked before the hash table. Contexts are destroyed
+ * together with the fragment pipe private data that owns "last_desc". */
+struct wined3d_ffp_frag_cache
+{
+    struct ffp_frag_stage_key keys[MAX_TEXTURES];
+    struct texture_stage_op ops[MAX_TEXTURES];
+    DWORD valid_stages;
+    const struct ffp_frag_desc *last_desc;
+};
+
+static void ffp_frag_get_stage_key(const struct wined3d_state *state, unsigned int stage,
+        BOOL ignore_textype, struct ffp_frag_stage_key *key)
+{
+    static const DWORD stage_states[] =
+    {
+        WINED3D_TSS_COLOR_OP,
+        WINED3D_TSS_COLOR_ARG1,
+        WINED3D_TSS_COLOR_ARG2,
+        WINED3D_TSS_COLOR_ARG0,
+        WINED3D_TSS_ALPHA_OP,
+        WINED3D_TSS_ALPHA_ARG1,
+        WINED3D_TSS_ALPHA_ARG2,
+        WINED3D_TSS_ALPHA_ARG0,
+        WINED3D_TSS_RESULT_ARG,
+        WINED3D_TSS_TEXTURE_TRANSFORM_FLAGS,
+    };
+    const struct wined3d_texture *texture = state->textures[stage];
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(stage_states); ++i)
+        key->states[i] = state->texture_states[stage][stage_states[i]];
+    key->format = texture ? texture->resource.format : NULL;
+    key->target = texture ? texture->target : GL_NONE;
+    key->ignore_textype = !!ignore_textype;
+    key->color_key = !stage && texture && state->render_states[WINED3D_RS_COLORKEYENABLE];
+    key->color_key_src_blt = key->color_key && !!(texture->async.color_key_flags & WINED3D_CKEY_SRC_BLT);
+    key->alpha_blend = key->color_key && state->render_states[WINED3D_RS_ALPHABLENDENABLE];
+    key->padding = 0;
+}
+
+void gen_ffp_frag_op(struct wined3d_context *context, const struct wined3d_state *state,
+        struct ffp_frag_settings *settings, BOOL ignore_textype)
+{
+    struct wined3d_ffp_frag_cache *cache;
+    struct ffp_frag_stage_key key;
+    unsigned int i;
+    if(state->fb->render_targets[0] == NULL)
+    {
+    	return;
+    }
+    
+    unsigned int rt_fmt_flags = state->fb->render_targets[0]->format_flags;
+    const struct wined3d_gl_info *gl_info = context->gl_info;
+    const struct wined3d_d3d_info *d3d_info = context->d3d_info;
+
+    settings->padding = 0;
+
+#ifdef VBOX_WITH_WINE_FIX_INITCLEAR
+    memset(settings, 0, sizeof(*settings));
+#endif
+
+    if (!(cache = context->ffp_frag_cache))
+        cache = context->ffp_frag_cache = calloc(1, sizeof(*cache));
 
-        if (carg1 == WINED3DTA_TEXTURE || carg2 == WINED3DTA_TEXTURE || carg0 == WINED3DTA_TEXTURE
-                || aarg1 == WINED3DTA_TEXTURE || aarg2 == WINED3DTA_TEXTURE || aarg0 == WINED3DTA_TEXTURE)
+    for (i = 0; i < d3d_info->limits.ffp_blend_stages; ++i)
+    {
+        if (!cache)
         {
-            ttff = state->texture_states[i][WINED3D_TSS_TEXTURE_TRANSFORM_FLAGS];
-            if (ttff == (WINED3D_TTFF_PROJECTED | WINED3D_TTFF_COUNT3))
-                settings->op[i].projected = proj_count3;
-            else if (ttff & WINED3D_TTFF_PROJECTED)
-                settings->op[i].projected = proj_count4;
-            else
-                settings->op[i].projected = proj_none;
+            gen_ffp_frag_stage_op(state, i, ignore_textype, &settings->op[i]);
         }
         else
         {
-            settings->op[i].projected = proj_none;
+            ffp_frag_get_stage_key(state, i, ignore_textype, &key);
+            if (!(cache->valid_stages & (1u << i)) || memcmp(&key, &cache->keys[i], sizeof(key)))
+            {
+                gen_ffp_frag_stage_op(state, i, ignore_textype, &cache->ops[i]);
+                cache->keys[i] = key;
+                cache->valid_stages |= 1u << i;
+            }
+            settings->op[i] = cache->ops[i];
         }
 
-        settings->op[i].cop = cop;
-        settings->op[i].aop = aop;
-        settings->op[i].carg0 = carg0;
-        settings->op[i].carg1 = carg1;
-        settings->op[i].carg2 = carg2;
-        settings->op[i].aarg0 = aarg0;
-        settings->op[i].aarg1 = aarg1;
-        settings->op[i].aarg2 = aarg2;
-
-        if (state->texture_states[i][WINED3D_TSS_RESULT_ARG] == WINED3DTA_TEMP)
-            settings->op[i].dst = tempreg;
-        else
-            settings->op[i].dst = resultreg;
+        if (settings->op[i].cop == WINED3D_TOP_DISABLE)
+        {
+            ++i;
+            break;
+        }
     }
 
     /* Clear unsupported stages */
@@ -4621,23 +4745,82 @@ void gen_ffp_frag_op(const struct wined3d_context *context, const struct wined3d
         settings->flatshading = FALSE;
 }
 
-const struct ffp_frag_desc *find_ffp_frag_shader(const struct wine_rb_tree *fragment_shaders,
-        const struct ffp_frag_settings *settings)
+/* FNV-1a. Pass WINED3D_HASH_SEED for the first block, and the previous
+ * result to continue hashing further data. */
+DWORD wined3d_hash_fnv1a(DWORD hash, const void *data, SIZE_T size)
 {
-    struct wine_rb_entry *entry = wine_rb_get(fragment_shaders, settings);
-    return entry ? WINE_RB_ENTRY_VALUE(entry, struct ffp_frag_desc, entry) : NULL;
+    const BYTE *ptr = data;
+
+    while (size--)
+        hash = (hash ^ *ptr++) * 16777619u;
+
+    return hash;
 }
 
-void add_ffp_frag_shader(struct wine_rb_tree *shaders, struct ffp_frag_desc *desc)
+static DWORD ffp_frag_settings_hash(const struct ffp_frag_settings *settings)
 {
-    /* Note that the key is the implementation independent part of the ffp_frag_desc structure,
-     * whereas desc points to an extended structure with implementation specific parts. */
-    if (wine_rb_put(shaders, &desc->settings, &desc->entry) == -1)
+    return wined3d_hash_fnv1a(WINED3D_HASH_SEED, settings, sizeof(*settings));
+}
+
+void wined3d_ffp_frag_programs_init(struct wined3d_ffp_frag_programs *programs)
+{
+    unsigned int i;
+
+    for (i = 0; i < WINED3D_FFP_FRAG_HASH_SIZE; ++i)
+        list_init(&programs->buckets[i]);
+}
+
+void wined3d_ffp_frag_programs_destroy(struct wined3d_ffp_frag_programs *programs,
+        void (*destroy_desc)(struct ffp_frag_desc *desc, void *ctx), void *ctx)
+{
+    struct ffp_frag_desc *desc, *desc2;
+    unsigned int i;
+
+    for (i = 0; i < WINED3D_FFP_FRAG_HASH_SIZE; ++i)
     {
-        ERR("Failed to insert ffp frag shader.\n");
+        LIST_FOR_EACH_ENTRY_SAFE(desc, desc2, &programs->buckets[i], struct ffp_frag_desc, entry)
+        {
+            list_remove(&desc->entry);
+            destroy_desc(desc, ctx);
+        }
     }
 }
 
+const struct ffp_frag_desc *find_ffp_frag_shader(struct wined3d_context *context,
+        struct wined3d_ffp_frag_programs *programs, const struct ffp_frag_settings *settings)
+{
+    struct wined3d_ffp_frag_cache *cache = context->ffp_frag_cache;
+    struct ffp_frag_desc *desc;
+    DWORD hash;
+
+    if (cache && cache->last_desc && !memcmp(&cache->last_desc->settings, settings, sizeof(*settings)))
+        return cache->last_desc;
+
+    hash = ffp_frag_settings_hash(settings);
+    LIST_FOR_EACH_ENTRY(desc, &programs->buckets[hash % WINED3D_FFP_FRAG_HASH_SIZE], struct ffp_frag_desc, entry)
+    {
+        if (desc->hash == hash && !memcmp(&desc->settings, settings, sizeof(*settings)))
+        {
+            if (cache)
+                cache->last_desc = desc;
+            return desc;
+        }
+    }
+
+    return NULL;
+}
+
+void add_ffp_frag_shader(struct wined3d_context *context,
+        struct wined3d_ffp_frag_programs *programs, struct ffp_frag_desc *desc)
+{
+    /* Note that the key is the implementation independent part of the ffp_frag_desc structure,
+     * whereas desc points to an extended structure with implementation specific parts. */
+    desc->hash = ffp_frag_settings_hash(&desc->settings);
+    list_add_head(&programs->buckets[desc->hash % WINED3D_FFP_FRAG_HASH_SIZE], &desc->entry);
+    if (context->ffp_frag_cache)
+        context->ffp_frag_cache->last_desc = desc;
+}
+
 /* Activates the texture dimension according to the bound D3D texture. Does
  * not care for the colorop or correct gl texture unit (when using nvrc).
  * Requires the caller to activate the correct unit. */
@@ -4762,22 +4945,6 @@ void wined3d_rb_free(void *ptr)
     free(ptr);
 }
 
-static int ffp_frag_program_key_compare(const void *key, const struct wine_rb_entry *entry)
-{
-    const struct ffp_frag_settings *ka = key;
-    const struct ffp_frag_settings *kb = &WINE_RB_ENTRY_VALUE(entry, const struct ffp_frag_desc, entry)->settings;
-
-    return memcmp(ka, kb, sizeof(*ka));
-}
-
-const struct wine_rb_functions wined3d_ffp_frag_program_rb_functions =
-{
-    wined3d_rb_alloc,
-    wined3d_rb_realloc,
-    wined3d_rb_free,
-    ffp_frag_program_key_compare,
-};
-
 void wined3d_ffp_get_vs_settings(const struct wined3d_context *context,
         const struct wined3d_state *state, struct wined3d_ffp_vs_settings *settings)
 {
@@ -4956,7 +5123,7 @@ void wined3d_get_draw_rect(const struct wined3d_state *state, RECT *rect)
 
 const char *wined3d_debug_location(DWORD location)
 {
-    char buf[294];
+    char buf[321];
 
     buf[0] = '\0';
 #define LOCATION_TO_STR(u) if (location & u) { strcat(buf, " | "#u); location &= ~u; }
@@ -4970,6 +5137,7 @@ const char *wined3d_debug_location(DWORD location)
     LOCATION_TO_STR(WINED3D_LOCATION_DRAWABLE);
     LOCATION_TO_STR(WINED3D_LOCATION_RB_MULTISAMPLE);
     LOCATION_TO_STR(WINED3D_LOCATION_RB_RESOLVED);
+    LOCATION_TO_STR(WINED3D_LOCATION_CLEARED);
 #undef LOCATION_TO_STR
 // JHFIX: muted
 //    if (location) FIXME("Unrecognized location flag(s) %#x.\n", location);
@@ -5020,3 +5188,15 @@ void wined3d_release_dc(HWND window, HDC dc)
     else if (!ReleaseDC(window, dc))
         ERR("Failed to release device context %p, last error %#x.\n", dc, GetLastError());
 }
+
+/* Object ids are never reused, unlike pointers, which makes them suitable
+ * as cache keys. 0 is never returned. */
+unsigned int wined3d_generate_object_id(void)
+{
+    static LONG next_id;
+    LONG id;
+
+    while (!(id = InterlockedIncrement(&next_id)));
+
+    return id;
+}
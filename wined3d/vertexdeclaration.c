@@ -28,6 +28,43 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(d3d_decl);
 
+#define WINED3D_DECL_CACHE_BUCKETS 64
+
+/* Declarations with identical elements on the same adapter share a single
+ * analysed element array. Applications tend to create the same handful of
+ * layouts over and over, and FVF based front ends create one declaration
+ * per FVF and device. */
+struct wined3d_vertex_declaration_layout
+{
+    struct wined3d_vertex_declaration_layout *next;
+    LONG ref;
+    DWORD hash;
+    const struct wined3d_gl_info *gl_info;
+    struct wined3d_vertex_element *src_elements;
+    struct wined3d_vertex_declaration_element *elements;
+    UINT element_count;
+    BOOL position_transformed;
+    BOOL half_float_conv_needed;
+};
+
+/* FVF conversions don't depend on the adapter, so they are kept for the
+ * lifetime of the library. */
+struct wined3d_fvf_elements
+{
+    struct wined3d_fvf_elements *next;
+    DWORD fvf;
+    UINT element_count;
+    struct wined3d_vertex_element elements[1];
+};
+
+static struct
+{
+    CRITICAL_SECTION cs;
+    BOOL initialized;
+    struct wined3d_vertex_declaration_layout *layouts[WINED3D_DECL_CACHE_BUCKETS];
+    struct wined3d_fvf_elements *fvfs[WINED3D_DECL_CACHE_BUCKETS];
+} decl_cache;
+
 static void dump_wined3d_vertex_element(const struct wined3d_vertex_element *element)
 {
     TRACE("                 format: %s (%#x)\n", debug_d3dformat(element->format), element->format);
@@ -41,6 +78,30 @@ static void dump_wined3d_vertex_element(const struct wined3d_vertex_element *ele
     TRACE("              usage_idx: %u\n", element->usage_idx);
 }
 
+static void vertexdeclaration_release_layout(struct wined3d_vertex_declaration_layout *layout)
+{
+    struct wined3d_vertex_declaration_layout **entry;
+
+    if (decl_cache.initialized)
+        EnterCriticalSection(&decl_cache.cs);
+
+    if (!--layout->ref)
+    {
+        for (entry = &decl_cache.layouts[layout->hash % WINED3D_DECL_CACHE_BUCKETS]; *entry; entry = &(*entry)->next)
+        {
+            if (*entry == layout)
+            {
+                *entry = layout->next;
+                break;
+            }
+        }
+        free(layout);
+    }
+
+    if (decl_cache.initialized)
+        LeaveCriticalSection(&decl_cache.cs);
+}
+
 ULONG CDECL wined3d_vertex_declaration_incref(struct wined3d_vertex_declaration *declaration)
 {
     ULONG refcount = InterlockedIncrement(&declaration->ref);
@@ -58,7 +119,7 @@ ULONG CDECL wined3d_vertex_declaration_decref(struct wined3d_vertex_declaration
 
     if (!refcount)
     {
-        free(declaration->elements);
+        vertexdeclaration_release_layout(declaration->layout);
         declaration->parent_ops->wined3d_object_destroyed(declaration->parent);
         free(declaration);
     }
@@ -161,38 +222,101 @@ static BOOL declaration_element_valid_ffp(const struct wined3d_vertex_element *e
     }
 }
 
-static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declaration,
-        struct wined3d_device *device, const struct wined3d_vertex_element *elements, UINT element_count,
-        void *parent, const struct wined3d_parent_ops *parent_ops)
+static unsigned int vertexdeclaration_get_ffp_idx(BYTE usage, BYTE usage_idx)
+{
+    if ((usage == WINED3D_DECL_USAGE_POSITION || usage == WINED3D_DECL_USAGE_POSITIONT) && !usage_idx)
+        return WINED3D_FFP_POSITION;
+    if (usage == WINED3D_DECL_USAGE_BLEND_WEIGHT && !usage_idx)
+        return WINED3D_FFP_BLENDWEIGHT;
+    if (usage == WINED3D_DECL_USAGE_BLEND_INDICES && !usage_idx)
+        return WINED3D_FFP_BLENDINDICES;
+    if (usage == WINED3D_DECL_USAGE_NORMAL && !usage_idx)
+        return WINED3D_FFP_NORMAL;
+    if (usage == WINED3D_DECL_USAGE_PSIZE && !usage_idx)
+        return WINED3D_FFP_PSIZE;
+    if (usage == WINED3D_DECL_USAGE_COLOR && !usage_idx)
+        return WINED3D_FFP_DIFFUSE;
+    if (usage == WINED3D_DECL_USAGE_COLOR && usage_idx == 1)
+        return WINED3D_FFP_SPECULAR;
+    if (usage == WINED3D_DECL_USAGE_TEXCOORD && usage_idx < WINED3DDP_MAXTEXCOORD)
+        return WINED3D_FFP_TEXCOORD0 + usage_idx;
+
+    return ~0U;
+}
+
+/* struct wined3d_vertex_element has tail padding, so hash and compare the
+ * fields instead of the raw memory. */
+static DWORD vertexdeclaration_hash_elements(const struct wined3d_vertex_element *elements, UINT element_count)
 {
-    const struct wined3d_gl_info *gl_info = &device->adapter->gl_info;
+    const struct wined3d_vertex_element *e;
+    DWORD hash = WINED3D_HASH_SEED;
     unsigned int i;
 
-    if (TRACE_ON(d3d_decl))
+    for (i = 0; i < element_count; ++i)
     {
-        for (i = 0; i < element_count; ++i)
-        {
-            dump_wined3d_vertex_element(elements + i);
-        }
+        e = &elements[i];
+        hash = wined3d_hash_fnv1a(hash, &e->format, sizeof(e->format));
+        hash = wined3d_hash_fnv1a(hash, &e->input_slot, sizeof(e->input_slot));
+        hash = wined3d_hash_fnv1a(hash, &e->offset, sizeof(e->offset));
+        hash = wined3d_hash_fnv1a(hash, &e->output_slot, sizeof(e->output_slot));
+        hash = wined3d_hash_fnv1a(hash, &e->input_slot_class, sizeof(e->input_slot_class));
+        hash = wined3d_hash_fnv1a(hash, &e->instance_data_step_rate, sizeof(e->instance_data_step_rate));
+        hash = wined3d_hash_fnv1a(hash, &e->method, sizeof(e->method));
+        hash = wined3d_hash_fnv1a(hash, &e->usage, sizeof(e->usage));
+        hash = wined3d_hash_fnv1a(hash, &e->usage_idx, sizeof(e->usage_idx));
     }
 
-    declaration->ref = 1;
-    declaration->parent = parent;
-    declaration->parent_ops = parent_ops;
-    declaration->device = device;
-    declaration->elements = malloc(sizeof(*declaration->elements) * element_count);
-    if (!declaration->elements)
+    return hash;
+}
+
+static BOOL vertexdeclaration_elements_equal(const struct wined3d_vertex_element *e1,
+        const struct wined3d_vertex_element *e2, UINT element_count)
+{
+    unsigned int i;
+
+    for (i = 0; i < element_count; ++i)
+    {
+        if (e1[i].format != e2[i].format
+                || e1[i].input_slot != e2[i].input_slot
+                || e1[i].offset != e2[i].offset
+                || e1[i].output_slot != e2[i].output_slot
+                || e1[i].input_slot_class != e2[i].input_slot_class
+                || e1[i].instance_data_step_rate != e2[i].instance_data_step_rate
+                || e1[i].method != e2[i].method
+                || e1[i].usage != e2[i].usage
+                || e1[i].usage_idx != e2[i].usage_idx)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static HRESULT vertexdeclaration_create_layout(const struct wined3d_gl_info *gl_info,
+        const struct wined3d_vertex_element *elements, UINT element_count, DWORD hash,
+        struct wined3d_vertex_declaration_layout **layout)
+{
+    struct wined3d_vertex_declaration_layout *object;
+    unsigned int i;
+
+    if (!(object = calloc(1, sizeof(*object) + element_count
+            * (sizeof(*object->src_elements) + sizeof(*object->elements)))))
     {
         ERR("Failed to allocate elements memory.\n");
         return E_OUTOFMEMORY;
     }
-    declaration->element_count = element_count;
+    object->ref = 1;
+    object->hash = hash;
+    object->gl_info = gl_info;
+    object->elements = (struct wined3d_vertex_declaration_element *)(object + 1);
+    object->src_elements = (struct wined3d_vertex_element *)(object->elements + element_count);
+    object->element_count = element_count;
+    memcpy(object->src_elements, elements, element_count * sizeof(*elements));
 
     /* Do some static analysis on the elements to make reading the
      * declaration more comfortable for the drawing code. */
     for (i = 0; i < element_count; ++i)
     {
-        struct wined3d_vertex_declaration_element *e = &declaration->elements[i];
+        struct wined3d_vertex_declaration_element *e = &object->elements[i];
 
         e->format = wined3d_get_format(gl_info, elements[i].format);
         e->ffp_valid = declaration_element_valid_ffp(&elements[i]);
@@ -204,9 +328,10 @@ static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declara
         e->method = elements[i].method;
         e->usage = elements[i].usage;
         e->usage_idx = elements[i].usage_idx;
+        e->ffp_idx = vertexdeclaration_get_ffp_idx(e->usage, e->usage_idx);
 
         if (e->usage == WINED3D_DECL_USAGE_POSITIONT)
-            declaration->position_transformed = TRUE;
+            object->position_transformed = TRUE;
 
         /* Find the streams used in the declaration. The vertex buffers have
          * to be loaded when drawing, but filter tesselation pseudo streams. */
@@ -216,7 +341,7 @@ static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declara
         {
             FIXME("The application tries to use an unsupported format (%s), returning E_FAIL.\n",
                     debug_d3dformat(elements[i].format));
-            free(declaration->elements);
+            free(object);
             return E_FAIL;
         }
 
@@ -228,7 +353,7 @@ static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declara
             e->offset = 0;
             for (j = 1; j <= i; ++j)
             {
-                prev = &declaration->elements[i - j];
+                prev = &object->elements[i - j];
                 if (prev->input_slot == e->input_slot)
                 {
                     e->offset = (prev->offset + prev->format->byte_count + 3) & ~3;
@@ -240,16 +365,88 @@ static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declara
         if (e->offset & 0x3)
         {
             WARN("Declaration element %u is not 4 byte aligned(%u), returning E_FAIL.\n", i, e->offset);
-            free(declaration->elements);
+            free(object);
             return E_FAIL;
         }
 
         if (elements[i].format == WINED3DFMT_R16G16_FLOAT || elements[i].format == WINED3DFMT_R16G16B16A16_FLOAT)
         {
-            if (!gl_info->supported[ARB_HALF_FLOAT_VERTEX]) declaration->half_float_conv_needed = TRUE;
+            if (!gl_info->supported[ARB_HALF_FLOAT_VERTEX]) object->half_float_conv_needed = TRUE;
         }
     }
 
+    *layout = object;
+
+    return WINED3D_OK;
+}
+
+static HRESULT vertexdeclaration_get_layout(const struct wined3d_gl_info *gl_info,
+        const struct wined3d_vertex_element *elements, UINT element_count,
+        struct wined3d_vertex_declaration_layout **layout)
+{
+    DWORD hash = vertexdeclaration_hash_elements(elements, element_count);
+    struct wined3d_vertex_declaration_layout **bucket, *entry;
+    HRESULT hr;
+
+    if (!decl_cache.initialized)
+        return vertexdeclaration_create_layout(gl_info, elements, element_count, hash, layout);
+
+    bucket = &decl_cache.layouts[hash % WINED3D_DECL_CACHE_BUCKETS];
+
+    EnterCriticalSection(&decl_cache.cs);
+    for (entry = *bucket; entry; entry = entry->next)
+    {
+        if (entry->hash == hash && entry->gl_info == gl_info && entry->element_count == element_count
+                && vertexdeclaration_elements_equal(entry->src_elements, elements, element_count))
+        {
+            TRACE("Reusing layout %p.\n", entry);
+            ++entry->ref;
+            *layout = entry;
+            LeaveCriticalSection(&decl_cache.cs);
+            return WINED3D_OK;
+        }
+    }
+
+    if (SUCCEEDED(hr = vertexdeclaration_create_layout(gl_info, elements, element_count, hash, layout)))
+    {
+        (*layout)->next = *bucket;
+        *bucket = *layout;
+    }
+    LeaveCriticalSection(&decl_cache.cs);
+
+    return hr;
+}
+
+static HRESULT vertexdeclaration_init(struct wined3d_vertex_declaration *declaration,
+        struct wined3d_device *device, const struct wined3d_vertex_element *elements, UINT element_count,
+        void *parent, const struct wined3d_parent_ops *parent_ops)
+{
+    struct wined3d_vertex_declaration_layout *layout;
+    unsigned int i;
+    HRESULT hr;
+
+    if (TRACE_ON(d3d_decl))
+    {
+        for (i = 0; i < element_count; ++i)
+        {
+            dump_wined3d_vertex_element(elements + i);
+        }
+    }
+
+    if (FAILED(hr = vertexdeclaration_get_layout(&device->adapter->gl_info, elements, element_count, &layout)))
+        return hr;
+
+    declaration->ref = 1;
+    declaration->id = wined3d_generate_object_id();
+    declaration->parent = parent;
+    declaration->parent_ops = parent_ops;
+    declaration->device = device;
+    declaration->layout = layout;
+    declaration->elements = layout->elements;
+    declaration->element_count = layout->element_count;
+    declaration->position_transformed = layout->position_transformed;
+    declaration->half_float_conv_needed = layout->half_float_conv_needed;
+
     return WINED3D_OK;
 }
 
@@ -423,10 +620,44 @@ static unsigned int convert_fvf_to_declaration(const struct wined3d_gl_info *gl_
     return size;
 }
 
+static const struct wined3d_fvf_elements *vertexdeclaration_get_fvf_elements(const struct wined3d_gl_info *gl_info,
+        DWORD fvf)
+{
+    struct wined3d_fvf_elements **bucket = &decl_cache.fvfs[fvf % WINED3D_DECL_CACHE_BUCKETS];
+    struct wined3d_vertex_element *elements;
+    struct wined3d_fvf_elements *entry;
+    unsigned int size;
+
+    EnterCriticalSection(&decl_cache.cs);
+    for (entry = *bucket; entry; entry = entry->next)
+    {
+        if (entry->fvf == fvf)
+            goto done;
+    }
+
+    if ((size = convert_fvf_to_declaration(gl_info, fvf, &elements)) == ~0U)
+        goto done;
+
+    if ((entry = malloc(FIELD_OFFSET(struct wined3d_fvf_elements, elements[size]))))
+    {
+        entry->fvf = fvf;
+        entry->element_count = size;
+        memcpy(entry->elements, elements, size * sizeof(*elements));
+        entry->next = *bucket;
+        *bucket = entry;
+    }
+    free(elements);
+
+done:
+    LeaveCriticalSection(&decl_cache.cs);
+    return entry;
+}
+
 HRESULT CDECL wined3d_vertex_declaration_create_from_fvf(struct wined3d_device *device,
         DWORD fvf, void *parent, const struct wined3d_parent_ops *parent_ops,
         struct wined3d_vertex_declaration **declaration)
 {
+    const struct wined3d_fvf_elements *fvf_elements;
     struct wined3d_vertex_element *elements;
     unsigned int size;
     DWORD hr;
@@ -434,6 +665,15 @@ HRESULT CDECL wined3d_vertex_declaration_create_from_fvf(struct wined3d_device *
     TRACE("device %p, fvf %#x, parent %p, parent_ops %p, declaration %p.\n",
             device, fvf, parent, parent_ops, declaration);
 
+    if (decl_cache.initialized)
+    {
+        if (!(fvf_elements = vertexdeclaration_get_fvf_elements(&device->adapter->gl_info, fvf)))
+            return E_OUTOFMEMORY;
+
+        return wined3d_vertex_declaration_create(device, fvf_elements->elements,
+                fvf_elements->element_count, parent, parent_ops, declaration);
+    }
+
     size = convert_fvf_to_declaration(&device->adapter->gl_info, fvf, &elements);
     if (size == ~0U) return E_OUTOFMEMORY;
 
@@ -441,3 +681,34 @@ HRESULT CDECL wined3d_vertex_declaration_create_from_fvf(struct wined3d_device *
     free(elements);
     return hr;
 }
+
+void wined3d_decl_cache_init(void)
+{
+    InitializeCriticalSection(&decl_cache.cs);
+    decl_cache.initialized = TRUE;
+}
+
+void wined3d_decl_cache_cleanup(void)
+{
+    struct wined3d_fvf_elements *entry, *next;
+    unsigned int i;
+
+    if (!decl_cache.initialized)
+        return;
+
+    for (i = 0; i < WINED3D_DECL_CACHE_BUCKETS; ++i)
+    {
+        if (decl_cache.layouts[i])
+            WARN("Leftover vertex declaration layout %p.\n", decl_cache.layouts[i]);
+
+        for (entry = decl_cache.fvfs[i]; entry; entry = next)
+        {
+            next = entry->next;
+            free(entry);
+        }
+        decl_cache.fvfs[i] = NULL;
+    }
+
+    DeleteCriticalSection(&decl_cache.cs);
+    decl_cache.initialized = FALSE;
+}
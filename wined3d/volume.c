@@ -29,6 +29,8 @@ WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
 
 BOOL volume_prepare_system_memory(struct wined3d_volume *volume)
 {
+    if (volume->resource.packed_memory && !wined3d_resource_unpack_sysmem(&volume->resource))
+        return FALSE;
     if (volume->resource.heap_memory)
         return TRUE;
 
@@ -134,6 +136,8 @@ void wined3d_volume_invalidate_location(struct wined3d_volume *volume, DWORD loc
 {
     TRACE("Volume %p, clearing %s.\n", volume, wined3d_debug_location(location));
     volume->locations &= ~location;
+    if (location & WINED3D_LOCATION_SYSMEM && volume->resource.packed_memory)
+        wined3d_resource_free_sysmem(&volume->resource);
     TRACE("new location flags are %s.\n", wined3d_debug_location(volume->locations));
 }
 
@@ -235,6 +239,37 @@ static BOOL wined3d_volume_can_evict(const struct wined3d_volume *volume)
 
     return TRUE;
 }
+
+/* The volume counterpart of surface_trim_sysmem(). */
+SIZE_T wined3d_volume_trim_sysmem(struct wined3d_volume *volume, BOOL pack)
+{
+    struct wined3d_resource *resource = &volume->resource;
+
+    if (!resource->heap_memory || resource->map_count || volume->flags & WINED3D_VFLAG_CLIENT_STORAGE)
+        return 0;
+
+    if (!(volume->locations & WINED3D_LOCATION_SYSMEM))
+    {
+        TRACE("Freeing stale system memory of volume %p.\n", volume);
+        wined3d_resource_free_sysmem(resource);
+        return 0;
+    }
+
+    if (volume->locations & (WINED3D_LOCATION_TEXTURE_RGB | WINED3D_LOCATION_TEXTURE_SRGB)
+            && wined3d_volume_can_evict(volume))
+    {
+        TRACE("Evicting system memory of volume %p.\n", volume);
+        wined3d_volume_evict_sysmem(volume);
+        return 0;
+    }
+
+    if (!pack || resource->incompressible)
+        return 0;
+    wined3d_resource_pack_sysmem(resource);
+
+    return resource->size;
+}
+
 /* Context activation is done by the caller. */
 static void wined3d_volume_load_location(struct wined3d_volume *volume,
         struct wined3d_context *context, DWORD location)
@@ -244,6 +279,9 @@ static void wined3d_volume_load_location(struct wined3d_volume *volume,
     TRACE("Volume %p, loading %s, have %s.\n", volume, wined3d_debug_location(location),
         wined3d_debug_location(volume->locations));
 
+    if (volume->resource.packed_memory && !wined3d_resource_unpack_sysmem(&volume->resource))
+        return;
+
     if ((volume->locations & location) == location)
     {
         TRACE("Location(s) already up to date.\n");
@@ -534,6 +572,7 @@ HRESULT wined3d_volume_map(struct wined3d_volume *volume,
         WARN("Volume is already mapped.\n");
         return WINED3DERR_INVALIDCALL;
     }
+    wined3d_resource_mark_mapped(&volume->resource, flags);
     if (!wined3d_volume_check_box_dimensions(volume, box))
     {
         WARN("Map box is invalid.\n");
@@ -113,6 +113,13 @@ struct wined3d_settings wined3d_settings =
     FALSE,          /* VERTEX_ARRAY_BRGA is OK on most cases */
     FALSE,          /* CheckFloatConstants disabled by default */
     FALSE,          /* system cursor is visible or hidden by application */
+    16 * 1024 * 1024, /* 16 MiB of decoded DXT levels are cached by default */
+    0,              /* No frame rate limit by default. */
+    0,              /* No limit on queued frames by default. */
+    TRUE,           /* Probed GL caps are cached by default. */
+    FALSE,          /* Cached GL caps are used when valid. */
+    FALSE,          /* One context per swapchain and thread by default. */
+    TRUE,           /* Idle system memory copies are trimmed by default. */
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -222,6 +229,25 @@ static void wined3d_restore_display_state()
 	}
 }
 
+/* The front ends take this lock on nearly every call, so it is kept as cheap
+ * as possible: no tracing, and on SMP systems a short spin before the waiting
+ * thread is put to sleep, since it is normally only held for a short time.
+ * InitializeCriticalSectionAndSpinCount() doesn't exist on Windows 95. */
+static void wined3d_mutex_init(void)
+{
+    BOOL (WINAPI *pInitializeCriticalSectionAndSpinCount)(CRITICAL_SECTION *, DWORD);
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    pInitializeCriticalSectionAndSpinCount = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"),
+            "InitializeCriticalSectionAndSpinCount");
+    if (info.dwNumberOfProcessors > 1 && pInitializeCriticalSectionAndSpinCount
+            && pInitializeCriticalSectionAndSpinCount(&wined3d_cs, 4000))
+        return;
+
+    InitializeCriticalSection(&wined3d_cs);
+}
+
 static LRESULT CALLBACK wine_hook_proc(int nCode, WPARAM wParam, LPARAM lParam);
 static LRESULT CALLBACK wine_hook_proc_pos(int nCode, WPARAM wParam, LPARAM lParam);
 
@@ -429,6 +455,62 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
 	            wined3d_settings.no_3d = TRUE;
 	        }
 	        
+          if (!get_config_key(hkey, appkey, "DXTCacheSize", buffer, size))
+          {
+              int cache_size = atoi(buffer);
+              if (cache_size >= 0)
+              {
+                  TRACE("Using %iMiB for the DXT decompression cache.\n", cache_size);
+                  wined3d_settings.dxt_cache_size = (SIZE_T)cache_size * 1024 * 1024;
+              }
+              else
+                  ERR("DXTCacheSize is %i but must be >=0\n", cache_size);
+          }
+
+          if (!get_config_key_dword(hkey, appkey, "MaxFPS", &tmpvalue))
+          {
+              TRACE("Limiting frame rate to %u fps.\n", tmpvalue);
+              wined3d_settings.max_fps = tmpvalue;
+          }
+          if (!get_config_key_dword(hkey, appkey, "MaxFramesInFlight", &tmpvalue))
+          {
+              if (tmpvalue <= WINED3D_MAX_FRAMES_IN_FLIGHT)
+              {
+                  TRACE("Limiting queued frames to %u.\n", tmpvalue);
+                  wined3d_settings.max_frames_in_flight = tmpvalue;
+              }
+              else
+                  ERR("MaxFramesInFlight is %u but must be <=%u\n", tmpvalue, WINED3D_MAX_FRAMES_IN_FLIGHT);
+          }
+
+          if (!get_config_key(hkey, appkey, "CapsCache", buffer, size))
+          {
+              if (!strcmp(buffer, "disabled"))
+              {
+                  TRACE("Not caching GL caps.\n");
+                  wined3d_settings.caps_cache = FALSE;
+              }
+              else if (!strcmp(buffer, "reprobe"))
+              {
+                  TRACE("Reprobing GL caps.\n");
+                  wined3d_settings.caps_cache_reprobe = TRUE;
+              }
+          }
+
+          if (!get_config_key(hkey, appkey, "SingleContext", buffer, size)
+                && !strcmp(buffer, "enabled"))
+          {
+              TRACE("Rendering all swapchains through one context.\n");
+              wined3d_settings.single_context = TRUE;
+          }
+
+          if (!get_config_key(hkey, appkey, "TrimSysmem", buffer, size)
+                && !strcmp(buffer, "disabled"))
+          {
+              TRACE("Keeping system memory copies of managed resources.\n");
+              wined3d_settings.trim_sysmem = FALSE;
+          }
+
           if (!get_config_key(hkey, appkey, "HideCursor", buffer, size))
           {
           		if(strcmp(buffer, "enabled") == 0 || atoi(buffer) >  0)
@@ -531,6 +613,45 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
 	  	wined3d_settings.hide_sys_cursor = TRUE;
 	  }
 
+	  if(vmhal_setup_str("wine", "DXTCacheSize", FALSE) != NULL)
+	  {
+	  	wined3d_settings.dxt_cache_size = (SIZE_T)vmhal_setup_dw("wine", "DXTCacheSize") * 1024 * 1024;
+	  }
+
+	  if(vmhal_setup_str("wine", "MaxFPS", FALSE) != NULL)
+	  {
+	  	wined3d_settings.max_fps = vmhal_setup_dw("wine", "MaxFPS");
+	  }
+
+	  if(vmhal_setup_str("wine", "MaxFramesInFlight", FALSE) != NULL)
+	  {
+	  	tmpvalue = vmhal_setup_dw("wine", "MaxFramesInFlight");
+	  	if(tmpvalue <= WINED3D_MAX_FRAMES_IN_FLIGHT)
+	  	{
+	  		wined3d_settings.max_frames_in_flight = tmpvalue;
+	  	}
+	  }
+
+	  if(strcmp(vmhal_setup_str("wine", "CapsCache", TRUE), "disabled") == 0)
+	  {
+	  	wined3d_settings.caps_cache = FALSE;
+	  }
+
+	  if(strcmp(vmhal_setup_str("wine", "CapsCache", TRUE), "reprobe") == 0)
+	  {
+	  	wined3d_settings.caps_cache_reprobe = TRUE;
+	  }
+
+	  if(strcmp(vmhal_setup_str("wine", "SingleContext", TRUE), "enabled") == 0)
+	  {
+	  	wined3d_settings.single_context = TRUE;
+	  }
+
+	  if(strcmp(vmhal_setup_str("wine", "TrimSysmem", TRUE), "disabled") == 0)
+	  {
+	  	wined3d_settings.trim_sysmem = FALSE;
+	  }
+
 	  if(vmhal_setup_str("wine", "MaxShaderModelVS", FALSE) != NULL)
 	  {
 	  	wined3d_settings.max_sm_vs = vmhal_setup_dw("wine", "MaxShaderModelVS");
@@ -555,7 +676,10 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
     
     /* windows 9x require to inicialize critical section */
     InitializeCriticalSection(&wined3d_wndproc_cs);
-    InitializeCriticalSection(&wined3d_cs);
+    wined3d_mutex_init();
+    wined3d_dxt_cache_init();
+    wined3d_decl_cache_init();
+    wined3d_sysmem_init();
     
     DLLValid = DLL_VALID_VALUE;
     
@@ -603,6 +727,9 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
     free(wined3d_settings.logo);
     UnregisterClassA(WINED3D_OPENGL_WINDOW_CLASS_NAME, hInstDLL);
 
+    wined3d_dxt_cache_cleanup();
+    wined3d_decl_cache_cleanup();
+    wined3d_sysmem_cleanup();
     DeleteCriticalSection(&wined3d_wndproc_cs);
     DeleteCriticalSection(&wined3d_cs);
 
@@ -611,13 +738,11 @@ static BOOL wined3d_dll_destroy(HINSTANCE hInstDLL)
 
 void wined3d_mutex_lock(void)
 {
-	TRACE("LOCK (from %p)\n", __builtin_return_address(0));
-  EnterCriticalSection(&wined3d_cs);
+    EnterCriticalSection(&wined3d_cs);
 }
 
 void wined3d_mutex_unlock(void)
 {
-	TRACE("UNLOCK (from %p)\n", __builtin_return_address(0));
     LeaveCriticalSection(&wined3d_cs);
 }
 
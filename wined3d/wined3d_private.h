@@ -291,6 +291,13 @@ struct wined3d_settings
     BOOL vertex_array_brga_broken;
    	BOOL check_float_constants;
    	BOOL hide_sys_cursor;
+    SIZE_T dxt_cache_size;
+    unsigned int max_fps;
+    unsigned int max_frames_in_flight;
+    BOOL caps_cache;
+    BOOL caps_cache_reprobe;
+    BOOL single_context;
+    BOOL trim_sysmem;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
@@ -753,6 +760,15 @@ struct wined3d_shader_instruction
     } declaration;
 };
 
+/* Instructions decoded from the shader byte code. */
+struct wined3d_shader_ir
+{
+    LONG refcount;
+    struct wined3d_shader_version shader_version;
+    unsigned int instruction_count;
+    struct wined3d_shader_instruction *instructions;
+};
+
 struct wined3d_shader_attribute
 {
     enum wined3d_decl_usage usage;
@@ -896,6 +912,7 @@ struct wined3d_shader_backend_ops
     void (*shader_load_constants)(void *shader_priv, struct wined3d_context *context,
             const struct wined3d_state *state);
     void (*shader_destroy)(struct wined3d_shader *shader);
+    void (*shader_share)(struct wined3d_shader *shader, struct wined3d_shader *source);
     HRESULT (*shader_alloc_private)(struct wined3d_device *device, const struct wined3d_vertex_pipe_ops *vertex_pipe,
             const struct fragment_pipeline *fragment_pipe);
     void (*shader_free_private)(struct wined3d_device *device);
@@ -1034,6 +1051,20 @@ struct wined3d_stream_info
     WORD use_map; /* MAX_ATTRIBS, 16 */
 };
 
+#define WINED3D_STREAM_INFO_CACHE_SIZE 8
+
+/* A stream info derived from a declaration and vertex shader. The element
+ * addresses only hold the declaration offsets, and the strides are filled
+ * in from the stream state when the entry is used. */
+struct wined3d_stream_info_cache_entry
+{
+    unsigned int declaration_id;
+    unsigned int vs_id;
+    WORD stream_mask;
+    WORD instance_mask;
+    struct wined3d_stream_info stream_info;
+};
+
 void draw_primitive(struct wined3d_device *device, UINT start_idx, UINT index_count,
         UINT start_instance, UINT instance_count, BOOL indexed) DECLSPEC_HIDDEN;
 DWORD get_flexible_vertex_size(DWORD d3dvtVertexType) DECLSPEC_HIDDEN;
@@ -1148,6 +1179,8 @@ enum wined3d_event_query_result
 };
 
 void wined3d_event_query_destroy(struct wined3d_event_query *query) DECLSPEC_HIDDEN;
+enum wined3d_event_query_result wined3d_event_query_test(const struct wined3d_event_query *query,
+        const struct wined3d_device *device) DECLSPEC_HIDDEN;
 enum wined3d_event_query_result wined3d_event_query_finish(const struct wined3d_event_query *query,
         const struct wined3d_device *device) DECLSPEC_HIDDEN;
 void wined3d_event_query_issue(struct wined3d_event_query *query, const struct wined3d_device *device) DECLSPEC_HIDDEN;
@@ -1217,6 +1250,7 @@ struct wined3d_context
     enum fogsource          fog_source;
     DWORD active_texture;
     DWORD texture_type[MAX_COMBINED_SAMPLERS];
+    const struct wined3d_sampler *bound_samplers[MAX_COMBINED_SAMPLERS];
 
     UINT instance_count;
 
@@ -1263,6 +1297,9 @@ struct wined3d_context
     struct list timestamp_queries;
 
     struct wined3d_stream_info stream_info;
+    struct wined3d_stream_info_cache_entry stream_info_cache[WINED3D_STREAM_INFO_CACHE_SIZE];
+    unsigned int stream_info_cache_next;
+    struct wined3d_ffp_frag_cache *ffp_frag_cache;
 
     /* Fences for GL_APPLE_flush_buffer_range */
     struct wined3d_event_query *buffer_queries[MAX_ATTRIBS];
@@ -1428,6 +1465,8 @@ void context_apply_fbo_state_blit(struct wined3d_context *context, GLenum target
         struct wined3d_surface *render_target, struct wined3d_surface *depth_stencil, DWORD location) DECLSPEC_HIDDEN;
 void context_active_texture(struct wined3d_context *context, const struct wined3d_gl_info *gl_info,
         unsigned int unit) DECLSPEC_HIDDEN;
+void context_bind_sampler(struct wined3d_context *context, unsigned int unit,
+        const struct wined3d_sampler *sampler) DECLSPEC_HIDDEN;
 void context_bind_texture(struct wined3d_context *context, GLenum target, GLuint name) DECLSPEC_HIDDEN;
 void context_check_fbo_status(const struct wined3d_context *context, GLenum target) DECLSPEC_HIDDEN;
 struct wined3d_context *context_create(struct wined3d_swapchain *swapchain, struct wined3d_surface *target,
@@ -1445,6 +1484,8 @@ void context_resource_released(const struct wined3d_device *device,
 void context_resource_unloaded(const struct wined3d_device *device,
         struct wined3d_resource *resource, enum wined3d_resource_type type) DECLSPEC_HIDDEN;
 void context_restore(struct wined3d_context *context, struct wined3d_surface *restore) DECLSPEC_HIDDEN;
+void context_sampler_released(const struct wined3d_device *device,
+        const struct wined3d_sampler *sampler) DECLSPEC_HIDDEN;
 BOOL context_set_current(struct wined3d_context *ctx) DECLSPEC_HIDDEN;
 void context_set_draw_buffer(struct wined3d_context *context, GLenum buffer) DECLSPEC_HIDDEN;
 void context_set_tls_idx(DWORD idx) DECLSPEC_HIDDEN;
@@ -1816,6 +1857,50 @@ struct wined3d_d3d_info
 };
 
 /* The adapter structure */
+struct wined3d_adapter_mode
+{
+    UINT width;
+    UINT height;
+    UINT refresh_rate;
+    UINT bpp;
+    enum wined3d_scanline_ordering scanline_ordering;
+};
+
+#define WINED3D_PIXEL_FORMAT_CHOICE_COUNT 8
+
+/* A pixel format picked by context_choose_pixel_format(). */
+struct wined3d_pixel_format_choice
+{
+    enum wined3d_format_id color_format_id;
+    enum wined3d_format_id ds_format_id;
+    BOOL aux_buffers;
+    BOOL find_compatible;
+    int pixel_format;
+};
+
+#define WINED3D_MODE_FILTER_COUNT 4
+
+/* Indices of the modes that match a format and scanline ordering. */
+struct wined3d_adapter_mode_filter
+{
+    enum wined3d_format_id format_id;
+    enum wined3d_scanline_ordering scanline_ordering;
+    unsigned int *indices;
+    unsigned int count;
+};
+
+/* Display modes as reported by EnumDisplaySettings(), built on first use and
+ * dropped when the display mode changes. */
+struct wined3d_adapter_mode_table
+{
+    BOOL valid;
+    struct wined3d_adapter_mode *modes;
+    unsigned int count;
+    struct wined3d_adapter_mode_filter filters[WINED3D_MODE_FILTER_COUNT];
+    unsigned int filter_count;
+    unsigned int next_filter;
+};
+
 struct wined3d_adapter
 {
     UINT ordinal;
@@ -1828,9 +1913,15 @@ struct wined3d_adapter
     CHAR                   DeviceName[CCHDEVICENAME]; /* DeviceName for use with e.g. ChangeDisplaySettings */
     unsigned int cfg_count;
     struct wined3d_pixel_format *cfgs;
+    struct wined3d_pixel_format_choice pixel_format_choices[WINED3D_PIXEL_FORMAT_CHOICE_COUNT];
+    unsigned int pixel_format_choice_count;
+    unsigned int next_pixel_format_choice;
     UINT64 vram_bytes;
     UINT64 vram_bytes_used;
+    /* Resources are created without the wined3d mutex, see resource_init(). */
+    CRITICAL_SECTION memory_cs;
     LUID luid;
+    struct wined3d_adapter_mode_table mode_table;
 
     const struct wined3d_vertex_pipe_ops *vertex_pipe;
     const struct fragment_pipeline *fragment_pipe;
@@ -1852,9 +1943,16 @@ struct wined3d_caps_gl_ctx
 };
 
 float wined3d_adapter_find_polyoffset_scale(struct wined3d_caps_gl_ctx *ctx, GLenum format) DECLSPEC_HIDDEN;
+BOOL wined3d_caps_cache_load(struct wined3d_adapter *adapter, unsigned int format_count) DECLSPEC_HIDDEN;
+void wined3d_caps_cache_store(const struct wined3d_adapter *adapter,
+        unsigned int format_count, DWORD format_hash) DECLSPEC_HIDDEN;
+DWORD wined3d_caps_cache_hash_formats(const struct wined3d_gl_info *gl_info,
+        unsigned int format_count) DECLSPEC_HIDDEN;
 BOOL wined3d_adapter_init_format_info(struct wined3d_adapter *adapter,
         struct wined3d_caps_gl_ctx *ctx) DECLSPEC_HIDDEN;
 UINT64 adapter_adjust_memory(struct wined3d_adapter *adapter, INT64 amount) DECLSPEC_HIDDEN;
+BOOL adapter_reserve_memory(struct wined3d_adapter *adapter, UINT64 size) DECLSPEC_HIDDEN;
+void wined3d_adapter_invalidate_modes(struct wined3d_adapter *adapter) DECLSPEC_HIDDEN;
 
 BOOL initPixelFormatsNoGL(struct wined3d_gl_info *gl_info) DECLSPEC_HIDDEN;
 void install_gl_compat_wrapper(struct wined3d_gl_info *gl_info, enum wined3d_gl_extension ext) DECLSPEC_HIDDEN;
@@ -1910,20 +2008,32 @@ struct ffp_frag_settings
 
 struct ffp_frag_desc
 {
-    struct wine_rb_entry entry;
+    struct list entry;
+    DWORD hash;
     struct ffp_frag_settings    settings;
 };
 
-extern const struct wine_rb_functions wined3d_ffp_frag_program_rb_functions DECLSPEC_HIDDEN;
+#define WINED3D_FFP_FRAG_HASH_SIZE 256
+
+/* Fragment pipeline replacement programs, hashed on their settings. */
+struct wined3d_ffp_frag_programs
+{
+    struct list buckets[WINED3D_FFP_FRAG_HASH_SIZE];
+};
+
 extern const struct wine_rb_functions wined3d_ffp_vertex_program_rb_functions DECLSPEC_HIDDEN;
 extern const struct wined3d_parent_ops wined3d_null_parent_ops DECLSPEC_HIDDEN;
 
 unsigned int wined3d_max_compat_varyings(const struct wined3d_gl_info *gl_info) DECLSPEC_HIDDEN;
-void gen_ffp_frag_op(const struct wined3d_context *context, const struct wined3d_state *state,
+void gen_ffp_frag_op(struct wined3d_context *context, const struct wined3d_state *state,
         struct ffp_frag_settings *settings, BOOL ignore_textype) DECLSPEC_HIDDEN;
-const struct ffp_frag_desc *find_ffp_frag_shader(const struct wine_rb_tree *fragment_shaders,
-        const struct ffp_frag_settings *settings) DECLSPEC_HIDDEN;
-void add_ffp_frag_shader(struct wine_rb_tree *shaders, struct ffp_frag_desc *desc) DECLSPEC_HIDDEN;
+void wined3d_ffp_frag_programs_init(struct wined3d_ffp_frag_programs *programs) DECLSPEC_HIDDEN;
+void wined3d_ffp_frag_programs_destroy(struct wined3d_ffp_frag_programs *programs,
+        void (*destroy_desc)(struct ffp_frag_desc *desc, void *ctx), void *ctx) DECLSPEC_HIDDEN;
+const struct ffp_frag_desc *find_ffp_frag_shader(struct wined3d_context *context,
+        struct wined3d_ffp_frag_programs *programs, const struct ffp_frag_settings *settings) DECLSPEC_HIDDEN;
+void add_ffp_frag_shader(struct wined3d_context *context,
+        struct wined3d_ffp_frag_programs *programs, struct ffp_frag_desc *desc) DECLSPEC_HIDDEN;
 void wined3d_get_draw_rect(const struct wined3d_state *state, RECT *rect) DECLSPEC_HIDDEN;
 void wined3d_ftoa(float value, char *s) DECLSPEC_HIDDEN;
 
@@ -2063,6 +2173,16 @@ struct wined3d_state
  * wined3d_device_create() ignores it. */
 #define WINED3DCREATE_MULTITHREADED 0x00000004
 
+#define WINED3D_SHADER_INTERN_BUCKETS 64
+
+/* Every WINED3D_SYSMEM_TRIM_INTERVAL scenes, the system memory copies of
+ * managed resources that weren't mapped in the last WINED3D_SYSMEM_IDLE_FRAMES
+ * scenes are dropped or compressed, up to WINED3D_SYSMEM_PACK_BUDGET bytes
+ * of compression work at a time. */
+#define WINED3D_SYSMEM_TRIM_INTERVAL    64
+#define WINED3D_SYSMEM_IDLE_FRAMES      256
+#define WINED3D_SYSMEM_PACK_BUDGET      (8 * 1024 * 1024)
+
 struct wined3d_device
 {
     LONG ref;
@@ -2114,7 +2234,9 @@ struct wined3d_device
     UINT swapchain_count;
 
     struct list             resources; /* a linked list to track resources created by the device */
+    CRITICAL_SECTION        resources_cs; /* protects "resources", taken after the wined3d mutex */
     struct list             shaders;   /* a linked list to track shaders (pixel and vertex)      */
+    struct list shader_intern[WINED3D_SHADER_INTERN_BUCKETS];
     struct wine_rb_tree samplers;
 
     /* Render Target Support */
@@ -2149,6 +2271,16 @@ struct wined3d_device
     /* Context management */
     struct wined3d_context **contexts;
     UINT context_count;
+    unsigned int context_switches;      /* Switches between wined3d contexts */
+    unsigned int context_reactivations; /* Other wglMakeCurrent() calls */
+
+    /* Issued queries whose result isn't known yet */
+    struct list pending_queries;
+    unsigned int query_batch;
+    unsigned int query_flush_batch;
+
+    /* Scenes so far, for spotting idle system memory copies */
+    unsigned int frame_count;
     
 #ifdef VBOX_WITH_WINE_FIX_ZEROVERTATTR
     /* number of vertices in the current draw operation */
@@ -2180,6 +2312,7 @@ struct wined3d_device
 void device_clear_render_targets(struct wined3d_device *device, UINT rt_count, const struct wined3d_fb_state *fb,
         UINT rect_count, const RECT *rects, const RECT *draw_rect, DWORD flags,
         const struct wined3d_color *color, float depth, DWORD stencil) DECLSPEC_HIDDEN;
+void device_resolve_clear(struct wined3d_device *device, struct wined3d_surface *surface) DECLSPEC_HIDDEN;
 BOOL device_context_add(struct wined3d_device *device, struct wined3d_context *context) DECLSPEC_HIDDEN;
 void device_context_remove(struct wined3d_device *device, struct wined3d_context *context) DECLSPEC_HIDDEN;
 HRESULT device_init(struct wined3d_device *device, struct wined3d *wined3d,
@@ -2192,6 +2325,7 @@ void device_resource_released(struct wined3d_device *device, struct wined3d_reso
 void device_switch_onscreen_ds(struct wined3d_device *device, struct wined3d_context *context,
         struct wined3d_surface *depth_stencil) DECLSPEC_HIDDEN;
 void device_invalidate_state(const struct wined3d_device *device, DWORD state) DECLSPEC_HIDDEN;
+void device_trim_sysmem(struct wined3d_device *device) DECLSPEC_HIDDEN;
 
 static inline BOOL isStateDirty(const struct wined3d_context *context, DWORD state)
 {
@@ -2236,6 +2370,13 @@ struct wined3d_resource
     UINT size;
     DWORD priority;
     void *heap_memory;
+    /* The size heap_memory was allocated with. */
+    SIZE_T heap_size;
+    /* Compressed replacement for heap_memory while the resource is idle. */
+    void *packed_memory;
+    SIZE_T packed_size;
+    unsigned int access_frame;
+    BOOL incompressible;
     struct list resource_list_entry;
 
     void *parent;
@@ -2253,6 +2394,13 @@ static inline ULONG wined3d_resource_decref(struct wined3d_resource *resource)
     return resource->resource_ops->resource_decref(resource);
 }
 
+static inline void wined3d_resource_mark_mapped(struct wined3d_resource *resource, DWORD flags)
+{
+    resource->access_frame = resource->device->frame_count;
+    if (!(flags & WINED3D_MAP_READONLY))
+        resource->incompressible = FALSE;
+}
+
 void resource_cleanup(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 HRESULT resource_init(struct wined3d_resource *resource, struct wined3d_device *device,
         enum wined3d_resource_type type, const struct wined3d_format *format,
@@ -2263,6 +2411,8 @@ HRESULT resource_init(struct wined3d_resource *resource, struct wined3d_device *
 void resource_unload(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 BOOL wined3d_resource_allocate_sysmem(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 void wined3d_resource_free_sysmem(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
+BOOL wined3d_resource_pack_sysmem(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
+BOOL wined3d_resource_unpack_sysmem(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 GLbitfield wined3d_resource_gl_map_flags(DWORD d3d_flags) DECLSPEC_HIDDEN;
 GLenum wined3d_resource_gl_legacy_map_flags(DWORD d3d_flags) DECLSPEC_HIDDEN;
 BOOL wined3d_resource_is_offscreen(struct wined3d_resource *resource) DECLSPEC_HIDDEN;
@@ -2381,6 +2531,7 @@ void wined3d_texture_set_swapchain(struct wined3d_texture *texture,
 #define WINED3D_LOCATION_DRAWABLE       0x00000080
 #define WINED3D_LOCATION_RB_MULTISAMPLE 0x00000100
 #define WINED3D_LOCATION_RB_RESOLVED    0x00000200
+#define WINED3D_LOCATION_CLEARED        0x00000400
 
 const char *wined3d_debug_location(DWORD location) DECLSPEC_HIDDEN;
 
@@ -2403,6 +2554,7 @@ static inline struct wined3d_volume *volume_from_resource(struct wined3d_resourc
 }
 
 BOOL volume_prepare_system_memory(struct wined3d_volume *volume) DECLSPEC_HIDDEN;
+SIZE_T wined3d_volume_trim_sysmem(struct wined3d_volume *volume, BOOL pack) DECLSPEC_HIDDEN;
 HRESULT wined3d_volume_create(struct wined3d_texture *container, const struct wined3d_resource_desc *desc,
         unsigned int level, struct wined3d_volume **volume) DECLSPEC_HIDDEN;
 void wined3d_volume_destroy(struct wined3d_volume *volume) DECLSPEC_HIDDEN;
@@ -2449,6 +2601,8 @@ struct wined3d_surface_ops
     void (*surface_unmap)(struct wined3d_surface *surface);
 };
 
+#define WINED3D_SURFACE_MAX_DIRTY_RECTS 4
+
 struct wined3d_surface
 {
     struct wined3d_resource resource;
@@ -2474,6 +2628,19 @@ struct wined3d_surface
     RECT                      lockedRect;
     int                       lockCount;
 
+    /* Texture locations that are only out of date inside dirty_rects. */
+    DWORD partial_locations;
+    RECT dirty_rects[WINED3D_SURFACE_MAX_DIRTY_RECTS];
+    unsigned int dirty_rect_count;
+
+    /* GDI presenter: the area written since the surface was last copied to
+     * the screen, and the swapchain copy that did so (0 for never). */
+    RECT gdi_damage;
+    unsigned int gdi_copy_id;
+
+    /* Colour of a clear that hasn't been done yet, see WINED3D_LOCATION_CLEARED. */
+    struct wined3d_color clear_color;
+
     /* For GetDC */
     struct wined3d_surface_dib dib;
     HDC                       hDC;
@@ -2503,12 +2670,15 @@ static inline GLuint surface_get_texture_name(const struct wined3d_surface *surf
 }
 
 void surface_set_dirty(struct wined3d_surface *surface) DECLSPEC_HIDDEN;
+BOOL surface_can_defer_clear(const struct wined3d_surface *surface) DECLSPEC_HIDDEN;
 HRESULT surface_color_fill(struct wined3d_surface *s,
         const RECT *rect, const struct wined3d_color *color) DECLSPEC_HIDDEN;
 GLenum surface_get_gl_buffer(const struct wined3d_surface *surface) DECLSPEC_HIDDEN;
 void surface_get_drawable_size(const struct wined3d_surface *surface, const struct wined3d_context *context,
         unsigned int *width, unsigned int *height) DECLSPEC_HIDDEN;
 void surface_invalidate_location(struct wined3d_surface *surface, DWORD location) DECLSPEC_HIDDEN;
+void surface_invalidate_location_box(struct wined3d_surface *surface, DWORD location,
+        const struct wined3d_box *box) DECLSPEC_HIDDEN;
 void surface_load(struct wined3d_surface *surface, struct wined3d_context *context, BOOL srgb) DECLSPEC_HIDDEN;
 void surface_load_ds_location(struct wined3d_surface *surface,
         struct wined3d_context *context, DWORD location) DECLSPEC_HIDDEN;
@@ -2538,6 +2708,7 @@ HRESULT wined3d_surface_create(struct wined3d_texture *container, const struct w
         struct wined3d_surface **surface) DECLSPEC_HIDDEN;
 void wined3d_surface_destroy(struct wined3d_surface *surface) DECLSPEC_HIDDEN;
 void surface_prepare_map_memory(struct wined3d_surface *surface) DECLSPEC_HIDDEN;
+SIZE_T surface_trim_sysmem(struct wined3d_surface *surface, BOOL pack) DECLSPEC_HIDDEN;
 void wined3d_surface_upload_data(struct wined3d_surface *surface, const struct wined3d_gl_info *gl_info,
         const struct wined3d_format *format, const RECT *src_rect, UINT src_pitch, const POINT *dst_point,
         BOOL srgb, const struct wined3d_const_bo_address *data) DECLSPEC_HIDDEN;
@@ -2635,16 +2806,22 @@ struct wined3d_vertex_declaration_element
     BYTE method;
     BYTE usage;
     BYTE usage_idx;
+    unsigned int ffp_idx;
 };
 
+struct wined3d_vertex_declaration_layout;
+
 struct wined3d_vertex_declaration
 {
     LONG ref;
+    unsigned int id;
     void *parent;
     const struct wined3d_parent_ops *parent_ops;
     struct wined3d_device *device;
 
-    struct wined3d_vertex_declaration_element *elements;
+    /* Shared between all declarations with the same elements. */
+    struct wined3d_vertex_declaration_layout *layout;
+    const struct wined3d_vertex_declaration_element *elements;
     UINT element_count;
 
     BOOL position_transformed;
@@ -2806,6 +2983,9 @@ struct wined3d_query_ops
 {
     HRESULT (*query_get_data)(struct wined3d_query *query, void *data, DWORD data_size, DWORD flags);
     HRESULT (*query_issue)(struct wined3d_query *query, DWORD flags);
+    /* Asks GL for the result. Returns S_OK once query->result is set and
+     * S_FALSE while the GPU is still working on it. */
+    HRESULT (*query_poll)(struct wined3d_query *query);
 };
 
 struct wined3d_query
@@ -2819,8 +2999,22 @@ struct wined3d_query
     enum wined3d_query_type type;
     DWORD data_size;
     void                     *extendedData;
+
+    /* Results of issued queries are polled once per draw or present batch,
+     * or after WINED3D_QUERY_SPIN_COUNT GetData() calls within one. */
+    struct list poll_entry;
+    BOOL polling;
+    BOOL result_valid;
+    DWORD result;
+    unsigned int poll_batch;
+    unsigned int spin_count;
 };
 
+#define WINED3D_QUERY_SPIN_COUNT 64
+
+void wined3d_query_poll_pending(struct wined3d_device *device,
+        const struct wined3d_context *context) DECLSPEC_HIDDEN;
+
 /* TODO: Add tests and support for FLOAT16_4 POSITIONT, D3DCOLOR position, other
  * fixed function semantics as D3DCOLOR or FLOAT16 */
 enum wined3d_buffer_conversion_type
@@ -2836,6 +3030,17 @@ struct wined3d_map_range
     UINT size;
 };
 
+/* Dynamic buffers switch to an idle buffer object on DISCARD maps instead of
+ * waiting for the GPU, keeping up to this many in reserve. */
+#define WINED3D_BUFFER_SPARE_COUNT 3
+
+struct wined3d_buffer_spare
+{
+    GLuint buffer_object;
+    /* Signalled once the GPU is done with buffer_object. */
+    struct wined3d_event_query *query;
+};
+
 struct wined3d_buffer
 {
     struct wined3d_resource resource;
@@ -2851,6 +3056,8 @@ struct wined3d_buffer
     struct wined3d_map_range *maps;
     ULONG maps_size, modified_areas;
     struct wined3d_event_query *query;
+    struct wined3d_buffer_spare spares[WINED3D_BUFFER_SPARE_COUNT];
+    unsigned int spare_count;
 
     /* conversion stuff */
     UINT decl_change_count, full_conversion_count;
@@ -2927,6 +3134,9 @@ struct wined3d_swapchain_ops
             const RECT *dst_rect, const RGNDATA *dirty_region, DWORD flags);
 };
 
+#define WINED3D_MAX_FRAMES_IN_FLIGHT 8
+#define WINED3D_GDI_COPY_HISTORY 16
+
 struct wined3d_swapchain
 {
     LONG ref;
@@ -2946,6 +3156,14 @@ struct wined3d_swapchain
 
     LONG prev_time, frames;   /* Performance tracking */
 
+    /* Frame pacing. Times are in performance counter ticks. */
+    LONGLONG qpc_frequency;
+    LONGLONG next_present, sleep_slack;
+    struct wined3d_event_query *frame_fences[WINED3D_MAX_FRAMES_IN_FLIGHT];
+    unsigned int frame_fence_idx;
+    LONGLONG last_present, frame_time_min, frame_time_max, frame_time_sum;
+    unsigned int prev_context_switches, prev_context_reactivations;
+
     struct wined3d_context **context;
     unsigned int num_contexts;
 
@@ -2954,9 +3172,29 @@ struct wined3d_swapchain
 
     HDC backup_dc;
     HWND backup_wnd;
-};
 
-void x11_copy_to_screen(const struct wined3d_swapchain *swapchain, const RECT *rect) DECLSPEC_HIDDEN;
+    /* GDI presenter. Screen copies are numbered from 1; the rectangles of the
+     * most recent ones are kept to work out what a surface that was on screen
+     * before needs to have copied. Copies before gdi_copy_valid can't be
+     * trusted, because the window contents were lost in between. */
+    unsigned int gdi_copy_count, gdi_copy_valid;
+    RECT gdi_copies[WINED3D_GDI_COPY_HISTORY];
+    BOOL gdi_refresh;
+    POINT gdi_offset;
+    RGBQUAD gdi_colors[256];
+    /* 32 bpp copy of the front buffer for expanding 8 and 16 bpp formats. */
+    HDC gdi_staging_dc;
+    HBITMAP gdi_staging_bitmap;
+    void *gdi_staging_bits;
+    unsigned int gdi_staging_width, gdi_staging_height;
+};
+
+void x11_copy_to_screen(struct wined3d_swapchain *swapchain, const RECT *rect) DECLSPEC_HIDDEN;
+void swapchain_gdi_get_damage(const struct wined3d_swapchain *swapchain,
+        const struct wined3d_surface *surface, RECT *rect) DECLSPEC_HIDDEN;
+void swapchain_gdi_invalidate(struct wined3d_swapchain *swapchain) DECLSPEC_HIDDEN;
+void swapchain_gdi_set_shown(const struct wined3d_swapchain *swapchain,
+        struct wined3d_surface *surface) DECLSPEC_HIDDEN;
 
 void wined3d_swapchain_activate(struct wined3d_swapchain *swapchain, BOOL activate) DECLSPEC_HIDDEN;
 struct wined3d_context *swapchain_get_context(struct wined3d_swapchain *swapchain) DECLSPEC_HIDDEN;
@@ -2990,6 +3228,9 @@ const char *debug_glerror(GLenum error) DECLSPEC_HIDDEN;
 const char *debug_d3dtop(enum wined3d_texture_op d3dtop) DECLSPEC_HIDDEN;
 void dump_color_fixup_desc(struct color_fixup_desc fixup) DECLSPEC_HIDDEN;
 
+#define WINED3D_HASH_SEED 2166136261u
+DWORD wined3d_hash_fnv1a(DWORD hash, const void *data, SIZE_T size) DECLSPEC_HIDDEN;
+
 BOOL is_invalid_op(const struct wined3d_state *state, int stage,
         enum wined3d_texture_op op, DWORD arg1, DWORD arg2, DWORD arg3) DECLSPEC_HIDDEN;
 void set_tex_op_nvrc(const struct wined3d_gl_info *gl_info, const struct wined3d_state *state,
@@ -3107,19 +3348,25 @@ struct wined3d_pixel_shader
 struct wined3d_shader
 {
     LONG ref;
+    unsigned int id;
     const struct wined3d_shader_limits *limits;
     DWORD *function;
     UINT functionLength;
     BOOL load_local_constsF;
     const struct wined3d_shader_frontend *frontend;
     void *frontend_data;
+    struct wined3d_shader_ir *ir;
     void *backend_data;
 
     void *parent;
     const struct wined3d_parent_ops *parent_ops;
 
-    /* Programs this shader is linked with */
-    struct list linked_programs;
+    /* Content addressed lookup of identical shaders, see shader_find_interned(). */
+    DWORD intern_hash;
+    DWORD intern_flags;
+    DWORD float_const_count;
+    unsigned int max_version;
+    struct list intern_entry;
 
     /* Immediate constants (override global ones) */
     struct list constantsB;
@@ -3163,7 +3410,7 @@ void shader_dump_dst_param(const struct wined3d_shader_dst_param *param,
 unsigned int shader_find_free_input_register(const struct wined3d_shader_reg_maps *reg_maps,
         unsigned int max) DECLSPEC_HIDDEN;
 void shader_generate_main(const struct wined3d_shader *shader, struct wined3d_string_buffer *buffer,
-        const struct wined3d_shader_reg_maps *reg_maps, const DWORD *byte_code, void *backend_ctx) DECLSPEC_HIDDEN;
+        const struct wined3d_shader_reg_maps *reg_maps, void *backend_ctx) DECLSPEC_HIDDEN;
 BOOL shader_match_semantic(const char *semantic_name, enum wined3d_decl_usage usage) DECLSPEC_HIDDEN;
 
 static inline BOOL shader_is_scalar(const struct wined3d_shader_register *reg)
@@ -3387,6 +3634,29 @@ void wined3d_format_get_float_color_key(const struct wined3d_format *format,
 const struct wined3d_color_key_conversion * wined3d_format_get_color_key_conversion(
         const struct wined3d_texture *texture, BOOL need_alpha_ck) DECLSPEC_HIDDEN;
 
+/* Software DXT decompression, used when the GL can't sample S3TC textures. */
+void convert_dxt1_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth) DECLSPEC_HIDDEN;
+void convert_dxt3_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth) DECLSPEC_HIDDEN;
+void convert_dxt5_b8g8r8a8_unorm(const BYTE *src, BYTE *dst, UINT src_row_pitch, UINT src_slice_pitch,
+        UINT dst_row_pitch, UINT dst_slice_pitch, UINT width, UINT height, UINT depth) DECLSPEC_HIDDEN;
+void wined3d_dxt_cache_init(void) DECLSPEC_HIDDEN;
+void wined3d_dxt_cache_cleanup(void) DECLSPEC_HIDDEN;
+
+SIZE_T wined3d_lz_compress(const void *src, SIZE_T src_size, void *dst, SIZE_T dst_size) DECLSPEC_HIDDEN;
+BOOL wined3d_lz_decompress(const void *src, SIZE_T src_size, void *dst, SIZE_T dst_size) DECLSPEC_HIDDEN;
+
+void *wined3d_sysmem_alloc(SIZE_T size) DECLSPEC_HIDDEN;
+void wined3d_sysmem_free(void *mem, SIZE_T size) DECLSPEC_HIDDEN;
+void wined3d_sysmem_init(void) DECLSPEC_HIDDEN;
+void wined3d_sysmem_cleanup(void) DECLSPEC_HIDDEN;
+
+void wined3d_decl_cache_init(void) DECLSPEC_HIDDEN;
+void wined3d_decl_cache_cleanup(void) DECLSPEC_HIDDEN;
+
+unsigned int wined3d_generate_object_id(void) DECLSPEC_HIDDEN;
+
 static inline BOOL use_vs(const struct wined3d_state *state)
 {
     /* Check state->vertex_declaration to allow this to be used before the